@@ -1,45 +1,560 @@
 #pragma once
+#include "doctest.h"
+#include <charconv>
+#include <climits>
+#include <cmath>
+#include <cstdint>
 #include <cstdio>
-#include <cstdarg>
 #include <cstring>
 #include <string>
+#include <string_view>
+#include <type_traits>
 
-class Format
+namespace format_detail
 {
-public:
-	static std::string format(const char* msg, ...)
+	enum arg_kind
 	{
-		va_list  arg_ptr;
-		va_start(arg_ptr, msg);
+		ArgNone,
+		ArgSigned,
+		ArgUnsigned,
+		ArgDouble,
+		ArgString,
+		ArgPointer,
+	};
+
+	// type erased argument, strings are borrowed for the duration of the call
+	struct Arg
+	{
+		arg_kind kind;
+		union
+		{
+			long long i;
+			unsigned long long u;
+			double d;
+			const void* p;
+			const char* s;
+		};
+		size_t len;
+		// bytes of an integer after the default argument promotions, what %u, %x and %o mask to
+		unsigned char size;
+	};
 
-		int len = _vscprintf(msg, arg_ptr) + 1;
-		std::string strBuf(len, '\0');
-		vsprintf_s(&strBuf[0], len, msg, arg_ptr);
+	template<typename T>
+	constexpr arg_kind kind_of()
+	{
+		using U = std::remove_cv_t<std::decay_t<T>>;
+		if constexpr (std::is_same<U, const char*>::value || std::is_same<U, char*>::value
+			|| std::is_same<U, std::string>::value || std::is_same<U, std::string_view>::value)
+			return ArgString;
+		else if constexpr (std::is_floating_point<U>::value)
+			return ArgDouble;
+		else if constexpr (std::is_pointer<U>::value || std::is_null_pointer<U>::value)
+			return ArgPointer;
+		else if constexpr (std::is_enum<U>::value)
+			return ArgSigned;
+		else if constexpr (std::is_integral<U>::value)
+			return std::is_signed<U>::value ? ArgSigned : ArgUnsigned;
+		else
+			return ArgNone;
+	}
 
-		va_end(arg_ptr);
-		strBuf.pop_back();
+	template<typename T>
+	Arg make_arg(const T& value)
+	{
+		using U = std::remove_cv_t<std::decay_t<T>>;
+		static_assert(kind_of<T>() != ArgNone, "Format arguments must be numbers, pointers or strings");
 
-		return strBuf;
+		Arg arg;
+		arg.kind = kind_of<T>();
+		arg.len = 0;
+		arg.size = sizeof(U) < sizeof(int) ? sizeof(int) : sizeof(U);
+		if constexpr (std::is_same<U, std::string>::value || std::is_same<U, std::string_view>::value)
+		{
+			arg.s = value.data();
+			arg.len = value.size();
+		}
+		else if constexpr (std::is_same<U, const char*>::value || std::is_same<U, char*>::value)
+		{
+			const char* s = value;
+			arg.s = s ? s : "(null)";
+			arg.len = strlen(arg.s);
+		}
+		else if constexpr (std::is_floating_point<U>::value)
+			arg.d = (double)value;
+		else if constexpr (std::is_null_pointer<U>::value)
+			arg.p = nullptr;
+		else if constexpr (std::is_pointer<U>::value)
+			arg.p = (const void*)value;
+		else if constexpr (std::is_enum<U>::value || std::is_signed<U>::value)
+			arg.i = (long long)value;
+		else
+			arg.u = (unsigned long long)value;
+		return arg;
 	}
 
-	template<unsigned int BUF_SIZE = 512>
-	static const char* format_str(const char* msg, ...)
+	constexpr bool is_flag(char ch)
 	{
-		thread_local char buffer[BUF_SIZE];
-		memset(buffer, 0, BUF_SIZE);
+		return ch == '-' || ch == '+' || ch == ' ' || ch == '#' || ch == '0';
+	}
+
+	constexpr bool is_digit(char ch)
+	{
+		return ch >= '0' && ch <= '9';
+	}
+
+	constexpr bool is_length(char ch)
+	{
+		return ch == 'h' || ch == 'l' || ch == 'j' || ch == 'z' || ch == 't' || ch == 'L' || ch == 'q';
+	}
 
-		va_list  arg_ptr;
-		va_start(arg_ptr, msg);
+	// '#' changes o, x, X and the floating conversions, on anything else it is undefined in printf
+	constexpr bool accepts_alt(char conversion)
+	{
+		switch (conversion)
+		{
+		case 'o': case 'x': case 'X':
+		case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+			return true;
+		default:
+			return false;
+		}
+	}
 
-		int len = _vscprintf(msg, arg_ptr) + 1;
-		if (len > BUF_SIZE)
+	constexpr bool accepts(char conversion, arg_kind kind)
+	{
+		switch (conversion)
 		{
-			return "buffer overflow";
+		case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+			return kind == ArgSigned || kind == ArgUnsigned;
+		case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+			return kind == ArgDouble;
+		case 's':
+			return kind == ArgString;
+		case 'p':
+			return kind == ArgPointer || kind == ArgString;
+		default:
+			return false;
+		}
+	}
+
+	// every conversion must match the kind of its argument and the counts must agree.
+	// '*' widths, %n and '#' where printf leaves it undefined are rejected
+	template<typename... Args>
+	constexpr bool check(const char* fmt)
+	{
+		constexpr arg_kind kinds[] = { kind_of<Args>()..., ArgNone };
+		size_t next = 0;
+		for (const char* p = fmt; *p; ++p)
+		{
+			if (*p != '%')
+				continue;
+			if (*++p == '%')
+				continue;
+			bool alt = false;
+			for (; is_flag(*p); ++p)
+				alt |= *p == '#';
+			while (is_digit(*p))
+				++p;
+			if (*p == '.')
+			{
+				++p;
+				while (is_digit(*p))
+					++p;
+			}
+			while (is_length(*p))
+				++p;
+			if (next >= sizeof...(Args) || !accepts(*p, kinds[next]) || (alt && !accepts_alt(*p)))
+				return false;
+			++next;
+		}
+		return next == sizeof...(Args);
+	}
+
+	// argument types of a call, only ever named inside decltype so nothing is evaluated
+	template<typename... Args>
+	struct Probe
+	{
+		static constexpr bool check(const char* fmt) { return format_detail::check<Args...>(fmt); }
+	};
+
+	template<typename... Args>
+	Probe<Args...> probe(const Args&...);
+
+	// bounded output, keeps counting past the end so callers learn the full length
+	class Writer
+	{
+	private:
+		char* _out;
+		size_t _capacity;
+		size_t _length;
+
+	public:
+		Writer(char* out, size_t capacity) : _out(out), _capacity(capacity), _length(0) {}
+
+		size_t length() const { return _length; }
+
+		void put(char ch)
+		{
+			if (_length < _capacity)
+				_out[_length] = ch;
+			++_length;
+		}
+
+		void put(const char* s, size_t n)
+		{
+			if (n == 0)
+				return;
+			if (_length < _capacity)
+				memcpy(_out + _length, s, n < _capacity - _length ? n : _capacity - _length);
+			_length += n;
+		}
+
+		void fill(char ch, size_t n)
+		{
+			if (_length < _capacity)
+				memset(_out + _length, ch, n < _capacity - _length ? n : _capacity - _length);
+			_length += n;
+		}
+	};
+
+	struct Spec
+	{
+		bool left = false;
+		bool plus = false;
+		bool space = false;
+		bool alt = false;
+		bool zero = false;
+		int width = 0;
+		int precision = -1;
+		// 16 for h, 8 for hh, 0 keeps the argument's own width
+		int bits = 0;
+		char conversion = 0;
+	};
+
+	// sign/prefix, zero padding and body laid out into the width
+	inline void put_padded(Writer& w, const Spec& spec, const char* prefix, size_t prefix_len, const char* body, size_t body_len, bool numeric)
+	{
+		size_t total = prefix_len + body_len;
+		size_t pad = spec.width > (int)total ? spec.width - total : 0;
+		if (!spec.left && !(spec.zero && numeric))
+			w.fill(' ', pad);
+		w.put(prefix, prefix_len);
+		if (!spec.left && spec.zero && numeric)
+			w.fill('0', pad);
+		w.put(body, body_len);
+		if (spec.left)
+			w.fill(' ', pad);
+	}
+
+	inline void put_integer(Writer& w, const Spec& spec, const Arg& arg)
+	{
+		// the value is cut to the bits printf would read, then taken as signed for d/i and unsigned otherwise
+		unsigned long long raw = arg.kind == ArgDouble ? (unsigned long long)(long long)arg.d
+			: arg.kind == ArgSigned ? (unsigned long long)arg.i : arg.u;
+		int bits = spec.bits > 0 ? spec.bits : arg.size * 8;
+		unsigned long long mask = bits >= 64 ? ~0ull : (1ull << bits) - 1;
+		raw &= mask;
+
+		bool negative = false;
+		unsigned long long magnitude = raw;
+		if (spec.conversion == 'd' || spec.conversion == 'i')
+		{
+			negative = (raw >> (bits - 1)) & 1;
+			if (negative)
+				magnitude = (0ull - raw) & mask;
+		}
+
+		if (spec.conversion == 'c')
+		{
+			char ch = (char)magnitude;
+			put_padded(w, spec, nullptr, 0, &ch, 1, false);
+			return;
+		}
+
+		int base = 10;
+		if (spec.conversion == 'x' || spec.conversion == 'X')
+			base = 16;
+		else if (spec.conversion == 'o')
+			base = 8;
+
+		char digits[72];
+		char* end = std::to_chars(digits + 24, digits + sizeof(digits), magnitude, base).ptr;
+		char* begin = digits + 24;
+		if (spec.conversion == 'X')
+		{
+			for (char* p = begin; p < end; ++p)
+				if (*p >= 'a' && *p <= 'f')
+					*p = (char)(*p - 'a' + 'A');
+		}
+		if (spec.precision == 0 && magnitude == 0)
+			begin = end;
+		while (spec.precision > (int)(end - begin) && begin > digits)
+			*--begin = '0';
+		// alternate octal raises the precision until the first digit is a zero
+		if (spec.alt && base == 8 && (begin == end || *begin != '0'))
+			*--begin = '0';
+
+		char prefix[3];
+		size_t prefix_len = 0;
+		if (negative)
+			prefix[prefix_len++] = '-';
+		else if (spec.plus && base == 10)
+			prefix[prefix_len++] = '+';
+		else if (spec.space && base == 10)
+			prefix[prefix_len++] = ' ';
+		if (spec.alt && base == 16 && magnitude != 0)
+		{
+			prefix[prefix_len++] = '0';
+			prefix[prefix_len++] = spec.conversion;
+		}
+
+		Spec padding = spec;
+		padding.zero = spec.zero && spec.precision < 0;
+		put_padded(w, padding, prefix, prefix_len, begin, end - begin, true);
+	}
+
+	inline void put_float(Writer& w, const Spec& spec, const Arg& arg)
+	{
+		double value = arg.kind == ArgDouble ? arg.d : arg.kind == ArgSigned ? (double)arg.i : (double)arg.u;
+		bool negative = std::signbit(value);
+		double magnitude = negative ? -value : value;
+
+		char conversion = spec.conversion;
+		bool upper = conversion == 'F' || conversion == 'E' || conversion == 'G' || conversion == 'A';
+		int precision = spec.precision < 0 ? 6 : spec.precision;
+
+		char digits[352];
+		std::to_chars_result result;
+		switch (conversion)
+		{
+		case 'e': case 'E':
+			result = std::to_chars(digits, digits + sizeof(digits), magnitude, std::chars_format::scientific, precision);
+			break;
+		case 'g': case 'G':
+			if (precision == 0)
+				precision = 1;
+			if (spec.alt)
+			{
+				// alternate %g keeps its trailing zeros: the style is picked from the exponent as
+				// printf does, then the digits come out of %e or %f with nothing stripped
+				result = std::to_chars(digits, digits + sizeof(digits), magnitude, std::chars_format::scientific, precision - 1);
+				const char* e = result.ec == std::errc() ? (const char*)memchr(digits, 'e', result.ptr - digits) : nullptr;
+				int exponent = 0;
+				if (e)
+					std::from_chars(e + (e[1] == '+' ? 2 : 1), result.ptr, exponent);
+				if (e && exponent >= -4 && exponent < precision)
+					result = std::to_chars(digits, digits + sizeof(digits), magnitude, std::chars_format::fixed, precision - 1 - exponent);
+			}
+			else
+				result = std::to_chars(digits, digits + sizeof(digits), magnitude, std::chars_format::general, precision);
+			break;
+		case 'a': case 'A':
+			result = spec.precision < 0
+				? std::to_chars(digits, digits + sizeof(digits), magnitude, std::chars_format::hex)
+				: std::to_chars(digits, digits + sizeof(digits), magnitude, std::chars_format::hex, precision);
+			break;
+		default:
+			result = std::to_chars(digits, digits + sizeof(digits), magnitude, std::chars_format::fixed, precision);
+			break;
+		}
+		if (result.ec != std::errc())
+		{
+			put_padded(w, spec, nullptr, 0, "?", 1, false);
+			return;
+		}
+		bool finite = magnitude - magnitude == 0.0;
+		if (spec.alt && finite && !memchr(digits, '.', result.ptr - digits))
+		{
+			// alternate form always has a decimal point, ahead of the exponent when there is one
+			char* point = digits;
+			while (point < result.ptr && *point != 'e' && *point != 'p')
+				++point;
+			memmove(point + 1, point, result.ptr - point);
+			*point = '.';
+			++result.ptr;
+		}
+		if (upper)
+		{
+			for (char* p = digits; p < result.ptr; ++p)
+				if (*p >= 'a' && *p <= 'z')
+					*p = (char)(*p - 'a' + 'A');
+		}
+
+		char prefix[3];
+		size_t prefix_len = 0;
+		if (negative)
+			prefix[prefix_len++] = '-';
+		else if (spec.plus)
+			prefix[prefix_len++] = '+';
+		else if (spec.space)
+			prefix[prefix_len++] = ' ';
+		if (conversion == 'a' || conversion == 'A')
+		{
+			prefix[prefix_len++] = '0';
+			prefix[prefix_len++] = upper ? 'X' : 'x';
+		}
+
+		put_padded(w, spec, prefix, prefix_len, digits, result.ptr - digits, finite);
+	}
+
+	inline void put_string(Writer& w, const Spec& spec, const Arg& arg)
+	{
+		if (arg.kind != ArgString)
+		{
+			// unchecked calls may hand a number to %s, print it rather than read through it
+			Spec number = spec;
+			number.conversion = arg.kind == ArgDouble ? 'g' : arg.kind == ArgUnsigned ? 'u' : 'd';
+			number.precision = -1;
+			if (arg.kind == ArgDouble)
+				put_float(w, number, arg);
+			else
+				put_integer(w, number, arg);
+			return;
+		}
+		size_t len = arg.len;
+		if (spec.precision >= 0 && (size_t)spec.precision < len)
+			len = spec.precision;
+		put_padded(w, spec, nullptr, 0, arg.s, len, false);
+	}
+
+	inline void put_pointer(Writer& w, const Spec& spec, const Arg& arg)
+	{
+		char digits[24] = { '0', 'x' };
+		char* end = std::to_chars(digits + 2, digits + sizeof(digits), (unsigned long long)(uintptr_t)arg.p, 16).ptr;
+		put_padded(w, spec, nullptr, 0, digits, end - digits, false);
+	}
+
+	// single pass printf style formatting over type erased arguments
+	inline size_t vformat(Writer& w, const char* fmt, const Arg* args, size_t count)
+	{
+		size_t next = 0;
+		const char* p = fmt;
+		while (*p)
+		{
+			const char* literal = p;
+			p = strchr(p, '%');
+			if (!p)
+				p = literal + strlen(literal);
+			w.put(literal, p - literal);
+			if (!*p)
+				break;
+
+			const char* start = p++;
+			if (*p == '%')
+			{
+				w.put('%');
+				++p;
+				continue;
+			}
+
+			Spec spec;
+			for (; is_flag(*p); ++p)
+			{
+				spec.left |= *p == '-';
+				spec.plus |= *p == '+';
+				spec.space |= *p == ' ';
+				spec.alt |= *p == '#';
+				spec.zero |= *p == '0';
+			}
+			for (; is_digit(*p); ++p)
+				spec.width = spec.width * 10 + (*p - '0');
+			if (*p == '.')
+			{
+				spec.precision = 0;
+				for (++p; is_digit(*p); ++p)
+					spec.precision = spec.precision * 10 + (*p - '0');
+			}
+			while (is_length(*p) || *p == 'I')
+			{
+				if (*p == 'I' && ((p[1] == '6' && p[2] == '4') || (p[1] == '3' && p[2] == '2')))
+					p += 2;
+				else if (*p == 'h')
+					spec.bits = spec.bits == 16 ? 8 : 16;
+				++p;
+			}
+
+			spec.conversion = *p;
+			if (!*p || next >= count)
+			{
+				// nothing to convert, the directive is printed as written
+				w.put(start, (*p ? p + 1 : p) - start);
+				if (*p)
+					++p;
+				continue;
+			}
+			++p;
+
+			const Arg& arg = args[next++];
+			switch (spec.conversion)
+			{
+			case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+				put_integer(w, spec, arg);
+				break;
+			case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+				put_float(w, spec, arg);
+				break;
+			case 's':
+				put_string(w, spec, arg);
+				break;
+			case 'p':
+				put_pointer(w, spec, arg);
+				break;
+			default:
+				w.put(start, p - start);
+				--next;
+				break;
+			}
 		}
+		return w.length();
+	}
+}
 
-		vsprintf_s(buffer, len, msg, arg_ptr);
+// format strings passed through FORMAT / FORMAT_CHECK are verified against the argument types at
+// compile time, the arguments themselves are not evaluated by the check
+#define FORMAT_CHECK(fmt, ...)\
+static_assert(decltype(format_detail::probe(__VA_ARGS__))::check(fmt), "format string does not match its arguments")
 
-		va_end(arg_ptr);
+#define FORMAT(fmt, ...)\
+([&]() { FORMAT_CHECK(fmt, ##__VA_ARGS__); return Format::format(fmt, ##__VA_ARGS__); }())
+
+class Format
+{
+public:
+	// writes at most size - 1 characters and a terminator, returns the untruncated length
+	template<typename... Args>
+	static size_t format_to(char* out, size_t size, const char* msg, const Args&... args)
+	{
+		format_detail::Arg erased[sizeof...(Args) + 1] = { format_detail::make_arg(args)... };
+		format_detail::Writer writer(out, size > 0 ? size - 1 : 0);
+		size_t length = format_detail::vformat(writer, msg, erased, sizeof...(Args));
+		if (size > 0)
+			out[length < size - 1 ? length : size - 1] = '\0';
+		return length;
+	}
+
+	template<typename... Args>
+	static std::string format(const char* msg, const Args&... args)
+	{
+		thread_local char buffer[1024];
+		size_t length = format_to(buffer, sizeof(buffer), msg, args...);
+		if (length < sizeof(buffer))
+			return std::string(buffer, length);
+
+		std::string result(length, '\0');
+		format_to(&result[0], length + 1, msg, args...);
+		return result;
+	}
+
+	// thread local result, valid until the next call on the same thread
+	template<unsigned int BUF_SIZE = 512, typename... Args>
+	static const char* format_str(const char* msg, const Args&... args)
+	{
+		thread_local char buffer[BUF_SIZE];
+		size_t length = format_to(buffer, BUF_SIZE, msg, args...);
+		if (length >= BUF_SIZE)
+		{
+			return "buffer overflow";
+		}
 
 		return buffer;
 	}
@@ -87,4 +602,99 @@ public:
 		rtrim(s);
 	}
 
-};
\ No newline at end of file
+};
+
+TEST_SUITE("format")
+{
+	// every format against every value, the C library's output is the reference
+	template<typename T, size_t N, size_t M>
+	void compare_with_libc(const char* const (&formats)[N], const T (&values)[M])
+	{
+		for (const char* fmt : formats)
+		{
+			for (const T& value : values)
+			{
+				char expected[512];
+				int length = snprintf(expected, sizeof(expected), fmt, value);
+				INFO("format \"" << std::string(fmt) << "\" value " << value);
+				CHECK_EQ(Format::format(fmt, value), std::string(expected, length));
+			}
+		}
+	}
+
+	static_assert(format_detail::check<int, const char*, double>("%d %s %.2f"), "");
+	static_assert(format_detail::check<unsigned long long>("%#llx %%"), "");
+	static_assert(!format_detail::check<int>("%s"), "");
+	static_assert(!format_detail::check<const char*>("%d"), "");
+	static_assert(!format_detail::check<double>("%x"), "");
+	static_assert(!format_detail::check<int, int>("%d"), "");
+	static_assert(!format_detail::check<int>("%d %d"), "");
+	static_assert(!format_detail::check<int>("%*d"), "");
+	static_assert(!format_detail::check<int>("%n"), "");
+	static_assert(!format_detail::check<int>("%#d"), "");
+	static_assert(!format_detail::check<const char*>("%#s"), "");
+
+	TEST_CASE("integers match snprintf")
+	{
+		const char* const formats[] = {
+			"%d", "%i", "%u", "%x", "%X", "%o", "%c",
+			"%5d", "%-5d|", "%05d", "%+d", "% d", "%+05d", "%.3d", "%8.3d", "%08.3d", "%-8.3x|", "%.0d",
+			"%#x", "%#X", "%#o", "%#.0o", "%#8x", "%#08x", "%#.5o",
+			"%hd", "%hu", "%hx", "%hhd", "%hhu", "%hhx" };
+		const int ints[] = { 0, 1, -1, 8, 42, -42, 300, 70000, -70000, INT_MAX, INT_MIN };
+		compare_with_libc(formats, ints);
+
+		const char* const unsigned_formats[] = { "%u", "%x", "%o", "%d", "%#x", "%10u" };
+		const unsigned int unsigneds[] = { 0u, 1u, 255u, 0x80000000u, UINT_MAX };
+		compare_with_libc(unsigned_formats, unsigneds);
+
+		const char* const long_formats[] = { "%lld", "%llu", "%llx", "%llX", "%llo", "%+20lld", "%-20llx|", "%.15lld" };
+		const long long longs[] = { 0, -1, 1234567890123ll, LLONG_MAX, LLONG_MIN };
+		compare_with_libc(long_formats, longs);
+
+		const char* const size_formats[] = { "%zu", "%zx", "%8zu" };
+		const size_t sizes[] = { 0, 4096, SIZE_MAX };
+		compare_with_libc(size_formats, sizes);
+	}
+
+	TEST_CASE("narrow arguments are promoted like printf's")
+	{
+		const char* const formats[] = { "%d", "%u", "%x", "%hx", "%hhx" };
+		const short shorts[] = { 0, -1, SHRT_MIN, SHRT_MAX };
+		compare_with_libc(formats, shorts);
+		const signed char chars[] = { 0, -1, -128, 127 };
+		compare_with_libc(formats, chars);
+
+		CHECK_EQ(FORMAT("%x", -1), "ffffffff");
+		CHECK_EQ(FORMAT("%u", -1), "4294967295");
+		CHECK_EQ(FORMAT("%hd", 70000), "4464");
+		CHECK_EQ(FORMAT("%hhd", 300), "44");
+		CHECK_EQ(FORMAT("%llx", -1ll), "ffffffffffffffff");
+	}
+
+	TEST_CASE("floats match snprintf")
+	{
+		const char* const formats[] = {
+			"%f", "%.0f", "%#.0f", "%.3f", "%10.3f", "%-10.3f|", "%010.2f", "%+f", "% f", "%F",
+			"%e", "%.0e", "%#.0e", "%.2e", "%E", "%-12.3e|", "%+.1e",
+			"%g", "%G", "%.0g", "%.1g", "%.3g", "%.10g", "%10g", "%-10g|", "%+g", "%010g",
+			"%#g", "%#G", "%#.0g", "%#.1g", "%#.3g", "%#.10g", "%#10.3g" };
+		const double values[] = {
+			0.0, -0.0, 1.0, -1.0, 0.5, 8.0, 100.0, 0.0001234, 1e-5, 1e-4, 123456.789, 1234567.0,
+			9.9999, 0.1, 1e20, -1e-20, 1e100, 2.5, 3.5, INFINITY, -INFINITY };
+		compare_with_libc(formats, values);
+	}
+
+	TEST_CASE("strings and alternate hex floats")
+	{
+		const char* const formats[] = { "%s", "%10s", "%-10s|", "%.2s", "%10.2s", "%.0s" };
+		const char* const strings[] = { "", "a", "hello", "hello world" };
+		compare_with_libc(formats, strings);
+
+		// hex floats are compared to fixed text, the C libraries disagree on the digits they print
+		CHECK_EQ(FORMAT("%a", 1.0), "0x1p+0");
+		CHECK_EQ(FORMAT("%#.0a", 1.0), "0x1.p+0");
+		CHECK_EQ(FORMAT("%.3A", 1.0), "0X1.000P+0");
+		CHECK_EQ(FORMAT("%s|%5s|%d", std::string("ab"), std::string_view("cd"), 7), "ab|   cd|7");
+	}
+}
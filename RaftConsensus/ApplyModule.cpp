@@ -0,0 +1,57 @@
+#include "ApplyModule.h"
+
+bool raft::ApplyModule::try_submit(ApplyTask&& task)
+{
+	if (!queue.try_push(std::move(task))) {
+		return false;
+	}
+
+	// pairs with the worker publishing `sleeping` before re-checking the queue
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (sleeping.load(std::memory_order_relaxed)) {
+		std::lock_guard<std::mutex> lk(mtx);
+		cv.notify_one();
+	}
+	return true;
+}
+
+void raft::ApplyModule::start()
+{
+	worker = std::thread([this]() {
+		ApplyTask task;
+		while (true) {
+			while (queue.try_pop(task)) {
+				std::string response = state_machine->apply(task.command);
+				applied_index.store(task.index, std::memory_order_release);
+
+				if (task.reply) {
+					task.reply->set_value(ClientReply{ ClientOk, std::move(task.leader), std::move(response) });
+					task.reply.reset();
+				}
+			}
+
+			std::unique_lock<std::mutex> lk(mtx);
+			sleeping.store(true, std::memory_order_seq_cst);
+			cv.wait_for(lk, std::chrono::milliseconds(100), [this]() { return finished.load() || !queue.empty(); });
+			sleeping.store(false, std::memory_order_relaxed);
+
+			if (finished.load() && queue.empty()) {
+				return;
+			}
+		}
+	});
+}
+
+void raft::ApplyModule::stop()
+{
+	{
+		std::lock_guard<std::mutex> lk(mtx);
+		finished = true;
+	}
+
+	cv.notify_one();
+
+	if (worker.joinable()) {
+		worker.join();
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "RaftMessage.h"
+#include "SpscQueue.h"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace raft {
+	struct ApplyTask {
+		int index;
+		std::string command;
+		std::shared_ptr<std::promise<ClientReply>> reply;
+		std::string leader;
+	};
+
+	// applies committed entries on its own thread so a slow state machine never stalls the consensus loop.
+	// the node thread is the only producer, the worker the only consumer
+	class ApplyModule {
+	private:
+		std::atomic<bool> finished;
+		std::atomic<bool> sleeping;
+		std::atomic<int> applied_index;
+		std::mutex mtx;
+		std::condition_variable cv;
+		std::thread worker;
+
+		SpscQueue<ApplyTask> queue;
+		std::unique_ptr<StateMachine> state_machine;
+
+	public:
+		ApplyModule(std::unique_ptr<StateMachine> machine, size_t capacity)
+			:
+			finished(false),
+			sleeping(false),
+			applied_index(0),
+			queue(capacity),
+			state_machine(std::move(machine))
+		{
+			start();
+		}
+
+		~ApplyModule() {
+			stop();
+		}
+
+		// false when the queue is full, the task is left untouched so the caller can retry
+		bool try_submit(ApplyTask&& task);
+
+		int get_applied_index() const {
+			return applied_index.load(std::memory_order_acquire);
+		}
+
+		size_t get_backlog() const {
+			return queue.size();
+		}
+
+		// only safe to inspect once the queue is drained
+		const StateMachine* get_state_machine() const {
+			return state_machine.get();
+		}
+
+	private:
+		void start();
+
+		void stop();
+	};
+}
@@ -0,0 +1,75 @@
+#include "DelayLine.h"
+
+#include <algorithm>
+
+namespace {
+	// min-heap on (due, seq)
+	template <typename T>
+	bool later(const T& a, const T& b) {
+		return a.due != b.due ? a.due > b.due : a.seq > b.seq;
+	}
+}
+
+void raft::DelayLine::push(RaftNode* target, RaftMessage&& message, std::chrono::microseconds delay)
+{
+	auto due = std::chrono::steady_clock::now() + delay;
+	bool earliest;
+	{
+		std::lock_guard<std::mutex> lk(mtx);
+		if (finished) {
+			return;
+		}
+		uint64_t seq = next_seq++;
+		heap.push_back(Pending{ due, seq, target, std::move(message) });
+		std::push_heap(heap.begin(), heap.end(), later<Pending>);
+		earliest = heap.front().seq == seq;
+	}
+
+	// only a new head moves the worker's wake up time
+	if (earliest) {
+		cv.notify_one();
+	}
+}
+
+void raft::DelayLine::start()
+{
+	worker = std::thread([this]() {
+		std::unique_lock<std::mutex> lk(mtx);
+		while (!finished) {
+			if (heap.empty()) {
+				cv.wait(lk);
+				continue;
+			}
+
+			auto due = heap.front().due;
+			if (std::chrono::steady_clock::now() < due) {
+				cv.wait_until(lk, due);
+				continue;
+			}
+
+			std::pop_heap(heap.begin(), heap.end(), later<Pending>);
+			Pending pending = std::move(heap.back());
+			heap.pop_back();
+
+			// delivery takes the target's inbox lock, never hold ours across it
+			lk.unlock();
+			deliver(pending.target, std::move(pending.message));
+			lk.lock();
+		}
+	});
+}
+
+void raft::DelayLine::stop()
+{
+	{
+		std::lock_guard<std::mutex> lk(mtx);
+		finished = true;
+		heap.clear();
+	}
+
+	cv.notify_one();
+
+	if (worker.joinable()) {
+		worker.join();
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "RaftMessage.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace raft {
+	class RaftNode;
+
+	// holds messages back for an injected link latency and hands them on from its own thread once
+	// due, so the sender never sleeps. equal due times leave in the order they were pushed
+	class DelayLine {
+	public:
+		using Deliver = std::function<void(RaftNode*, RaftMessage&&)>;
+
+	private:
+		struct Pending {
+			std::chrono::steady_clock::time_point due;
+			uint64_t seq;
+			RaftNode* target;
+			RaftMessage message;
+		};
+
+		bool finished;
+		uint64_t next_seq;
+		std::mutex mtx;
+		std::condition_variable cv;
+		std::vector<Pending> heap;
+		std::thread worker;
+		Deliver deliver;
+
+	public:
+		DelayLine(Deliver deliver_in)
+			:
+			finished(false),
+			next_seq(0),
+			deliver(std::move(deliver_in))
+		{
+			start();
+		}
+
+		~DelayLine() {
+			stop();
+		}
+
+		void push(RaftNode* target, RaftMessage&& message, std::chrono::microseconds delay);
+
+		// messages still in flight are dropped
+		void stop();
+
+	private:
+		void start();
+	};
+}
@@ -0,0 +1,498 @@
+#include "ElectionBench.h"
+#include "RaftConsensus.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <sstream>
+#include <unordered_map>
+
+namespace {
+	struct RoundSample {
+		double time_to_leader_ms;
+		int term_inflation;
+	};
+
+	double percentile(std::vector<double> sorted, double q) {
+		if (sorted.empty()) {
+			return 0.0;
+		}
+		std::sort(sorted.begin(), sorted.end());
+		size_t rank = (size_t)std::ceil(q * (double)sorted.size());
+		return sorted[std::max<size_t>(rank, 1) - 1];
+	}
+
+	raft::ElectionBenchResult summarize(const char* mode, int nodes, const std::vector<RoundSample>& samples, int failed_rounds) {
+		raft::ElectionBenchResult result{ mode, nodes, (int)samples.size(), failed_rounds, 0.0, 0.0, 0.0, 0.0, 0.0 };
+
+		std::vector<double> times;
+		int split = 0;
+		int inflation = 0;
+		for (const auto& sample : samples) {
+			times.push_back(sample.time_to_leader_ms);
+			if (sample.term_inflation > 1) {
+				++split;
+			}
+			inflation += sample.term_inflation;
+		}
+
+		if (!samples.empty()) {
+			result.p50_ms = percentile(times, 0.5);
+			result.p99_ms = percentile(times, 0.99);
+			result.max_ms = *std::max_element(times.begin(), times.end());
+			result.split_vote_rate = (double)split / (double)samples.size();
+			result.mean_term_inflation = (double)inflation / (double)samples.size();
+		}
+		return result;
+	}
+
+	struct ObservedLeader {
+		std::string tag;
+		int term;
+	};
+
+	// each node publishes its state through a seqlock after every batch, reading it never blocks the nodes
+	ObservedLeader observe_leader(const std::vector<std::string>& tags, int& max_term) {
+		auto states = raft::RaftVisualizer::getInstance()->get_states();
+		ObservedLeader leader{ std::string(), 0 };
+		max_term = 0;
+		for (const auto& tag : tags) {
+			auto it = states.find(tag);
+			if (it == states.end() || it->second.status == raft::Dead) {
+				continue;
+			}
+			max_term = std::max(max_term, it->second.term);
+		}
+		for (const auto& tag : tags) {
+			auto it = states.find(tag);
+			if (it != states.end() && it->second.status == raft::Leader && it->second.term == max_term) {
+				leader = ObservedLeader{ tag, max_term };
+			}
+		}
+		return leader;
+	}
+
+	bool wait_stable_leader(const std::vector<std::string>& tags, const std::string& excluded, std::chrono::milliseconds window,
+		std::chrono::milliseconds timeout, ObservedLeader& leader, std::chrono::steady_clock::time_point& elected_at) {
+		auto give_up = std::chrono::steady_clock::now() + timeout;
+		ObservedLeader current{ std::string(), 0 };
+		auto since = std::chrono::steady_clock::now();
+
+		while (std::chrono::steady_clock::now() < give_up) {
+			int max_term = 0;
+			ObservedLeader observed = observe_leader(tags, max_term);
+			if (observed.tag == excluded) {
+				observed = ObservedLeader{ std::string(), 0 };
+			}
+
+			auto now = std::chrono::steady_clock::now();
+			if (observed.tag != current.tag || observed.term != current.term) {
+				current = observed;
+				since = now;
+			}
+			else if (!current.tag.empty() && now - since >= window) {
+				leader = current;
+				elected_at = since;
+				return true;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return false;
+	}
+
+	std::vector<int> parse_sizes(const std::string& text) {
+		std::vector<int> sizes;
+		std::istringstream in(text);
+		std::string item;
+		while (std::getline(in, item, ',')) {
+			int size = atoi(item.c_str());
+			if (size > 0) {
+				sizes.push_back(size);
+			}
+		}
+		return sizes;
+	}
+
+	void print_result(const raft::ElectionBenchResult& result) {
+		printf("%-9s %5d %6d %6d %9.1f %9.1f %9.1f %10.2f %9.2f\n",
+			result.mode.c_str(), result.nodes, result.rounds, result.failed_rounds,
+			result.p50_ms, result.p99_ms, result.max_ms, result.split_vote_rate, result.mean_term_inflation);
+	}
+}
+
+namespace raft {
+	// runs real RaftNodes and their MessageProcessor on a discrete event clock, times are in microseconds.
+	// the nodes are never started: the router hands every send back here and it arrives after the
+	// network latency (plus vote_delay_ms for votes) as a batch of one, election timeouts and heartbeat
+	// ticks are events too. everything runs on the calling thread, so a seed reproduces a run
+	class ElectionSimulator : public NodeTimers {
+	private:
+		enum EventType {
+			Timeout,
+			Delivery,
+			HeartbeatTick,
+		};
+
+		struct Event {
+			int64_t at;
+			uint64_t seq;
+			EventType type;
+			int node;
+			int generation;
+
+			bool operator>(const Event& other) const {
+				return at != other.at ? at > other.at : seq > other.seq;
+			}
+		};
+
+		std::unique_ptr<RaftRouter> _router;
+		std::vector<RaftNode*> _nodes;
+		std::vector<int> _timer_generation;
+		std::vector<int> _heartbeat_generation;
+		// messages on the wire by the seq of their Delivery event
+		std::unordered_map<uint64_t, RaftMessage> _in_flight;
+		std::vector<RaftMessage> _batch;
+		std::priority_queue<Event, std::vector<Event>, std::greater<Event>> _events;
+		int64_t _latency_us;
+		int64_t _now;
+		uint64_t _seq;
+
+	public:
+		ElectionSimulator(int node_count, const RaftConfig& config, unsigned seed, int64_t latency_us)
+			:
+			_router(new RaftRouter(config)),
+			_timer_generation(node_count),
+			_heartbeat_generation(node_count),
+			_latency_us(latency_us),
+			_now(0),
+			_seq(0)
+		{
+			for (int i = 1; i <= node_count; ++i) {
+				_router->add_node(new RaftNode(_router.get(), FORMAT("n%d", i)));
+			}
+			_router->begin_simulation([this](RaftNode* node, RaftMessage&& message) {
+				send(node, std::move(message));
+			});
+			_nodes = _router->get_all_nodes();
+
+			election_timeout_rng().seed(seed);
+			for (auto node : _nodes) {
+				node->set_timers(this);
+				node->reset_election_timer();
+				node->publish_state();
+			}
+		}
+
+		~ElectionSimulator() {
+			// the router stops the nodes, which would hand their heartbeats back to a half destroyed driver
+			for (auto node : _nodes) {
+				node->set_timers(nullptr);
+			}
+			_router.reset();
+		}
+
+		int64_t get_now() const {
+			return _now;
+		}
+
+		int get_term(int node) const {
+			return _nodes[node]->get_term();
+		}
+
+		// the same control messages RaftRouter::set_dead and set_restart queue
+		void kill(int node) {
+			process(node, std::make_unique<SetDeadMessage>());
+		}
+
+		void restart(int node) {
+			process(node, std::make_unique<SetRestartMessage>());
+		}
+
+		void run_for(int64_t duration_us) {
+			int64_t until = _now + duration_us;
+			while (!_events.empty() && _events.top().at <= until) {
+				step();
+			}
+			_now = until;
+		}
+
+		// runs until one live leader held the highest term for window_us, reports when it was elected
+		bool run_until_stable_leader(int64_t window_us, int64_t timeout_us, int& leader, int64_t& elected_at) {
+			int64_t give_up = _now + timeout_us;
+			int current = find_leader();
+			int current_term = current >= 0 ? get_term(current) : 0;
+			int64_t since = _now;
+
+			while (!_events.empty() && _now < give_up) {
+				int64_t next = _events.top().at;
+				if (current >= 0 && next >= since + window_us) {
+					_now = since + window_us;
+					leader = current;
+					elected_at = since;
+					return true;
+				}
+
+				step();
+
+				int observed = find_leader();
+				int observed_term = observed >= 0 ? get_term(observed) : 0;
+				if (observed != current || observed_term != current_term) {
+					current = observed;
+					current_term = observed_term;
+					since = _now;
+				}
+			}
+			return false;
+		}
+
+		void arm_election_timer(RaftNode* node, double timeout_ms) override {
+			int index = index_of(node);
+			push(_now + std::llround(timeout_ms * 1000.0), Timeout, index, ++_timer_generation[index]);
+		}
+
+		void start_heartbeats(RaftNode* node) override {
+			int index = index_of(node);
+			++_heartbeat_generation[index];
+			heartbeat(index);
+		}
+
+		void stop_heartbeats(RaftNode* node) override {
+			++_heartbeat_generation[index_of(node)];
+		}
+
+	private:
+		int index_of(RaftNode* node) const {
+			return (int)(std::find(_nodes.begin(), _nodes.end(), node) - _nodes.begin());
+		}
+
+		int find_leader() const {
+			int max_term = 0;
+			for (auto node : _nodes) {
+				if (!node->is_dead()) {
+					max_term = std::max(max_term, node->get_term());
+				}
+			}
+			for (int i = 0; i < (int)_nodes.size(); ++i) {
+				auto state = _nodes[i]->get_state();
+				if (state.status == Leader && state.term == max_term) {
+					return i;
+				}
+			}
+			return -1;
+		}
+
+		void push(int64_t at, EventType type, int node, int generation) {
+			_events.push(Event{ at, _seq++, type, node, generation });
+		}
+
+		void send(RaftNode* target, RaftMessage&& message) {
+			int64_t latency = _latency_us;
+			if (message->type == VotesRequest || message->type == VotesResponse) {
+				latency += (int64_t)_router->get_config().vote_delay_ms * 1000;
+			}
+			_in_flight.emplace(_seq, std::move(message));
+			push(_now + latency, Delivery, index_of(target), 0);
+		}
+
+		// what HeartbeatModule does on each tick
+		void heartbeat(int node) {
+			RaftNode* leader = _nodes[node];
+			_router->send_heartbeat_request(leader->get_term(), leader->get_tag());
+			double interval_ms = _router->get_config().heartbeat_interval_ms * leader->get_clock_skew();
+			push(_now + std::llround(interval_ms * 1000.0), HeartbeatTick, node, _heartbeat_generation[node]);
+		}
+
+		// one inbox drain of the node's thread
+		void process(int node, RaftMessage&& message) {
+			RaftNode* target = _nodes[node];
+			_batch.push_back(std::move(message));
+			target->_processor->process_batch(_batch);
+			_batch.clear();
+			target->_processor->dispatch_committed();
+			target->publish_state();
+		}
+
+		void step() {
+			Event event = _events.top();
+			_events.pop();
+			_now = event.at;
+
+			RaftNode* node = _nodes[event.node];
+			switch (event.type) {
+			case Timeout:
+				// the check RaftNode::on_work makes against its deadline
+				if (event.generation == _timer_generation[event.node] && node->_inner_state.election_timeout != -1 && !node->is_dead()) {
+					node->start_election();
+					node->publish_state();
+				}
+				break;
+			case Delivery: {
+				auto it = _in_flight.find(event.seq);
+				RaftMessage message = std::move(it->second);
+				_in_flight.erase(it);
+				process(event.node, std::move(message));
+				break;
+			}
+			case HeartbeatTick:
+				if (event.generation == _heartbeat_generation[event.node]) {
+					heartbeat(event.node);
+				}
+				break;
+			}
+		}
+	};
+}
+
+raft::ElectionBenchResult raft::run_simulated_election_bench(int nodes, const ElectionBenchOptions& options)
+{
+	ElectionSimulator sim(nodes, options.config, options.seed + (unsigned)nodes, options.network_latency_us);
+	const int64_t window_us = (int64_t)options.get_stable_window_ms() * 1000;
+	const int64_t timeout_us = (int64_t)options.round_timeout_ms * 1000;
+
+	std::vector<RoundSample> samples;
+	int failed_rounds = 0;
+
+	int leader = -1;
+	int64_t elected_at = 0;
+	if (!sim.run_until_stable_leader(window_us, timeout_us, leader, elected_at)) {
+		return summarize("simulated", nodes, samples, options.rounds);
+	}
+
+	for (int round = 0; round < options.rounds; ++round) {
+		int old_leader = leader;
+		int old_term = sim.get_term(old_leader);
+		int64_t killed_at = sim.get_now();
+		sim.kill(old_leader);
+
+		if (!sim.run_until_stable_leader(window_us, timeout_us, leader, elected_at)) {
+			++failed_rounds;
+			sim.restart(old_leader);
+			if (!sim.run_until_stable_leader(window_us, timeout_us, leader, elected_at)) {
+				failed_rounds += options.rounds - round - 1;
+				break;
+			}
+			continue;
+		}
+		samples.push_back(RoundSample{ (double)(elected_at - killed_at) / 1000.0, sim.get_term(leader) - old_term });
+
+		// the old leader rejoins as a follower before the next kill
+		sim.restart(old_leader);
+		sim.run_for((int64_t)options.config.heartbeat_interval_ms * 2000);
+		sim.run_until_stable_leader(window_us, timeout_us, leader, elected_at);
+	}
+	return summarize("simulated", nodes, samples, failed_rounds);
+}
+
+raft::ElectionBenchResult raft::run_threaded_election_bench(int nodes, const ElectionBenchOptions& options)
+{
+	RaftVisualizer::getInstance()->reset();
+
+	RaftRouter* router = new RaftRouter(options.config);
+	std::vector<std::string> tags;
+	for (int i = 1; i <= nodes; ++i) {
+		tags.push_back(FORMAT("n%d", i));
+		router->add_node(new RaftNode(router, tags.back()));
+	}
+	router->start();
+
+	const auto window = std::chrono::milliseconds(options.get_stable_window_ms());
+	const auto timeout = std::chrono::milliseconds(options.round_timeout_ms);
+
+	std::vector<RoundSample> samples;
+	int failed_rounds = 0;
+
+	ObservedLeader leader{ std::string(), 0 };
+	std::chrono::steady_clock::time_point elected_at;
+	if (!wait_stable_leader(tags, std::string(), window, timeout, leader, elected_at)) {
+		delete router;
+		return summarize("threaded", nodes, samples, options.rounds);
+	}
+
+	for (int round = 0; round < options.rounds; ++round) {
+		ObservedLeader old_leader = leader;
+		auto killed_at = std::chrono::steady_clock::now();
+		router->set_dead(old_leader.tag);
+
+		bool elected = wait_stable_leader(tags, old_leader.tag, window, timeout, leader, elected_at);
+		if (elected) {
+			double ms = std::chrono::duration<double, std::milli>(elected_at - killed_at).count();
+			samples.push_back(RoundSample{ ms, leader.term - old_leader.term });
+		}
+		else {
+			++failed_rounds;
+		}
+
+		router->set_restart(old_leader.tag);
+		std::this_thread::sleep_for(std::chrono::milliseconds(options.config.heartbeat_interval_ms * 2));
+		if (!wait_stable_leader(tags, std::string(), window, timeout, leader, elected_at)) {
+			failed_rounds += options.rounds - round - 1;
+			break;
+		}
+	}
+
+	delete router;
+	return summarize("threaded", nodes, samples, failed_rounds);
+}
+
+int raft::run_election_bench(int argc, char** argv)
+{
+	ElectionBenchOptions options;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : "";
+
+		if (arg == "--sizes") {
+			options.cluster_sizes = parse_sizes(value); ++i;
+		}
+		else if (arg == "--rounds") {
+			options.rounds = atoi(value); ++i;
+		}
+		else if (arg == "--mode") {
+			options.simulated = strcmp(value, "threaded") != 0;
+			options.threaded = strcmp(value, "sim") != 0;
+			++i;
+		}
+		else if (arg == "--timeout") {
+			int min_ms = 0, max_ms = 0;
+			if (sscanf(value, "%d-%d", &min_ms, &max_ms) == 2 && min_ms > 0 && max_ms >= min_ms) {
+				options.config.election_timeout_min_ms = min_ms;
+				options.config.election_timeout_max_ms = max_ms;
+			}
+			++i;
+		}
+		else if (arg == "--heartbeat") {
+			options.config.heartbeat_interval_ms = atoi(value); ++i;
+		}
+		else if (arg == "--latency") {
+			options.config.vote_delay_ms = atoi(value); ++i;
+		}
+		else if (arg == "--net-latency") {
+			options.network_latency_us = atoi(value); ++i;
+		}
+		else if (arg == "--window") {
+			options.stable_window_ms = atoi(value); ++i;
+		}
+		else if (arg == "--seed") {
+			options.seed = (unsigned)strtoul(value, nullptr, 10); ++i;
+		}
+	}
+
+	printf("election timeout %d-%dms, heartbeat %dms, vote latency %dms, simulated network latency %dus, stable window %dms, %d rounds\n",
+		options.config.election_timeout_min_ms, options.config.election_timeout_max_ms, options.config.heartbeat_interval_ms,
+		options.config.vote_delay_ms, options.network_latency_us, options.get_stable_window_ms(), options.rounds);
+	printf("%-9s %5s %6s %6s %9s %9s %9s %10s %9s\n", "mode", "nodes", "rounds", "failed", "p50_ms", "p99_ms", "max_ms", "split_rate", "terms");
+
+	for (int nodes : options.cluster_sizes) {
+		if (options.simulated) {
+			print_result(run_simulated_election_bench(nodes, options));
+		}
+		if (options.threaded) {
+			print_result(run_threaded_election_bench(nodes, options));
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "RaftConfig.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace raft {
+	struct ElectionBenchOptions {
+		std::vector<int> cluster_sizes = { 3, 5, 7, 9 };
+		int rounds = 20;
+		bool simulated = true;
+		bool threaded = false;
+		unsigned seed = 1;
+
+		// one way latency of every message in the simulated run, votes wait out vote_delay_ms on top
+		int network_latency_us = 100;
+
+		// a new leader counts once it held its term this long without a competing election (0 = 3 heartbeats)
+		int stable_window_ms = 0;
+
+		// gives up on a round after this long without a stable leader
+		int round_timeout_ms = 30000;
+
+		RaftConfig config;
+
+		ElectionBenchOptions() {
+			config.election_timeout_min_ms = 150;
+			config.election_timeout_max_ms = 300;
+			config.heartbeat_interval_ms = 50;
+			config.vote_delay_ms = 5;
+		}
+
+		int get_stable_window_ms() const {
+			return stable_window_ms > 0 ? stable_window_ms : 3 * config.heartbeat_interval_ms;
+		}
+	};
+
+	struct ElectionBenchResult {
+		std::string mode;
+		int nodes;
+		int rounds;
+		int failed_rounds;
+		double p50_ms;
+		double p99_ms;
+		double max_ms;
+		// rounds that needed more than one term to settle on a leader
+		double split_vote_rate;
+		// terms burnt per failover, 1.0 is a clean single election
+		double mean_term_inflation;
+	};
+
+	// kills the leader rounds times per cluster size and measures time to the next stable leader.
+	// both runs drive real RaftNodes and MessageProcessor through a RaftRouter. the threaded run uses
+	// wall time and node threads, the simulated run puts timers and message latency on a discrete
+	// event clock (ElectionSimulator) so it is fast and deterministic for a given seed
+	ElectionBenchResult run_threaded_election_bench(int nodes, const ElectionBenchOptions& options);
+
+	ElectionBenchResult run_simulated_election_bench(int nodes, const ElectionBenchOptions& options);
+
+	// --bench-election [--sizes 3,5,7] [--rounds n] [--mode sim|threaded|both] [--timeout min-max]
+	//                  [--heartbeat ms] [--latency ms] [--net-latency us] [--window ms] [--seed n]
+	int run_election_bench(int argc, char** argv);
+}
@@ -0,0 +1,231 @@
+#include "EventLog.h"
+#include "RaftVisualizer.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+	constexpr size_t ring_capacity = 64 << 10;
+
+	struct DecodedEvent {
+		int64_t timestamp;
+		const raft::EventSite* site;
+		std::vector<raft::EventArg> args;
+	};
+
+	// the owning thread marks its ring abandoned on exit, the drain thread frees it once empty
+	struct RingHandle {
+		std::shared_ptr<raft::EventRing> ring;
+
+		~RingHandle() {
+			if (ring) {
+				ring->abandoned.store(true, std::memory_order_release);
+			}
+		}
+	};
+}
+
+std::string raft::format_event(const char* format, const std::vector<EventArg>& args)
+{
+	format_detail::Arg erased[32];
+	size_t count = std::min<size_t>(args.size(), 32);
+	for (size_t i = 0; i < count; ++i) {
+		const EventArg& arg = args[i];
+		erased[i].len = 0;
+		switch (arg.kind) {
+		case EventArgSigned:
+			erased[i].kind = format_detail::ArgSigned;
+			erased[i].i = (long long)arg.raw;
+			break;
+		case EventArgUnsigned:
+			erased[i].kind = format_detail::ArgUnsigned;
+			erased[i].u = arg.raw;
+			break;
+		case EventArgDouble:
+			erased[i].kind = format_detail::ArgDouble;
+			memcpy(&erased[i].d, &arg.raw, sizeof(double));
+			break;
+		case EventArgPointer:
+			erased[i].kind = format_detail::ArgPointer;
+			erased[i].p = (const void*)(uintptr_t)arg.raw;
+			break;
+		default:
+			erased[i].kind = format_detail::ArgString;
+			erased[i].s = arg.text.data();
+			erased[i].len = arg.text.size();
+			break;
+		}
+	}
+
+	char buffer[512];
+	format_detail::Writer writer(buffer, sizeof(buffer));
+	size_t length = format_detail::vformat(writer, format, erased, count);
+	if (length <= sizeof(buffer)) {
+		return std::string(buffer, length);
+	}
+
+	std::string result(length, '\0');
+	format_detail::Writer large(&result[0], length);
+	format_detail::vformat(large, format, erased, count);
+	return result;
+}
+
+raft::EventLog::EventLog()
+	:
+	_finished(false),
+	_delivered(0),
+	_stalls(0)
+{
+	// constructed first so it outlives the drain thread at exit
+	RaftVisualizer::getInstance();
+
+	_drain = std::thread([this]() {
+		drain_loop();
+	});
+}
+
+raft::EventLog::~EventLog()
+{
+	_finished.store(true);
+	_cv.notify_one();
+	if (_drain.joinable()) {
+		_drain.join();
+	}
+}
+
+raft::EventRing& raft::EventLog::this_thread_ring()
+{
+	thread_local RingHandle handle;
+	if (!handle.ring) {
+		handle.ring = std::make_shared<EventRing>(ring_capacity);
+		std::lock_guard<std::mutex> lk(_mtx);
+		_rings.push_back(handle.ring);
+	}
+	return *handle.ring;
+}
+
+void raft::EventLog::wait_for_room(EventRing& ring, size_t size)
+{
+	_stalls.fetch_add(1, std::memory_order_relaxed);
+	_cv.notify_one();
+	while (!ring.has_room(size)) {
+		std::this_thread::yield();
+	}
+}
+
+void raft::EventLog::flush()
+{
+	std::vector<std::pair<std::shared_ptr<EventRing>, size_t>> targets;
+	{
+		std::lock_guard<std::mutex> lk(_mtx);
+		for (auto& ring : _rings) {
+			targets.emplace_back(ring, ring->get_tail());
+		}
+	}
+	_cv.notify_one();
+
+	for (auto& target : targets) {
+		while (target.first->get_head() < target.second) {
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+	}
+}
+
+bool raft::EventLog::drain_once()
+{
+	std::vector<std::shared_ptr<EventRing>> rings;
+	{
+		std::lock_guard<std::mutex> lk(_mtx);
+		rings = _rings;
+	}
+
+	std::vector<DecodedEvent> events;
+	std::vector<size_t> heads;
+	for (auto& ring : rings) {
+		size_t head = ring->get_head();
+		size_t tail = ring->get_tail();
+
+		while (head < tail) {
+			uint32_t size;
+			uint8_t count;
+			DecodedEvent event;
+			ring->read(head, &size, sizeof(size));
+
+			size_t position = head + sizeof(size);
+			ring->read(position, &event.site, sizeof(event.site)); position += sizeof(event.site);
+			ring->read(position, &event.timestamp, sizeof(event.timestamp)); position += sizeof(event.timestamp);
+			ring->read(position, &count, sizeof(count)); position += sizeof(count);
+
+			for (uint8_t i = 0; i < count; ++i) {
+				EventArg arg{ EventArgSigned, 0, std::string() };
+				uint8_t kind;
+				ring->read(position, &kind, 1); position += 1;
+				arg.kind = (event_arg_kind)kind;
+				if (arg.kind == EventArgString) {
+					uint32_t length;
+					ring->read(position, &length, sizeof(length)); position += sizeof(length);
+					arg.text.resize(length);
+					if (length > 0) {
+						ring->read(position, &arg.text[0], length);
+					}
+					position += length;
+				}
+				else {
+					ring->read(position, &arg.raw, sizeof(arg.raw)); position += sizeof(arg.raw);
+				}
+				event.args.push_back(std::move(arg));
+			}
+
+			events.push_back(std::move(event));
+			head += size;
+		}
+		heads.push_back(head);
+	}
+
+	if (events.empty()) {
+		return false;
+	}
+
+	// every ring is in order on its own, merge them by timestamp
+	std::stable_sort(events.begin(), events.end(), [](const DecodedEvent& a, const DecodedEvent& b) {
+		return a.timestamp < b.timestamp;
+	});
+
+	std::vector<std::string> lines;
+	lines.reserve(events.size());
+	for (const auto& event : events) {
+		lines.push_back(format_event(event.site->format, event.args));
+	}
+	RaftVisualizer::getInstance()->add_logs(std::move(lines));
+	_delivered.fetch_add(events.size(), std::memory_order_relaxed);
+
+	// room is handed back only once delivered, flush() relies on it
+	for (size_t i = 0; i < rings.size(); ++i) {
+		rings[i]->release(heads[i]);
+	}
+	return true;
+}
+
+void raft::EventLog::drain_loop()
+{
+	while (true) {
+		bool finished = _finished.load();
+		bool drained = drain_once();
+
+		{
+			std::lock_guard<std::mutex> lk(_mtx);
+			_rings.erase(std::remove_if(_rings.begin(), _rings.end(), [](const std::shared_ptr<EventRing>& ring) {
+				return ring->abandoned.load(std::memory_order_acquire) && ring->empty();
+			}), _rings.end());
+		}
+
+		if (finished) {
+			return;
+		}
+
+		if (!drained) {
+			std::unique_lock<std::mutex> lk(_mtx);
+			_cv.wait_for(lk, std::chrono::milliseconds(1), [this]() { return _finished.load(); });
+		}
+	}
+}
@@ -0,0 +1,228 @@
+#pragma once
+#include "Singleton.h"
+#include "RaftMetrics.h"
+#include "Format.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace raft {
+	// one per ADD_LOG call site, its address is the format id written into the ring
+	struct EventSite {
+		const char* format;
+		const char* file;
+		int line;
+	};
+
+	enum event_arg_kind : uint8_t {
+		EventArgSigned,
+		EventArgUnsigned,
+		EventArgDouble,
+		EventArgString,
+		EventArgPointer,
+	};
+
+	// single producer (the owning thread) single consumer (the drain thread) byte ring.
+	// a record is [u32 size][site*][i64 timestamp][u8 arg count][args...], args are a kind byte
+	// followed by 8 raw bytes or a u32 length and the string bytes
+	class EventRing {
+	private:
+		std::vector<char> _buffer;
+		size_t _mask;
+		alignas(64) std::atomic<size_t> _head;
+		alignas(64) std::atomic<size_t> _tail;
+		size_t _cursor;
+
+	public:
+		std::atomic<bool> abandoned;
+
+		EventRing(size_t capacity_pow2) : _buffer(capacity_pow2), _mask(capacity_pow2 - 1), _head(0), _tail(0), _cursor(0), abandoned(false) {}
+
+		size_t capacity() const { return _buffer.size(); }
+
+		bool empty() const { return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire); }
+
+		// producer side: wait until size bytes fit, then put() them and commit()
+		bool has_room(size_t size) const {
+			return capacity() - (_cursor - _head.load(std::memory_order_acquire)) >= size;
+		}
+
+		void put(const void* data, size_t size) {
+			size_t offset = _cursor & _mask;
+			_cursor += size;
+			if (offset + size <= _buffer.size()) {
+				memcpy(&_buffer[offset], data, size);
+				return;
+			}
+			size_t first = capacity() - offset;
+			memcpy(&_buffer[offset], data, first);
+			memcpy(&_buffer[0], (const char*)data + first, size - first);
+		}
+
+		void commit() {
+			_tail.store(_cursor, std::memory_order_release);
+		}
+
+		// consumer side
+		size_t get_head() const { return _head.load(std::memory_order_relaxed); }
+
+		size_t get_tail() const { return _tail.load(std::memory_order_acquire); }
+
+		void read(size_t position, void* out, size_t size) const {
+			size_t offset = position & _mask;
+			size_t first = std::min(size, capacity() - offset);
+			memcpy(out, &_buffer[offset], first);
+			memcpy((char*)out + first, &_buffer[0], size - first);
+		}
+
+		void release(size_t position) {
+			_head.store(position, std::memory_order_release);
+		}
+	};
+
+	namespace event_detail {
+		// strings are cut here so any record fits in a ring
+		constexpr uint32_t max_string_bytes = 1024;
+
+		inline uint32_t clip(size_t length) {
+			return (uint32_t)std::min<size_t>(length, max_string_bytes);
+		}
+
+		template <typename T>
+		size_t arg_size(const T& value) {
+			using U = std::decay_t<T>;
+			if constexpr (std::is_same<U, const char*>::value || std::is_same<U, char*>::value) {
+				return 1 + sizeof(uint32_t) + (value ? clip(strlen(value)) : 0);
+			}
+			else if constexpr (std::is_same<U, std::string>::value || std::is_same<U, std::string_view>::value) {
+				return 1 + sizeof(uint32_t) + clip(value.size());
+			}
+			else {
+				return 1 + sizeof(uint64_t);
+			}
+		}
+
+		inline void put_string(EventRing& ring, const char* value, uint32_t length) {
+			uint8_t kind = EventArgString;
+			ring.put(&kind, 1);
+			ring.put(&length, sizeof(length));
+			ring.put(value, length);
+		}
+
+		inline void put_raw(EventRing& ring, event_arg_kind kind, uint64_t raw) {
+			uint8_t tag = kind;
+			ring.put(&tag, 1);
+			ring.put(&raw, sizeof(raw));
+		}
+
+		template <typename T>
+		void put_arg(EventRing& ring, const T& value) {
+			using U = std::decay_t<T>;
+			if constexpr (std::is_same<U, const char*>::value || std::is_same<U, char*>::value) {
+				put_string(ring, value ? value : "", value ? clip(strlen(value)) : 0);
+			}
+			else if constexpr (std::is_same<U, std::string>::value || std::is_same<U, std::string_view>::value) {
+				put_string(ring, value.data(), clip(value.size()));
+			}
+			else if constexpr (std::is_floating_point<U>::value) {
+				double d = (double)value;
+				uint64_t raw;
+				memcpy(&raw, &d, sizeof(raw));
+				put_raw(ring, EventArgDouble, raw);
+			}
+			else if constexpr (std::is_pointer<U>::value) {
+				put_raw(ring, EventArgPointer, (uint64_t)(uintptr_t)value);
+			}
+			else if constexpr (std::is_null_pointer<U>::value) {
+				put_raw(ring, EventArgPointer, 0);
+			}
+			else if constexpr (std::is_enum<U>::value || std::is_signed<U>::value) {
+				put_raw(ring, EventArgSigned, (uint64_t)(int64_t)value);
+			}
+			else {
+				static_assert(std::is_integral<U>::value, "ADD_LOG arguments must be numbers, pointers or strings");
+				put_raw(ring, EventArgUnsigned, (uint64_t)value);
+			}
+		}
+	}
+
+	// binary structured log: node threads copy a site pointer, a timestamp and the raw arguments
+	// into their own ring, the drain thread formats them in timestamp order and hands the lines to
+	// the visualizer. a full ring makes the producer wait for the drain, events are never dropped
+	class EventLog : public CSingleton<EventLog>
+	{
+	private:
+		std::mutex _mtx;
+		std::condition_variable _cv;
+		std::vector<std::shared_ptr<EventRing>> _rings;
+		std::atomic<bool> _finished;
+		std::atomic<uint64_t> _delivered;
+		std::atomic<uint64_t> _stalls;
+		std::thread _drain;
+
+	public:
+		EventLog();
+
+		~EventLog();
+
+		template <typename... Args>
+		void log(const EventSite* site, const Args&... args) {
+			static_assert(sizeof...(Args) <= 32, "too many ADD_LOG arguments for one ring record");
+			EventRing& ring = this_thread_ring();
+			int64_t now = metrics_now_ns();
+			uint8_t count = (uint8_t)sizeof...(Args);
+			uint32_t size = (uint32_t)(sizeof(uint32_t) + sizeof(site) + sizeof(now) + sizeof(count));
+			size += (uint32_t)(0 + ... + event_detail::arg_size(args));
+
+			if (!ring.has_room(size)) {
+				wait_for_room(ring, size);
+			}
+
+			ring.put(&size, sizeof(size));
+			ring.put(&site, sizeof(site));
+			ring.put(&now, sizeof(now));
+			ring.put(&count, sizeof(count));
+			(event_detail::put_arg(ring, args), ...);
+			ring.commit();
+		}
+
+		// blocks until every event logged before the call has been formatted and delivered
+		void flush();
+
+		uint64_t get_delivered() const { return _delivered.load(std::memory_order_relaxed); }
+
+		// producers that had to wait for the drain thread to make room
+		uint64_t get_stalls() const { return _stalls.load(std::memory_order_relaxed); }
+
+	private:
+		EventRing& this_thread_ring();
+
+		void wait_for_room(EventRing& ring, size_t size);
+
+		bool drain_once();
+
+		void drain_loop();
+	};
+
+	// decoded ring arguments rendered through Format's engine
+	struct EventArg {
+		event_arg_kind kind;
+		uint64_t raw;
+		std::string text;
+	};
+
+	std::string format_event(const char* format, const std::vector<EventArg>& args);
+}
+
+#define ADD_LOG(fmt, ...)\
+do { FORMAT_CHECK(fmt, ##__VA_ARGS__); static const raft::EventSite _event_site{ fmt, __FILE__, __LINE__ }; raft::EventLog::getInstance()->log(&_event_site, ##__VA_ARGS__); } while (0)
@@ -1,14 +1,18 @@
 #include "HeartbeatModule.h"
 #include "RaftConsensus.h"
+#include "ThreadPlacement.h"
 
 void raft::HeartbeatModule::start()
 {
 	owner->get_router()->send_heartbeat_request(owner->get_term(), owner->get_tag());
 
 	worker = std::thread([this]() {
+		pin_current_thread(owner->get_placement(owner->get_router()->get_config().heartbeat_cpus));
+
 		while (!finished) {
 			std::unique_lock<std::mutex> lk(mtx);
-			cv.wait_for(lk, std::chrono::milliseconds(1000), [this]() { return finished; });
+			auto interval = std::chrono::duration<double, std::milli>(owner->get_router()->get_config().heartbeat_interval_ms * owner->get_clock_skew());
+			cv.wait_for(lk, interval, [this]() { return finished; });
 
 			if (finished) {
 				return;
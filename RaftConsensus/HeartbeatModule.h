@@ -5,6 +5,23 @@
 namespace raft {
 	class RaftRouter;
 	class RaftNode;
+
+	// stands in for a node's wall clock timers, the election deadline and the HeartbeatModule thread.
+	// a driver that runs nodes on its own clock (ElectionSimulator) implements it and calls back into
+	// the node when a timer fires
+	class NodeTimers {
+	public:
+		virtual ~NodeTimers() = default;
+
+		// replaces the pending election timeout, the earlier one no longer fires
+		virtual void arm_election_timer(RaftNode* node, double timeout_ms) = 0;
+
+		// one heartbeat now and then one every heartbeat interval until stop_heartbeats
+		virtual void start_heartbeats(RaftNode* node) = 0;
+
+		virtual void stop_heartbeats(RaftNode* node) = 0;
+	};
+
 	class HeartbeatModule {
 	private:
 		bool finished;
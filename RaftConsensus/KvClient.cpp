@@ -0,0 +1,102 @@
+#include "KvClient.h"
+#include "RaftConsensus.h"
+
+#include <atomic>
+
+static uint64_t next_client_id() {
+	static std::atomic<uint64_t> id{ 0 };
+	static const uint64_t seed = std::random_device{}();
+	return (seed << 32) | ++id;
+}
+
+raft::KvClient::KvClient(RaftRouter* router, int max_attempts, std::chrono::milliseconds attempt_timeout)
+	:
+	_router(router),
+	_client_id(next_client_id()),
+	_seq(0),
+	_max_attempts(max_attempts),
+	_attempt_timeout(attempt_timeout)
+{
+}
+
+raft::KvResult raft::KvClient::get(const std::string& key)
+{
+	return execute(KvGet, key, {}, {});
+}
+
+raft::KvResult raft::KvClient::put(const std::string& key, const std::string& value)
+{
+	return execute(KvPut, key, value, {});
+}
+
+raft::KvResult raft::KvClient::del(const std::string& key)
+{
+	return execute(KvDelete, key, {}, {});
+}
+
+raft::KvResult raft::KvClient::compare_and_swap(const std::string& key, const std::string& expected, const std::string& desired)
+{
+	return execute(KvCompareAndSwap, key, desired, expected);
+}
+
+raft::KvResult raft::KvClient::execute(kv_op op, const std::string& key, const std::string& value, const std::string& expected)
+{
+	KvCommand command{ op, _client_id, ++_seq, key, value, expected };
+	const std::string encoded = command.encode();
+
+	for (int attempt = 0; attempt < _max_attempts; ++attempt) {
+		std::string target = pick_target();
+		auto reply = std::make_shared<std::promise<ClientReply>>();
+		auto future = reply->get_future();
+
+		if (!_router->send_client_request(target, encoded, std::move(reply))) {
+			_leader_hint.clear();
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+			continue;
+		}
+
+		if (future.wait_for(_attempt_timeout) != std::future_status::ready) {
+			_leader_hint.clear();
+			continue;
+		}
+
+		ClientReply result;
+		try {
+			result = future.get();
+		}
+		catch (const std::future_error&) {
+			// the node went down with the request still queued
+			_leader_hint.clear();
+			continue;
+		}
+
+		if (result.status == ClientOk) {
+			_leader_hint = result.leader_hint;
+			return KvResult::decode(result.response);
+		}
+
+		if (result.status == ClientBusy) {
+			// the leader's apply stage is behind, same leader after a short pause
+			_leader_hint = result.leader_hint;
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			continue;
+		}
+
+		// redirect to the leader the node knows about, back off while an election is running
+		_leader_hint = result.leader_hint;
+		if (_leader_hint.empty() || _leader_hint == target) {
+			_leader_hint.clear();
+			std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		}
+	}
+
+	return KvResult{ KvTimeout, {} };
+}
+
+std::string raft::KvClient::pick_target()
+{
+	if (!_leader_hint.empty()) {
+		return _leader_hint;
+	}
+	return _router->get_random_node()->get_tag();
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "KvStateMachine.h"
+
+#include <chrono>
+#include <string>
+
+namespace raft {
+	class RaftRouter;
+
+	// linearizable front end: every operation (reads included) goes through the leader's log,
+	// retries carry the same sequence number so the state machine applies them at most once
+	class KvClient {
+	private:
+		RaftRouter* _router;
+		uint64_t _client_id;
+		uint64_t _seq;
+		std::string _leader_hint;
+		int _max_attempts;
+		std::chrono::milliseconds _attempt_timeout;
+
+	public:
+		KvClient(RaftRouter* router, int max_attempts = 20, std::chrono::milliseconds attempt_timeout = std::chrono::milliseconds(3000));
+
+		KvResult get(const std::string& key);
+
+		KvResult put(const std::string& key, const std::string& value);
+
+		KvResult del(const std::string& key);
+
+		KvResult compare_and_swap(const std::string& key, const std::string& expected, const std::string& desired);
+
+		const std::string& get_leader_hint() const { return _leader_hint; }
+
+	private:
+		KvResult execute(kv_op op, const std::string& key, const std::string& value, const std::string& expected);
+
+		std::string pick_target();
+	};
+}
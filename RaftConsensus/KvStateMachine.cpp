@@ -0,0 +1,135 @@
+#include "KvStateMachine.h"
+
+#include <cstring>
+
+static void put_u32(std::string& out, uint32_t value) {
+	out.append((const char*)&value, sizeof(value));
+}
+
+static void put_u64(std::string& out, uint64_t value) {
+	out.append((const char*)&value, sizeof(value));
+}
+
+static void put_bytes(std::string& out, const std::string& bytes) {
+	put_u32(out, (uint32_t)bytes.size());
+	out.append(bytes);
+}
+
+template<typename T>
+static bool get_pod(const std::string& in, size_t& pos, T& value) {
+	if (pos + sizeof(T) > in.size()) {
+		return false;
+	}
+	memcpy(&value, in.data() + pos, sizeof(T));
+	pos += sizeof(T);
+	return true;
+}
+
+static bool get_bytes(const std::string& in, size_t& pos, std::string& bytes) {
+	uint32_t length = 0;
+	if (!get_pod(in, pos, length) || pos + length > in.size()) {
+		return false;
+	}
+	bytes.assign(in.data() + pos, length);
+	pos += length;
+	return true;
+}
+
+std::string raft::KvCommand::encode() const
+{
+	std::string out;
+	out.reserve(1 + 16 + 12 + key.size() + value.size() + expected.size());
+	out.push_back((char)op);
+	put_u64(out, client_id);
+	put_u64(out, seq);
+	put_bytes(out, key);
+	put_bytes(out, value);
+	put_bytes(out, expected);
+	return out;
+}
+
+bool raft::KvCommand::decode(const std::string& bytes, KvCommand& command)
+{
+	size_t pos = 0;
+	uint8_t op = 0;
+	if (!get_pod(bytes, pos, op) || op > KvCompareAndSwap) {
+		return false;
+	}
+	command.op = (kv_op)op;
+	return get_pod(bytes, pos, command.client_id)
+		&& get_pod(bytes, pos, command.seq)
+		&& get_bytes(bytes, pos, command.key)
+		&& get_bytes(bytes, pos, command.value)
+		&& get_bytes(bytes, pos, command.expected);
+}
+
+std::string raft::KvResult::encode() const
+{
+	std::string out;
+	out.reserve(1 + value.size());
+	out.push_back((char)status);
+	out.append(value);
+	return out;
+}
+
+raft::KvResult raft::KvResult::decode(const std::string& bytes)
+{
+	if (bytes.empty()) {
+		return KvResult{ KvNotFound, {} };
+	}
+	return KvResult{ (kv_status)bytes[0], bytes.substr(1) };
+}
+
+std::string raft::KvStateMachine::apply(const std::string& command)
+{
+	// empty commands are the no-op entries a new leader appends
+	KvCommand decoded;
+	if (command.empty() || !KvCommand::decode(command, decoded)) {
+		return {};
+	}
+
+	// retried commands are answered from the session, never applied twice
+	auto& session = _sessions[decoded.client_id];
+	if (decoded.seq != 0 && decoded.seq <= session.last_seq) {
+		return session.last_reply;
+	}
+
+	std::string reply = execute(decoded).encode();
+	if (decoded.seq != 0) {
+		session.last_seq = decoded.seq;
+		session.last_reply = reply;
+	}
+	return reply;
+}
+
+raft::KvResult raft::KvStateMachine::execute(const KvCommand& command)
+{
+	KvResult result{ KvOk, {} };
+	switch (command.op) {
+	case KvGet:
+		if (!_store.get(command.key, result.value)) {
+			result.status = KvNotFound;
+		}
+		break;
+	case KvPut:
+		_store.put(command.key, command.value);
+		break;
+	case KvDelete:
+		if (!_store.erase(command.key)) {
+			result.status = KvNotFound;
+		}
+		break;
+	case KvCompareAndSwap:
+		if (!_store.get(command.key, result.value)) {
+			result.status = KvNotFound;
+		}
+		else if (result.value != command.expected) {
+			result.status = KvCompareFailed;
+		}
+		else {
+			_store.put(command.key, command.value);
+		}
+		break;
+	}
+	return result;
+}
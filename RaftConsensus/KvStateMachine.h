@@ -0,0 +1,63 @@
+#pragma once
+
+#include "RaftLog.h"
+#include "KvStore.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+namespace raft {
+	enum kv_op : uint8_t {
+		KvGet,
+		KvPut,
+		KvDelete,
+		KvCompareAndSwap,
+	};
+
+	enum kv_status : uint8_t {
+		KvOk,
+		KvNotFound,
+		KvCompareFailed,
+		KvTimeout,
+	};
+
+	struct KvCommand {
+		kv_op op;
+		uint64_t client_id;
+		uint64_t seq;
+		std::string key;
+		std::string value;
+		std::string expected;
+
+		std::string encode() const;
+		static bool decode(const std::string& bytes, KvCommand& command);
+	};
+
+	struct KvResult {
+		kv_status status;
+		std::string value;
+
+		std::string encode() const;
+		static KvResult decode(const std::string& bytes);
+	};
+
+	class KvStateMachine : public StateMachine {
+	private:
+		struct ClientSession {
+			uint64_t last_seq;
+			std::string last_reply;
+		};
+
+		KvStore _store;
+		std::unordered_map<uint64_t, ClientSession> _sessions;
+
+	public:
+		virtual std::string apply(const std::string& command) override;
+
+		const KvStore& get_store() const { return _store; }
+
+	private:
+		KvResult execute(const KvCommand& command);
+	};
+}
@@ -0,0 +1,177 @@
+#include "KvStore.h"
+
+#include <cstring>
+
+static const size_t npos = (size_t)-1;
+
+static size_t round_up_pow2(size_t n) {
+	size_t capacity = 8;
+	while (capacity < n) {
+		capacity <<= 1;
+	}
+	return capacity;
+}
+
+raft::KvStore::KvStore(size_t initial_capacity)
+	:
+	_slots(round_up_pow2(initial_capacity), Slot{ 0, 0, 0, 0, 0, Empty }),
+	_size(0),
+	_tombstones(0),
+	_garbage_bytes(0)
+{
+}
+
+bool raft::KvStore::get(std::string_view key, std::string& value) const
+{
+	size_t pos = find_slot(key, hash_of(key));
+	if (pos == npos || _slots[pos].state != Used) {
+		return false;
+	}
+
+	auto bytes = value_of(_slots[pos]);
+	value.assign(bytes.data(), bytes.size());
+	return true;
+}
+
+void raft::KvStore::put(std::string_view key, std::string_view value)
+{
+	if ((_size + _tombstones + 1) * 10 > _slots.size() * 7) {
+		rehash(_size * 2 > _slots.size() ? _slots.size() * 2 : _slots.size());
+	}
+
+	uint64_t hash = hash_of(key);
+	size_t pos = find_slot(key, hash);
+	Slot& slot = _slots[pos];
+
+	if (slot.state == Used) {
+		if (value.size() <= slot.value_length) {
+			memcpy(&_arena[slot.value_offset], value.data(), value.size());
+			_garbage_bytes += slot.value_length - value.size();
+		}
+		else {
+			_garbage_bytes += slot.value_length;
+			slot.value_offset = store(value);
+		}
+		slot.value_length = (uint32_t)value.size();
+	}
+	else {
+		if (slot.state == Deleted) {
+			--_tombstones;
+		}
+		slot.hash = hash;
+		slot.key_offset = store(key);
+		slot.key_length = (uint32_t)key.size();
+		slot.value_offset = store(value);
+		slot.value_length = (uint32_t)value.size();
+		slot.state = Used;
+		++_size;
+	}
+
+	if (_garbage_bytes > 4096 && _garbage_bytes * 2 > _arena.size()) {
+		compact();
+	}
+}
+
+bool raft::KvStore::erase(std::string_view key)
+{
+	size_t pos = find_slot(key, hash_of(key));
+	if (pos == npos || _slots[pos].state != Used) {
+		return false;
+	}
+
+	Slot& slot = _slots[pos];
+	slot.state = Deleted;
+	_garbage_bytes += slot.key_length + slot.value_length;
+	--_size;
+	++_tombstones;
+	return true;
+}
+
+uint64_t raft::KvStore::hash_of(std::string_view key)
+{
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ull;
+	for (char c : key) {
+		hash ^= (uint8_t)c;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+std::string_view raft::KvStore::key_of(const Slot& slot) const
+{
+	return std::string_view(_arena.data() + slot.key_offset, slot.key_length);
+}
+
+std::string_view raft::KvStore::value_of(const Slot& slot) const
+{
+	return std::string_view(_arena.data() + slot.value_offset, slot.value_length);
+}
+
+// returns the slot holding key, otherwise the first reusable slot on its probe chain
+size_t raft::KvStore::find_slot(std::string_view key, uint64_t hash) const
+{
+	size_t mask = _slots.size() - 1;
+	size_t reusable = npos;
+	for (size_t pos = hash & mask;; pos = (pos + 1) & mask) {
+		const Slot& slot = _slots[pos];
+		if (slot.state == Empty) {
+			return reusable != npos ? reusable : pos;
+		}
+		if (slot.state == Deleted) {
+			if (reusable == npos) {
+				reusable = pos;
+			}
+		}
+		else if (slot.hash == hash && key_of(slot) == key) {
+			return pos;
+		}
+	}
+}
+
+uint32_t raft::KvStore::store(std::string_view bytes)
+{
+	uint32_t offset = (uint32_t)_arena.size();
+	_arena.insert(_arena.end(), bytes.begin(), bytes.end());
+	return offset;
+}
+
+void raft::KvStore::rehash(size_t capacity)
+{
+	std::vector<Slot> old = std::move(_slots);
+	_slots.assign(round_up_pow2(capacity), Slot{ 0, 0, 0, 0, 0, Empty });
+	_tombstones = 0;
+
+	size_t mask = _slots.size() - 1;
+	for (const auto& slot : old) {
+		if (slot.state != Used) {
+			continue;
+		}
+		size_t pos = slot.hash & mask;
+		while (_slots[pos].state != Empty) {
+			pos = (pos + 1) & mask;
+		}
+		_slots[pos] = slot;
+	}
+}
+
+void raft::KvStore::compact()
+{
+	std::vector<char> arena;
+	arena.reserve(_arena.size() - _garbage_bytes);
+
+	for (auto& slot : _slots) {
+		if (slot.state != Used) {
+			continue;
+		}
+		uint32_t key_offset = (uint32_t)arena.size();
+		arena.insert(arena.end(), _arena.begin() + slot.key_offset, _arena.begin() + slot.key_offset + slot.key_length);
+		uint32_t value_offset = (uint32_t)arena.size();
+		arena.insert(arena.end(), _arena.begin() + slot.value_offset, _arena.begin() + slot.value_offset + slot.value_length);
+		slot.key_offset = key_offset;
+		slot.value_offset = value_offset;
+	}
+
+	_arena = std::move(arena);
+	_garbage_bytes = 0;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace raft {
+	// open addressing (linear probing) hash map, keys and values live in one byte arena
+	class KvStore {
+	private:
+		enum slot_state : uint8_t {
+			Empty,
+			Used,
+			Deleted,
+		};
+
+		struct Slot {
+			uint64_t hash;
+			uint32_t key_offset;
+			uint32_t key_length;
+			uint32_t value_offset;
+			uint32_t value_length;
+			slot_state state;
+		};
+
+		std::vector<Slot> _slots;
+		std::vector<char> _arena;
+		size_t _size;
+		size_t _tombstones;
+		size_t _garbage_bytes;
+
+	public:
+		KvStore(size_t initial_capacity = 64);
+
+		bool get(std::string_view key, std::string& value) const;
+
+		void put(std::string_view key, std::string_view value);
+
+		bool erase(std::string_view key);
+
+		size_t size() const { return _size; }
+
+		size_t arena_bytes() const { return _arena.size(); }
+
+	private:
+		static uint64_t hash_of(std::string_view key);
+
+		std::string_view key_of(const Slot& slot) const;
+
+		std::string_view value_of(const Slot& slot) const;
+
+		size_t find_slot(std::string_view key, uint64_t hash) const;
+
+		uint32_t store(std::string_view bytes);
+
+		void rehash(size_t capacity);
+
+		void compact();
+	};
+}
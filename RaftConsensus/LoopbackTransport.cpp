@@ -0,0 +1,223 @@
+#include "LoopbackTransport.h"
+#include "RaftConsensus.h"
+#include "RaftWire.h"
+
+#include <cstring>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+
+using socket_handle = SOCKET;
+static const socket_handle invalid_socket = INVALID_SOCKET;
+static const int send_flags = 0;
+
+static void close_socket(socket_handle s) { closesocket(s); }
+static void shutdown_socket(socket_handle s) { shutdown(s, SD_BOTH); }
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using socket_handle = int;
+static const socket_handle invalid_socket = -1;
+static const int send_flags = MSG_NOSIGNAL;
+
+static void close_socket(socket_handle s) { close(s); }
+static void shutdown_socket(socket_handle s) { shutdown(s, SHUT_RDWR); }
+#endif
+
+namespace {
+	void startup_sockets() {
+#if defined(_WIN32)
+		static bool started = []() {
+			WSADATA data;
+			return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+		}();
+		(void)started;
+#endif
+	}
+
+	// connected pair over 127.0.0.1 through a throwaway listener on an ephemeral port
+	bool connect_pair(socket_handle& sender, socket_handle& receiver) {
+		sender = receiver = invalid_socket;
+		socket_handle listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		if (listener == invalid_socket) {
+			return false;
+		}
+
+		sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = 0;
+		socklen_t addr_len = sizeof(addr);
+
+		bool ok = bind(listener, (sockaddr*)&addr, sizeof(addr)) == 0
+			&& listen(listener, 1) == 0
+			&& getsockname(listener, (sockaddr*)&addr, &addr_len) == 0;
+
+		if (ok) {
+			sender = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+			ok = sender != invalid_socket && connect(sender, (sockaddr*)&addr, sizeof(addr)) == 0;
+		}
+		if (ok) {
+			receiver = accept(listener, nullptr, nullptr);
+			ok = receiver != invalid_socket;
+		}
+		close_socket(listener);
+
+		if (!ok) {
+			if (sender != invalid_socket) close_socket(sender);
+			if (receiver != invalid_socket) close_socket(receiver);
+			sender = receiver = invalid_socket;
+			return false;
+		}
+
+		// raft traffic is small request/response frames, do not wait for coalescing
+		int one = 1;
+		setsockopt(sender, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+		return true;
+	}
+
+	bool send_all(socket_handle s, const char* data, size_t size) {
+		while (size > 0) {
+			int sent = ::send(s, data, (int)std::min<size_t>(size, 1 << 30), send_flags);
+			if (sent <= 0) {
+				return false;
+			}
+			data += sent;
+			size -= sent;
+		}
+		return true;
+	}
+}
+
+struct raft::LoopbackTransport::Link {
+	RaftNode* node;
+	socket_handle sender;
+	socket_handle receiver;
+	std::mutex send_mtx;
+	std::string frame;
+	std::thread reader;
+
+	Link(RaftNode* node_in) : node(node_in), sender(invalid_socket), receiver(invalid_socket) {}
+
+	// frames are a 4 byte length, the 8 byte trace_record and the encoded message. the record rides
+	// outside the encoding, which is also what the trace keeps of a message
+	void read_loop() {
+		const size_t header = sizeof(uint32_t) + sizeof(uint64_t);
+		std::vector<char> buffer(64 << 10);
+		size_t filled = 0;
+
+		while (true) {
+			if (filled == buffer.size()) {
+				buffer.resize(buffer.size() * 2);
+			}
+			int received = recv(receiver, buffer.data() + filled, (int)(buffer.size() - filled), 0);
+			if (received <= 0) {
+				return;
+			}
+			filled += received;
+
+			size_t offset = 0;
+			while (filled - offset >= header) {
+				uint32_t length;
+				memcpy(&length, buffer.data() + offset, sizeof(length));
+				if (filled - offset - header < length) {
+					if (header + length > buffer.size()) {
+						buffer.resize(header + length);
+					}
+					break;
+				}
+
+				RaftMessage message = decode_message(buffer.data() + offset + header, length);
+				if (message) {
+					memcpy(&message->trace_record, buffer.data() + offset + sizeof(length), sizeof(message->trace_record));
+					node->offer_message(std::move(message));
+				}
+				offset += header + length;
+			}
+
+			if (offset > 0) {
+				memmove(buffer.data(), buffer.data() + offset, filled - offset);
+				filled -= offset;
+			}
+		}
+	}
+};
+
+raft::LoopbackTransport::LoopbackTransport(const std::vector<RaftNode*>& nodes)
+{
+	startup_sockets();
+
+	for (auto node : nodes) {
+		std::unique_ptr<Link> link(new Link(node));
+		if (!connect_pair(link->sender, link->receiver)) {
+			ADD_LOG("loopback transport: no connection for %s, delivering in process", node->get_tag().c_str());
+			continue;
+		}
+
+		Link* raw = link.get();
+		link->reader = std::thread([raw]() { raw->read_loop(); });
+		_links.push_back(std::move(link));
+	}
+}
+
+raft::LoopbackTransport::~LoopbackTransport()
+{
+	stop();
+}
+
+bool raft::LoopbackTransport::send(RaftNode* target, const BaseMessage& message)
+{
+	for (auto& link : _links) {
+		if (link->node != target) {
+			continue;
+		}
+
+		std::lock_guard<std::mutex> lk(link->send_mtx);
+		if (link->sender == invalid_socket) {
+			return false;
+		}
+
+		std::string& frame = link->frame;
+		const size_t header = sizeof(uint32_t) + sizeof(uint64_t);
+		frame.assign(header, '\0');
+		encode_message(message, frame);
+		uint32_t length = (uint32_t)(frame.size() - header);
+		memcpy(&frame[0], &length, sizeof(length));
+		memcpy(&frame[sizeof(length)], &message.trace_record, sizeof(message.trace_record));
+		return send_all(link->sender, frame.data(), frame.size());
+	}
+	return false;
+}
+
+void raft::LoopbackTransport::stop()
+{
+	for (auto& link : _links) {
+		std::lock_guard<std::mutex> lk(link->send_mtx);
+		if (link->sender != invalid_socket) {
+			shutdown_socket(link->sender);
+		}
+	}
+
+	for (auto& link : _links) {
+		if (link->reader.joinable()) {
+			link->reader.join();
+		}
+
+		std::lock_guard<std::mutex> lk(link->send_mtx);
+		if (link->sender != invalid_socket) {
+			close_socket(link->sender);
+			link->sender = invalid_socket;
+		}
+		if (link->receiver != invalid_socket) {
+			close_socket(link->receiver);
+			link->receiver = invalid_socket;
+		}
+	}
+}
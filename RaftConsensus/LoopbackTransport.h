@@ -0,0 +1,28 @@
+#pragma once
+#include "RaftMessage.h"
+
+#include <memory>
+#include <vector>
+
+namespace raft {
+	class RaftNode;
+
+	// carries peer messages over a 127.0.0.1 TCP connection per destination node instead of
+	// pushing them straight into the inbox. a reader thread per link decodes frames and offers
+	// them to the node, so the inbox budget still applies on the receiving side
+	class LoopbackTransport {
+	private:
+		struct Link;
+		std::vector<std::unique_ptr<Link>> _links;
+
+	public:
+		LoopbackTransport(const std::vector<RaftNode*>& nodes);
+
+		~LoopbackTransport();
+
+		// false when the node has no link or the connection is gone
+		bool send(RaftNode* target, const BaseMessage& message);
+
+		void stop();
+	};
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace raft {
+	struct RaftConfig {
+		// per destination inbox budget, the router drops what does not fit (raft retries on its own)
+		size_t max_queue_messages = 4096;
+		size_t max_queue_bytes = 16 << 20;
+
+		// leader side replication flow control
+		int max_append_entries = 64;
+		size_t max_append_bytes = 1 << 20;
+		int max_inflight_appends = 4;
+
+		// entries a node may have appended but not applied before it pushes back
+		int max_apply_lag = 1024;
+		size_t apply_queue_capacity = 1024;
+
+		// election timing, a follower draws a fresh timeout from [min, max] on every reset
+		int election_timeout_min_ms = 3000;
+		int election_timeout_max_ms = 10000;
+		int heartbeat_interval_ms = 1000;
+
+		// simulated network delay on vote traffic, slept on the sending node's thread
+		int vote_delay_ms = 2000;
+
+		// route peer messages through loopback TCP sockets instead of straight into the target inbox
+		bool loopback_tcp = false;
+
+		// records every delivered message into this file when set, see RaftTrace.h
+		std::string trace_path;
+		size_t trace_capacity_bytes = 256 << 20;
+
+		// cpu each node's worker and heartbeat thread is pinned to, by the order nodes were added to the
+		// router. a missing entry or -1 leaves that thread to the os, see ThreadPlacement.h
+		std::vector<int> node_cpus;
+		std::vector<int> heartbeat_cpus;
+	};
+}
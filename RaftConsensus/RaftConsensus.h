@@ -5,24 +5,48 @@
 #include "RaftState.h"
 #include "RaftVisualizer.h"
 #include "HeartbeatModule.h"
+#include "ApplyModule.h"
+#include "RaftLog.h"
+#include "KvStateMachine.h"
+#include "ThreadPlacement.h"
 
 using namespace std;
 
 namespace raft {
 	class RaftNode {
 		friend class MessageProcessor;
+		friend class TraceReplayer;
+		friend class ElectionSimulator;
 	private:
 		RaftRouter* _router;
 		MessageProcessor* _processor;
 		RaftStateNode _inner_state;
 
 		string _tag;
+		NodeMetrics _metrics;
+		int64_t _election_started_at;
 		bool   _finished;
+		bool   _started;
 		std::thread _work;
 		std::mutex _mtx;
 		std::condition_variable _cv;
 		std::queue<RaftMessage> _que;
+		std::vector<RaftMessage> _batch;
+		size_t _queued_bytes;
+		std::atomic<int> _dropped_messages;
+		std::atomic<double> _clock_skew;
 		std::unique_ptr<HeartbeatModule> _heartbeater;
+		// null runs the timers on wall time
+		NodeTimers* _timers;
+
+		RaftLog _log;
+		std::unique_ptr<ApplyModule> _applier;
+		int _last_dispatched;
+		std::shared_ptr<RaftStateSlot> _state_slot;
+		string _leader_tag;
+		std::unordered_map<string, FollowerProgress> _progress;
+		std::map<int, PendingRequest> _pending;
+		std::chrono::steady_clock::time_point _election_deadline;
 		
 		std::promise<void> _init_signal;
 		std::future<void> _init;
@@ -33,10 +57,21 @@ namespace raft {
 			_processor(new MessageProcessor(this)),
 			_inner_state{tag},
 			_tag(std::move(tag)),
+			_metrics(_tag),
+			_election_started_at(0),
 			_finished(false),
+			_started(false),
+			_queued_bytes(0),
+			_dropped_messages(0),
+			_clock_skew(1.0),
+			_timers(nullptr),
+			_applier(new ApplyModule(std::make_unique<KvStateMachine>(), router->get_config().apply_queue_capacity)),
+			_last_dispatched(0),
+			_state_slot(std::make_shared<RaftStateSlot>(_inner_state.snapshot())),
 			_init_signal{},
 			_init(_init_signal.get_future())
 		{
+			RaftVisualizer::getInstance()->attach(_tag, _state_slot);
 			_work = std::thread([this]() {
 				on_work();
 			});
@@ -44,20 +79,78 @@ namespace raft {
 
 		~RaftNode() {
 			stop();
+			RaftVisualizer::getInstance()->detach(_tag, _state_slot.get());
 			delete _processor; _processor = nullptr;
 		}
 
 		void start() {
+			_started = true;
 			_init_signal.set_value();
 		}
 		
 		void push_message(RaftMessage&& message) {
+			size_t bytes = message_bytes(*message);
+			message->enqueued_at = metrics_now_ns();
 			unique_lock<mutex> lk(_mtx);
+			_queued_bytes += bytes;
 			_que.push(std::move(message));
 			lk.unlock();
 			_cv.notify_one();
 		}
 
+		// like push_message but subject to the inbox budget, a message over budget is dropped
+		bool offer_message(RaftMessage&& message) {
+			const RaftConfig& config = _router->get_config();
+			size_t bytes = message_bytes(*message);
+			message->enqueued_at = metrics_now_ns();
+			unique_lock<mutex> lk(_mtx);
+			if (_que.size() >= config.max_queue_messages || _queued_bytes + bytes > config.max_queue_bytes) {
+				lk.unlock();
+				_dropped_messages.fetch_add(1, std::memory_order_relaxed);
+				_metrics.dropped_messages.add();
+				return false;
+			}
+			_queued_bytes += bytes;
+			_que.push(std::move(message));
+			lk.unlock();
+			_cv.notify_one();
+			return true;
+		}
+
+		size_t get_queue_depth() {
+			lock_guard<mutex> lk(_mtx);
+			return _que.size();
+		}
+
+		size_t get_queued_bytes() {
+			lock_guard<mutex> lk(_mtx);
+			return _queued_bytes;
+		}
+
+		int get_dropped_messages() const {
+			return _dropped_messages.load(std::memory_order_relaxed);
+		}
+
+		// hands the election timer and heartbeats to a driver, for nodes that are never started
+		void set_timers(NodeTimers* timers) {
+			_timers = timers;
+		}
+
+		// scales this node's timers, an injected clock fault
+		void set_clock_skew(double factor) {
+			_clock_skew.store(factor > 0.0 ? factor : 1.0, std::memory_order_relaxed);
+		}
+
+		double get_clock_skew() const {
+			return _clock_skew.load(std::memory_order_relaxed);
+		}
+
+		// this node's entry in one of the placement lists of RaftConfig, -1 when it has none
+		int get_placement(const std::vector<int>& cpus) const {
+			int index = _router->index_of(_tag);
+			return index >= 0 && index < (int)cpus.size() ? cpus[index] : -1;
+		}
+
 		bool is_dead() const {
 			return _inner_state.status == Dead;
 		}
@@ -82,6 +175,15 @@ namespace raft {
 			return _inner_state;
 		}
 
+		// only safe to inspect once the node thread is stopped or quiescent
+		const StateMachine* get_state_machine() const {
+			return _applier->get_state_machine();
+		}
+
+		int get_applied_index() const {
+			return _applier->get_applied_index();
+		}
+
 		void set_dead() {
 			if (_inner_state.status != Dead) {
 				_inner_state.status = Dead;
@@ -94,77 +196,151 @@ namespace raft {
 
 		void set_restart() {
 			if (_inner_state.status == Dead) {
-				_inner_state.set_new_election_time_out();
+				reset_election_timer();
 				_inner_state.set_status(Follower);
 
 				ADD_LOG("node %s restarts", _tag.c_str());
 			}
 		}
 
-	private:
+		// joins the node thread and silences the heartbeater, the router stops every node before deleting any
 		void stop() {
 			unique_lock<mutex> lk(_mtx);
 			_finished = true;
 			lk.unlock();
 			_cv.notify_one();
 
+			// a node that never started (e.g. driven by a replay) still has its thread parked on _init
+			if (!_started) {
+				start();
+			}
+
 			if (_work.joinable()) {
 				_work.join();
 			}
+			release_heartbeater();
 		}
 
+	private:
 		void on_work() {
 			_init.wait();
-			_inner_state.set_new_election_time_out();
+			if (_finished) {
+				return;
+			}
+
+			// pinned before the drain buffer is allocated, so first touch puts it on this cpu's numa node
+			const RaftConfig& config = _router->get_config();
+			if (!pin_current_thread(get_placement(config.node_cpus))) {
+				ADD_LOG("node %s could not be pinned to cpu %d", _tag.c_str(), get_placement(config.node_cpus));
+			}
+			_batch.reserve(config.max_queue_messages);
+
+			reset_election_timer();
 
 			assert(_inner_state.term == 0);
 
-			RaftVisualizer::getInstance()->poll(this);
+			publish_state();
 
 			while (!_finished) {
 				unique_lock<mutex> lk(_mtx);
 
-				if (_inner_state.election_timeout == -1 || is_dead()) {
+				if (_last_dispatched < _inner_state.commit_index) {
+					// committed entries are waiting for room in the apply queue
+					_cv.wait_for(lk, std::chrono::milliseconds(1), [this]() { return !_que.empty() || _finished; });
+				}
+				else if (_inner_state.election_timeout == -1 || is_dead()) {
 					_cv.wait(lk, [this]() { return !_que.empty() || _finished; });
 				}
 				else {
-					_cv.wait_for(lk, std::chrono::seconds(_inner_state.election_timeout), [this]() { return !_que.empty() || _finished; });
+					_cv.wait_until(lk, _election_deadline, [this]() { return !_que.empty() || _finished; });
 				}
 
 				if (_finished) {
 					return;
 				}
 
-				vector<RaftMessage> messages;
+				vector<RaftMessage>& messages = _batch;
 				while (!_que.empty()) {
 					auto msg = std::move(_que.front()); _que.pop();
 					messages.push_back(std::move(msg));
 				}
+				_metrics.queued_bytes.set((int64_t)_queued_bytes);
+				_queued_bytes = 0;
 				lk.unlock();
 
-				if (!messages.empty()) {
-					for (auto& msg : messages) {
-						_processor->process(std::move(msg));
-					}
+				_router->trace_batch(_tag, messages);
+
+				_inner_state.queue_depth = (int)messages.size();
+				_inner_state.dropped_messages = get_dropped_messages();
+				_metrics.queue_depth.set((int64_t)messages.size());
+
+				int64_t drained_at = metrics_now_ns();
+				for (auto& msg : messages) {
+					_metrics.queue_wait_ns.record(drained_at - msg->enqueued_at);
 				}
-				else {
-					_inner_state.votes = 1;
-					_inner_state.set_status(Candidate);
-					_inner_state.set_new_election_time_out();
-					_inner_state.last_voted_term = _inner_state.next_term();
-					_router->send_votes_request(_tag, _inner_state);
+				_processor->process_batch(messages);
+				_metrics.messages_processed.add((int64_t)messages.size());
+				_inner_state.messages_processed += (int64_t)messages.size();
+				_processor->dispatch_committed();
+				messages.clear();
+
+				// only leader contact and granted votes push the deadline, other traffic does not
+				if (_inner_state.election_timeout != -1 && !is_dead() && std::chrono::steady_clock::now() >= _election_deadline) {
+					start_election();
 				}
 
-				RaftVisualizer::getInstance()->poll(this);
+				publish_state();
+			}
+		}
+
+		void start_election() {
+			_router->trace_event(_tag, TraceElectionTimeout);
+			if (_election_started_at == 0) {
+				_election_started_at = metrics_now_ns();
 			}
+			_metrics.elections_started.add();
+			_inner_state.elections_started++;
+			_inner_state.votes = 1;
+			_inner_state.set_status(Candidate);
+			reset_election_timer();
+			_inner_state.last_voted_term = _inner_state.next_term();
+			_router->send_votes_request(_tag, _inner_state);
+		}
+
+		// lock-free, observers read the slot whenever they like
+		void publish_state() {
+			_state_slot->store(_inner_state.snapshot());
 		}
 
 		void create_heartbeater() {
+			if (_timers) {
+				_timers->start_heartbeats(this);
+				return;
+			}
 			_heartbeater.reset(new raft::HeartbeatModule(this));
 		}
 
 		void release_heartbeater() {
+			if (_timers) {
+				_timers->stop_heartbeats(this);
+			}
 			_heartbeater.reset();
 		}
+
+		void reset_election_timer() {
+			const RaftConfig& config = _router->get_config();
+			_inner_state.set_new_election_time_out(config.election_timeout_min_ms, config.election_timeout_max_ms);
+			auto timeout = std::chrono::duration<double, std::milli>(_inner_state.election_timeout * get_clock_skew());
+			if (_timers) {
+				_timers->arm_election_timer(this, timeout.count());
+				return;
+			}
+			_election_deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout);
+		}
+
+		void sync_log_state() {
+			_inner_state.last_log_index = _log.last_index();
+			_inner_state.last_log_term = _log.last_term();
+		}
 	};
 }
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace raft {
+	struct LogEntry {
+		int term;
+		int index;
+		std::string command;
+
+		LogEntry() : term(0), index(0) {}
+		LogEntry(int term_in, int index_in, std::string command_in)
+			:
+			term(term_in),
+			index(index_in),
+			command(std::move(command_in))
+		{}
+	};
+
+	// 1-based replicated log, index 0 is the implicit empty prefix (term 0)
+	class RaftLog {
+	private:
+		std::vector<LogEntry> _entries;
+
+	public:
+		int last_index() const {
+			return (int)_entries.size();
+		}
+
+		int last_term() const {
+			return _entries.empty() ? 0 : _entries.back().term;
+		}
+
+		int term_at(int index) const {
+			if (index <= 0 || index > last_index()) {
+				return 0;
+			}
+			return _entries[index - 1].term;
+		}
+
+		bool contains(int index, int term) const {
+			if (index == 0) {
+				return true;
+			}
+			return index <= last_index() && term_at(index) == term;
+		}
+
+		const LogEntry& at(int index) const {
+			return _entries[index - 1];
+		}
+
+		int append(int term, std::string command) {
+			int index = last_index() + 1;
+			_entries.emplace_back(term, index, std::move(command));
+			return index;
+		}
+
+		// drops conflicting suffix and appends entries the log does not have yet
+		void merge(const std::vector<LogEntry>& entries) {
+			for (const auto& entry : entries) {
+				if (entry.index <= last_index()) {
+					if (term_at(entry.index) == entry.term) {
+						continue;
+					}
+					_entries.resize(entry.index - 1);
+				}
+				_entries.push_back(entry);
+			}
+		}
+
+		// at most max_count entries, cut at max_bytes of payload but never below one entry
+		std::vector<LogEntry> slice(int from, int max_count, size_t max_bytes) const {
+			std::vector<LogEntry> result;
+			size_t bytes = 0;
+			for (int i = from; i <= last_index() && (int)result.size() < max_count; ++i) {
+				bytes += _entries[i - 1].command.size();
+				if (!result.empty() && bytes > max_bytes) {
+					break;
+				}
+				result.push_back(_entries[i - 1]);
+			}
+			return result;
+		}
+
+		bool is_up_to_date(int other_last_term, int other_last_index) const {
+			if (other_last_term != last_term()) {
+				return other_last_term > last_term();
+			}
+			return other_last_index >= last_index();
+		}
+	};
+
+	class StateMachine {
+	public:
+		virtual ~StateMachine() = default;
+
+		// returns the encoded reply delivered to the client that proposed the command
+		virtual std::string apply(const std::string& command) = 0;
+	};
+}
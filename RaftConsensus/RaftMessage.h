@@ -1,6 +1,8 @@
 #pragma once
 
 #include "RaftState.h"
+#include "RaftLog.h"
+#include "RaftMetrics.h"
 
 namespace raft {
 	enum message_type {
@@ -10,31 +12,62 @@ namespace raft {
 		VotesResponse,
 		SetDead,
 		SetRestart,
+		AppendEntriesRequest,
+		AppendEntriesResponse,
+		ClientRequest,
+	};
+
+	enum client_status {
+		ClientOk,
+		ClientNotLeader,
+		ClientBusy,
 	};
 
 	class RaftNode;
 
+	// trace_record of a message sent while no trace was written
+	const uint64_t no_trace_record = ~0ull;
+
 	struct BaseMessage {
 		message_type type;
 		RaftStateNode node_state;
+		int64_t enqueued_at;
+		// where the router recorded the message in the trace, batch records list these
+		uint64_t trace_record;
 
-		BaseMessage(message_type type_in) : type(type_in), node_state{} {}
-		BaseMessage(message_type type_in, const RaftStateNode& node_in) : type(type_in), node_state(node_in) {}
+		BaseMessage(message_type type_in) : type(type_in), node_state{}, enqueued_at(0), trace_record(no_trace_record) {}
+		BaseMessage(message_type type_in, const RaftStateNode& node_in) : type(type_in), node_state(node_in), enqueued_at(0), trace_record(no_trace_record) {}
+		virtual ~BaseMessage() = default;
 	};
 
 	struct HeartbeatRequestMessage : BaseMessage {
 		int term;
 		std::string target;
+		int64_t sent_at;
 		HeartbeatRequestMessage(int term_in, const std::string& target_in) 
 			: 
 			BaseMessage(HeartbeatRequest),
 			term(term_in),
-			target(target_in) 
+			target(target_in),
+			sent_at(metrics_now_ns())
 		{}
 	};
 
 	struct HeartbeatResponseMessage : BaseMessage {
-		HeartbeatResponseMessage() : BaseMessage(HeartbeatResponse) {}
+		int term;
+		std::string source;
+		int commit_index;
+		int last_log_index;
+		int64_t request_sent_at;
+		HeartbeatResponseMessage(int term_in, const std::string& source_in, int commit_index_in, int last_log_index_in, int64_t request_sent_at_in)
+			:
+			BaseMessage(HeartbeatResponse),
+			term(term_in),
+			source(source_in),
+			commit_index(commit_index_in),
+			last_log_index(last_log_index_in),
+			request_sent_at(request_sent_at_in)
+		{}
 	};
 
 	struct VotesRequestMessage : BaseMessage {
@@ -43,7 +76,8 @@ namespace raft {
 	};
 
 	struct VotesResponseMessage : BaseMessage {
-		VotesResponseMessage() : BaseMessage(VotesResponse)
+		int term;
+		VotesResponseMessage(int term_in) : BaseMessage(VotesResponse), term(term_in)
 		{}
 	};
 
@@ -57,5 +91,82 @@ namespace raft {
 		{}
 	};
 
+	struct AppendEntriesRequestMessage : BaseMessage {
+		int term;
+		std::string leader;
+		int prev_log_index;
+		int prev_log_term;
+		int leader_commit;
+		std::vector<LogEntry> entries;
+		AppendEntriesRequestMessage(int term_in, const std::string& leader_in, int prev_log_index_in, int prev_log_term_in, int leader_commit_in, std::vector<LogEntry> entries_in)
+			:
+			BaseMessage(AppendEntriesRequest),
+			term(term_in),
+			leader(leader_in),
+			prev_log_index(prev_log_index_in),
+			prev_log_term(prev_log_term_in),
+			leader_commit(leader_commit_in),
+			entries(std::move(entries_in))
+		{}
+	};
+
+	struct AppendEntriesResponseMessage : BaseMessage {
+		int term;
+		std::string source;
+		bool success;
+		int match_index;
+		int applied_index;
+		AppendEntriesResponseMessage(int term_in, const std::string& source_in, bool success_in, int match_index_in, int applied_index_in)
+			:
+			BaseMessage(AppendEntriesResponse),
+			term(term_in),
+			source(source_in),
+			success(success_in),
+			match_index(match_index_in),
+			applied_index(applied_index_in)
+		{}
+	};
+
+	struct ClientReply {
+		client_status status;
+		std::string leader_hint;
+		std::string response;
+	};
+
+	// client proposal waiting on the leader for its entry to commit
+	struct PendingRequest {
+		std::shared_ptr<std::promise<ClientReply>> reply;
+		int64_t appended_at;
+	};
+
+	struct ClientRequestMessage : BaseMessage {
+		std::string command;
+		std::shared_ptr<std::promise<ClientReply>> reply;
+		ClientRequestMessage(std::string command_in, std::shared_ptr<std::promise<ClientReply>> reply_in)
+			:
+			BaseMessage(ClientRequest),
+			command(std::move(command_in)),
+			reply(std::move(reply_in))
+		{}
+	};
+
 	using RaftMessage = std::unique_ptr<BaseMessage>;
+
+	// what a message costs against the destination's inbox budget
+	inline size_t message_bytes(const BaseMessage& message) {
+		size_t bytes = sizeof(BaseMessage) + message.node_state.tag.size();
+		switch (message.type) {
+		case AppendEntriesRequest:
+			for (const auto& entry : static_cast<const AppendEntriesRequestMessage&>(message).entries) {
+				bytes += sizeof(LogEntry) + entry.command.size();
+			}
+			break;
+		case ClientRequest:
+			bytes += static_cast<const ClientRequestMessage&>(message).command.size();
+			break;
+		default:
+			break;
+		}
+		return bytes;
+	}
 }
@@ -5,83 +5,474 @@
 
 void raft::MessageProcessor::process(RaftMessage&& message) {
 	if (message->type == SetRestart) {
-		on_set_restart((SetRestartMessage*)message.get());
+		on_set_restart(static_cast<SetRestartMessage*>(message.get()));
 		return;
 	}
 	else if (!_node->is_dead()) {
 		switch (message->type) {
 		case VotesRequest:
-			on_votes_request((VotesRequestMessage*)message.get());
+			on_votes_request(static_cast<VotesRequestMessage*>(message.get()));
 			break;
 		case VotesResponse:
-			on_votes_response((VotesResponseMessage*)message.get());
+			on_votes_response(static_cast<VotesResponseMessage*>(message.get()));
 			break;
 		case HeartbeatRequest:
-			on_heartbeat_request((HeartbeatRequestMessage*)message.get());
+			on_heartbeat_request(static_cast<HeartbeatRequestMessage*>(message.get()));
 			break;
 		case HeartbeatResponse:
-			on_heartbeat_response((HeartbeatResponseMessage*)message.get());
+			on_heartbeat_response(static_cast<HeartbeatResponseMessage*>(message.get()));
 			break;
 		case SetDead:
-			on_set_dead((SetDeadMessage*)message.get());
+			on_set_dead(static_cast<SetDeadMessage*>(message.get()));
 			break;
+		case AppendEntriesRequest:
+			on_append_entries_request(static_cast<AppendEntriesRequestMessage*>(message.get()));
+			break;
+		case AppendEntriesResponse:
+			on_append_entries_response(static_cast<AppendEntriesResponseMessage*>(message.get()));
+			break;
+		case ClientRequest:
+			on_client_request(static_cast<ClientRequestMessage*>(message.get()));
+			break;
+		}
+	}
+}
+
+void raft::MessageProcessor::process_batch(std::vector<RaftMessage>& messages)
+{
+	size_t collapsed = collapse_heartbeats(messages);
+
+	_batching = true;
+	int64_t started = metrics_now_ns();
+	for (auto& message : messages) {
+		if (!message) {
+			continue;
+		}
+		process(std::move(message));
+
+		int64_t finished = metrics_now_ns();
+		_node->_metrics.process_ns.record(finished - started);
+		started = finished;
+	}
+	_batching = false;
+	finish_batch();
+
+	if (collapsed > 0) {
+		_node->_metrics.messages_collapsed.add((int64_t)collapsed);
+	}
+}
+
+size_t raft::MessageProcessor::collapse_heartbeats(std::vector<RaftMessage>& messages)
+{
+	// walking backwards the first one seen per (peer, term) is the latest, earlier ones carry
+	// nothing it does not. a batch holds a handful of peers, a linear scan beats hashing
+	std::vector<std::pair<const std::string*, int>> requests;
+	std::vector<std::pair<const std::string*, int>> responses;
+	auto seen = [](std::vector<std::pair<const std::string*, int>>& keys, const std::string& peer, int term) {
+		for (const auto& key : keys) {
+			if (key.second == term && *key.first == peer) {
+				return true;
+			}
+		}
+		keys.emplace_back(&peer, term);
+		return false;
+	};
+
+	size_t collapsed = 0;
+	for (size_t i = messages.size(); i-- > 0;) {
+		BaseMessage* message = messages[i].get();
+		bool superseded = false;
+		if (message->type == HeartbeatRequest) {
+			auto request = static_cast<HeartbeatRequestMessage*>(message);
+			superseded = seen(requests, request->target, request->term);
+		}
+		else if (message->type == HeartbeatResponse) {
+			auto response = static_cast<HeartbeatResponseMessage*>(message);
+			superseded = seen(responses, response->source, response->term);
+		}
+		else if (message->type == SetDead || message->type == SetRestart) {
+			// liveness changes split the batch, heartbeats on either side stay apart
+			requests.clear();
+			responses.clear();
+		}
+
+		if (superseded) {
+			messages[i].reset();
+			++collapsed;
+		}
+	}
+	return collapsed;
+}
+
+void raft::MessageProcessor::finish_batch()
+{
+	RaftStateNode& state = _node->_inner_state;
+	if (_votes_dirty) {
+		_votes_dirty = false;
+		if (state.status == Candidate && _node->get_router()->is_enough_quorum(state.votes)) {
+			become_leader();
+		}
+	}
+
+	if (_commit_dirty) {
+		_commit_dirty = false;
+		if (state.status == Leader) {
+			advance_commit_index();
 		}
 	}
 }
 
 void raft::MessageProcessor::on_votes_request(raft::VotesRequestMessage* message)
 {
-	if (_node->_inner_state.last_voted_term < message->node_state.term) {
-		_node->_inner_state.last_voted_term = message->node_state.term;
-		_node->_inner_state.set_new_election_time_out();
-		_node->get_router()->send_votes_response(message->node_state.tag);
+	const RaftStateNode& candidate = message->node_state;
+	if (candidate.term > _node->_inner_state.term) {
+		step_down(candidate.term);
+	}
 
-		ADD_LOG("node %s votes for %s in term %d", _node->get_tag().c_str(), message->node_state.tag.c_str(), message->node_state.term);
+	if (_node->_inner_state.last_voted_term < candidate.term &&
+		_node->_log.is_up_to_date(candidate.last_log_term, candidate.last_log_index)) {
+		_node->_inner_state.last_voted_term = candidate.term;
+		_node->reset_election_timer();
+		_node->get_router()->send_votes_response(candidate.tag, candidate.term, _node->get_tag());
+
+		ADD_LOG("node %s votes for %s in term %d", _node->get_tag().c_str(), candidate.tag.c_str(), candidate.term);
 	}
 }
 
 void raft::MessageProcessor::on_votes_response(raft::VotesResponseMessage* message)
 {
-	if (_node->_inner_state.status == Candidate) {
+	if (_node->_inner_state.status == Candidate && message->term == _node->_inner_state.term) {
 		int cur_votes = ++(_node->_inner_state.votes);
-		if (_node->get_router()->is_enough_quorum(cur_votes)) {
-			_node->_inner_state.status = Leader;
-			_node->_inner_state.set_election_time_out_max();
-			_node->create_heartbeater();
+		if (_batching) {
+			_votes_dirty = true;
+		}
+		else if (_node->get_router()->is_enough_quorum(cur_votes)) {
+			become_leader();
 		}
 	}
 }
 
 void raft::MessageProcessor::on_heartbeat_request(raft::HeartbeatRequestMessage* message)
 {
-	if (_node->_inner_state.status == Candidate) {
-		if (_node->_inner_state.term != message->term) {
-			_node->_inner_state.hearbeat_count = 0;
-		}
-		_node->_inner_state.term = message->term;
-		_node->_inner_state.hearbeat_count++;
-		_node->_inner_state.set_status(Follower);
-		_node->_inner_state.set_new_election_time_out();
-		_node->get_router()->send_heartbeat_response(message->target);
+	RaftStateNode& state = _node->_inner_state;
+	if (message->term < state.term) {
+		_node->get_router()->send_heartbeat_response(message->target, state.term, _node->get_tag(), state.commit_index, state.last_log_index, message->sent_at);
+		return;
 	}
-	else if (_node->_inner_state.status == Follower) {
-		if (_node->_inner_state.term != message->term) {
-			_node->_inner_state.hearbeat_count = 0;
-		}
-		_node->_inner_state.term = message->term;
-		_node->_inner_state.hearbeat_count++;
-		_node->_inner_state.set_new_election_time_out();
-		_node->get_router()->send_heartbeat_response(message->target);
+
+	if (state.term != message->term) {
+		state.hearbeat_count = 0;
 	}
+
+	if (state.status == Leader && state.term == message->term) {
+		return;
+	}
+
+	if (state.status != Follower || state.term != message->term) {
+		step_down(message->term);
+	}
+
+	state.hearbeat_count++;
+	_node->reset_election_timer();
+	_node->_leader_tag = message->target;
+	_node->get_router()->send_heartbeat_response(message->target, state.term, _node->get_tag(), state.commit_index, state.last_log_index, message->sent_at);
 }
 
 void raft::MessageProcessor::on_heartbeat_response(HeartbeatResponseMessage* message) {
+	if (message->term > _node->_inner_state.term) {
+		step_down(message->term);
+		return;
+	}
+
+	if (_node->_inner_state.status != Leader) {
+		return;
+	}
+
+	_node->_metrics.heartbeat_rtt_ns.record(metrics_now_ns() - message->request_sent_at);
+
+	auto it = _node->_progress.find(message->source);
+	if (it == _node->_progress.end()) {
+		return;
+	}
+
+	// responses may have been dropped by our own inbox budget, the heartbeat frees the window.
+	// a gap left by a lost append is reported as a rejection and turns into a probe
+	FollowerProgress& progress = it->second;
+	progress.inflight = 0;
+
+	// lagging followers (or ones that missed the latest commit index) are caught up on their heartbeat
+	if (progress.match_index < _node->_log.last_index() || message->commit_index < _node->_inner_state.commit_index) {
+		replicate_to(message->source);
+	}
 }
 
 void raft::MessageProcessor::on_set_dead(SetDeadMessage*) {
 	_node->set_dead();
+	fail_pending();
 }
 
 void raft::MessageProcessor::on_set_restart(SetRestartMessage*) {
 	_node->set_restart();
 }
+
+void raft::MessageProcessor::on_append_entries_request(AppendEntriesRequestMessage* message)
+{
+	RaftStateNode& state = _node->_inner_state;
+	if (message->term < state.term || (state.status == Leader && message->term == state.term)) {
+		_node->get_router()->send_append_entries_response(message->leader, state.term, _node->get_tag(), false, state.last_log_index, _node->get_applied_index());
+		return;
+	}
+
+	if (state.status != Follower || state.term != message->term) {
+		step_down(message->term);
+	}
+
+	_node->reset_election_timer();
+	_node->_leader_tag = message->leader;
+
+	if (!_node->_log.contains(message->prev_log_index, message->prev_log_term)) {
+		int hint = std::min(message->prev_log_index - 1, _node->_log.last_index());
+		_node->get_router()->send_append_entries_response(message->leader, state.term, _node->get_tag(), false, hint, _node->get_applied_index());
+		return;
+	}
+
+	_node->_log.merge(message->entries);
+	_node->sync_log_state();
+
+	int last_new_index = message->prev_log_index + (int)message->entries.size();
+	if (message->leader_commit > state.commit_index) {
+		state.commit_index = std::min(message->leader_commit, last_new_index);
+	}
+
+	_node->get_router()->send_append_entries_response(message->leader, state.term, _node->get_tag(), true, last_new_index, _node->get_applied_index());
+}
+
+void raft::MessageProcessor::on_append_entries_response(AppendEntriesResponseMessage* message)
+{
+	if (message->term > _node->_inner_state.term) {
+		step_down(message->term);
+		return;
+	}
+
+	if (_node->_inner_state.status != Leader || message->term != _node->_inner_state.term) {
+		return;
+	}
+
+	auto it = _node->_progress.find(message->source);
+	if (it == _node->_progress.end()) {
+		return;
+	}
+
+	FollowerProgress& progress = it->second;
+	progress.applied_index = std::max(progress.applied_index, message->applied_index);
+	progress.inflight = std::max(0, progress.inflight - 1);
+
+	if (message->success) {
+		progress.match_index = std::max(progress.match_index, message->match_index);
+		progress.next_index = std::max(progress.next_index, progress.match_index + 1);
+		if (progress.state == Probe) {
+			progress.state = Replicate;
+		}
+		if (_batching) {
+			_commit_dirty = true;
+		}
+		else {
+			advance_commit_index();
+		}
+
+		// a follower whose apply stage is behind resumes from its next heartbeat
+		while (progress.next_index <= _node->_log.last_index() && can_send(progress) && !apply_throttled(progress)) {
+			if (!replicate_to(message->source)) {
+				break;
+			}
+		}
+	}
+	else if (message->match_index + 1 < progress.next_index) {
+		// stale rejections from a pipelined window are ignored once next_index moved past them
+		progress.state = Probe;
+		progress.inflight = 0;
+		progress.next_index = std::max(progress.match_index + 1, std::min(progress.next_index - 1, message->match_index + 1));
+		replicate_to(message->source);
+	}
+}
+
+void raft::MessageProcessor::on_client_request(ClientRequestMessage* message)
+{
+	if (_node->_inner_state.status != Leader) {
+		message->reply->set_value(ClientReply{ ClientNotLeader, _node->_leader_tag, {} });
+		return;
+	}
+
+	if (_node->_log.last_index() - _node->get_applied_index() >= _node->get_router()->get_config().max_apply_lag) {
+		message->reply->set_value(ClientReply{ ClientBusy, _node->get_tag(), {} });
+		return;
+	}
+
+	int index = _node->_log.append(_node->_inner_state.term, std::move(message->command));
+	_node->sync_log_state();
+	_node->_pending[index] = PendingRequest{ std::move(message->reply), metrics_now_ns() };
+
+	// probing or saturated followers pick the new entry up from their next response
+	for (auto& pair : _node->_progress) {
+		if (pair.second.state == Replicate && pair.second.next_index == index && can_send(pair.second)) {
+			replicate_to(pair.first);
+		}
+	}
+
+	if (_batching) {
+		_commit_dirty = true;
+	}
+	else {
+		advance_commit_index();
+	}
+}
+
+void raft::MessageProcessor::become_leader()
+{
+	RaftStateNode& state = _node->_inner_state;
+	state.status = Leader;
+	state.set_election_time_out_max();
+	_node->_leader_tag = _node->get_tag();
+
+	_node->_progress.clear();
+	for (auto node : _node->get_router()->get_all_nodes()) {
+		if (!node->equal(_node->get_tag())) {
+			_node->_progress[node->get_tag()] = FollowerProgress{ Probe, _node->_log.last_index() + 1, 0, 0, 0 };
+		}
+	}
+
+	// a no-op in the new term lets entries from earlier terms commit
+	_node->_log.append(state.term, std::string());
+	_node->sync_log_state();
+
+	_node->create_heartbeater();
+
+	for (auto& pair : _node->_progress) {
+		replicate_to(pair.first);
+	}
+
+	_node->_metrics.leaders_elected.add();
+	if (_node->_election_started_at != 0) {
+		_node->_metrics.election_duration_ns.record(metrics_now_ns() - _node->_election_started_at);
+		_node->_election_started_at = 0;
+	}
+
+	ADD_LOG("node %s becomes leader in term %d", _node->get_tag().c_str(), state.term);
+}
+
+void raft::MessageProcessor::step_down(int term)
+{
+	RaftStateNode& state = _node->_inner_state;
+	if (state.status == Leader) {
+		_node->release_heartbeater();
+		fail_pending();
+		_node->reset_election_timer();
+	}
+
+	if (state.status == Leader || state.status == Candidate) {
+		state.set_status(Follower);
+		_node->_election_started_at = 0;
+	}
+
+	state.term = term;
+}
+
+bool raft::MessageProcessor::replicate_to(const std::string& follower)
+{
+	const RaftConfig& config = _node->get_router()->get_config();
+	FollowerProgress& progress = _node->_progress[follower];
+	int prev_log_index = progress.next_index - 1;
+	auto entries = _node->_log.slice(progress.next_index, apply_throttled(progress) ? 0 : config.max_append_entries, config.max_append_bytes);
+
+	// optimistic pipelining while replicating, a rejected append moves next_index back.
+	// a probe keeps next_index until the follower confirms the match point
+	if (progress.state == Replicate) {
+		progress.next_index += (int)entries.size();
+	}
+	progress.inflight++;
+
+	bool delivered = _node->get_router()->send_append_entries_request(
+		follower,
+		_node->_inner_state.term,
+		_node->get_tag(),
+		prev_log_index,
+		_node->_log.term_at(prev_log_index),
+		_node->_inner_state.commit_index,
+		std::move(entries));
+
+	// follower is down or its inbox is over budget, stop pipelining until it answers a probe
+	if (!delivered) {
+		progress.state = Probe;
+		progress.next_index = progress.match_index + 1;
+		progress.inflight = 0;
+	}
+	return delivered;
+}
+
+void raft::MessageProcessor::advance_commit_index()
+{
+	RaftStateNode& state = _node->_inner_state;
+	for (int index = _node->_log.last_index(); index > state.commit_index; --index) {
+		// entries from older terms only commit indirectly (raft 5.4.2)
+		if (_node->_log.term_at(index) != state.term) {
+			break;
+		}
+
+		int replicas = 1;
+		for (const auto& pair : _node->_progress) {
+			if (pair.second.match_index >= index) {
+				++replicas;
+			}
+		}
+
+		if (_node->get_router()->is_enough_quorum(replicas)) {
+			int64_t now = metrics_now_ns();
+			for (auto it = _node->_pending.upper_bound(state.commit_index); it != _node->_pending.end() && it->first <= index; ++it) {
+				_node->_metrics.commit_latency_ns.record(now - it->second.appended_at);
+			}
+			state.commit_index = index;
+			break;
+		}
+	}
+}
+
+bool raft::MessageProcessor::apply_throttled(const FollowerProgress& progress) const
+{
+	return progress.match_index - progress.applied_index >= _node->get_router()->get_config().max_apply_lag;
+}
+
+bool raft::MessageProcessor::can_send(const FollowerProgress& progress) const
+{
+	int window = progress.state == Probe ? 1 : _node->get_router()->get_config().max_inflight_appends;
+	return progress.inflight < window;
+}
+
+void raft::MessageProcessor::dispatch_committed()
+{
+	while (_node->_last_dispatched < _node->_inner_state.commit_index) {
+		int index = _node->_last_dispatched + 1;
+
+		ApplyTask task{ index, _node->_log.at(index).command, nullptr, _node->get_tag() };
+		auto it = _node->_pending.find(index);
+		if (it != _node->_pending.end()) {
+			task.reply = it->second.reply;
+		}
+
+		if (!_node->_applier->try_submit(std::move(task))) {
+			return;
+		}
+
+		_node->_last_dispatched = index;
+		if (it != _node->_pending.end()) {
+			_node->_pending.erase(it);
+		}
+	}
+}
+
+void raft::MessageProcessor::fail_pending()
+{
+	for (auto& pair : _node->_pending) {
+		pair.second.reply->set_value(ClientReply{ ClientNotLeader, {}, {} });
+	}
+	_node->_pending.clear();
+}
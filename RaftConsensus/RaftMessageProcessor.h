@@ -7,11 +7,23 @@ namespace raft {
 	private:
 		RaftNode* _node;
 
+		// inside process_batch the vote count and commit index are settled once at the end
+		bool _batching;
+		bool _votes_dirty;
+		bool _commit_dirty;
+
 	public:
-		MessageProcessor(RaftNode* node) : _node(node) {}
+		MessageProcessor(RaftNode* node) : _node(node), _batching(false), _votes_dirty(false), _commit_dirty(false) {}
 
 		void process(RaftMessage&& message);
 
+		// everything drained from the inbox in one go. heartbeats superseded later in the batch are
+		// skipped, quorum and commit index are recomputed once. messages keep their arrival order,
+		// grouping them by type would judge some against a term they never saw
+		void process_batch(std::vector<RaftMessage>& messages);
+
+		void dispatch_committed();
+
 	private:
 		void on_votes_request(VotesRequestMessage* message);
 		void on_votes_response(VotesResponseMessage* message);
@@ -19,6 +31,19 @@ namespace raft {
 		void on_heartbeat_response(HeartbeatResponseMessage* message);
 		void on_set_dead(SetDeadMessage* message);
 		void on_set_restart(SetRestartMessage* message);
+		void on_append_entries_request(AppendEntriesRequestMessage* message);
+		void on_append_entries_response(AppendEntriesResponseMessage* message);
+		void on_client_request(ClientRequestMessage* message);
+
+		void become_leader();
+		void step_down(int term);
+		bool replicate_to(const std::string& follower);
+		bool apply_throttled(const FollowerProgress& progress) const;
+		bool can_send(const FollowerProgress& progress) const;
+		void advance_commit_index();
+		void fail_pending();
+		void finish_batch();
+		size_t collapse_heartbeats(std::vector<RaftMessage>& messages);
 	};
 }
 
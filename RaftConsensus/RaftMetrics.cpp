@@ -0,0 +1,170 @@
+#include "RaftMetrics.h"
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+
+raft::Histogram::Histogram()
+	:
+	_shards(new Shard[metrics_detail::shard_count])
+{
+	reset();
+}
+
+void raft::Histogram::reset()
+{
+	for (size_t i = 0; i < metrics_detail::shard_count; ++i) {
+		Shard& shard = _shards[i];
+		for (auto& bucket : shard.buckets) {
+			bucket.store(0, std::memory_order_relaxed);
+		}
+		shard.count.store(0, std::memory_order_relaxed);
+		shard.sum.store(0, std::memory_order_relaxed);
+		shard.min.store(std::numeric_limits<int64_t>::max(), std::memory_order_relaxed);
+		shard.max.store(0, std::memory_order_relaxed);
+	}
+}
+
+raft::HistogramSnapshot raft::Histogram::snapshot() const
+{
+	std::vector<uint64_t> merged(bucket_count, 0);
+	HistogramSnapshot result{ 0, std::numeric_limits<int64_t>::max(), 0, 0.0, 0, 0, 0, 0 };
+	int64_t sum = 0;
+
+	for (size_t i = 0; i < metrics_detail::shard_count; ++i) {
+		const Shard& shard = _shards[i];
+		for (int b = 0; b < bucket_count; ++b) {
+			merged[b] += shard.buckets[b].load(std::memory_order_relaxed);
+		}
+		result.count += shard.count.load(std::memory_order_relaxed);
+		sum += shard.sum.load(std::memory_order_relaxed);
+		result.min = std::min(result.min, shard.min.load(std::memory_order_relaxed));
+		result.max = std::max(result.max, shard.max.load(std::memory_order_relaxed));
+	}
+
+	if (result.count == 0) {
+		result.min = 0;
+		return result;
+	}
+	result.mean = (double)sum / (double)result.count;
+
+	const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+	int64_t* outputs[] = { &result.p50, &result.p90, &result.p99, &result.p999 };
+	uint64_t total = 0;
+	for (int b = 0; b < bucket_count; ++b) {
+		total += merged[b];
+	}
+
+	uint64_t seen = 0;
+	int q = 0;
+	for (int b = 0; b < bucket_count && q < 4; ++b) {
+		seen += merged[b];
+		while (q < 4 && seen > 0 && (double)seen >= quantiles[q] * (double)total) {
+			*outputs[q] = std::min(bucket_upper_bound(b), result.max);
+			++q;
+		}
+	}
+	return result;
+}
+
+raft::Counter& raft::MetricsRegistry::counter(const std::string& name)
+{
+	std::lock_guard<std::mutex> lk(_mtx);
+	auto& slot = _counters[name];
+	if (!slot) {
+		slot.reset(new Counter());
+	}
+	return *slot;
+}
+
+raft::Gauge& raft::MetricsRegistry::gauge(const std::string& name)
+{
+	std::lock_guard<std::mutex> lk(_mtx);
+	auto& slot = _gauges[name];
+	if (!slot) {
+		slot.reset(new Gauge());
+	}
+	return *slot;
+}
+
+raft::Histogram& raft::MetricsRegistry::histogram(const std::string& name)
+{
+	std::lock_guard<std::mutex> lk(_mtx);
+	auto& slot = _histograms[name];
+	if (!slot) {
+		slot.reset(new Histogram());
+	}
+	return *slot;
+}
+
+raft::NodeMetrics::NodeMetrics(const std::string& tag)
+	:
+	queue_wait_ns(METRIC_HISTOGRAM("raft.queue_wait_ns")),
+	process_ns(METRIC_HISTOGRAM("raft.process_ns")),
+	election_duration_ns(METRIC_HISTOGRAM("raft.election_duration_ns")),
+	heartbeat_rtt_ns(METRIC_HISTOGRAM("raft.heartbeat_rtt_ns")),
+	commit_latency_ns(METRIC_HISTOGRAM("raft.commit_latency_ns")),
+	messages_processed(METRIC_COUNTER("raft.messages_processed")),
+	messages_collapsed(METRIC_COUNTER("raft.messages_collapsed")),
+	elections_started(METRIC_COUNTER("raft.elections_started")),
+	leaders_elected(METRIC_COUNTER("raft.leaders_elected")),
+	dropped_messages(METRIC_COUNTER("raft.dropped_messages")),
+	queue_depth(METRIC_GAUGE("raft.queue_depth." + tag)),
+	queued_bytes(METRIC_GAUGE("raft.queued_bytes." + tag))
+{
+}
+
+std::string raft::MetricsRegistry::to_text()
+{
+	std::lock_guard<std::mutex> lk(_mtx);
+	std::ostringstream out;
+
+	for (const auto& pair : _counters) {
+		out << pair.first << " " << pair.second->value() << "\n";
+	}
+	for (const auto& pair : _gauges) {
+		out << pair.first << " " << pair.second->value() << "\n";
+	}
+	for (const auto& pair : _histograms) {
+		auto s = pair.second->snapshot();
+		out << pair.first
+			<< " count=" << s.count << " min=" << s.min << " mean=" << (int64_t)s.mean
+			<< " p50=" << s.p50 << " p90=" << s.p90 << " p99=" << s.p99 << " p999=" << s.p999
+			<< " max=" << s.max << "\n";
+	}
+	return out.str();
+}
+
+std::string raft::MetricsRegistry::to_json()
+{
+	std::lock_guard<std::mutex> lk(_mtx);
+	std::ostringstream out;
+
+	// metric names are plain identifiers, nothing to escape
+	out << "{\"counters\":{";
+	const char* separator = "";
+	for (const auto& pair : _counters) {
+		out << separator << "\"" << pair.first << "\":" << pair.second->value();
+		separator = ",";
+	}
+
+	out << "},\"gauges\":{";
+	separator = "";
+	for (const auto& pair : _gauges) {
+		out << separator << "\"" << pair.first << "\":" << pair.second->value();
+		separator = ",";
+	}
+
+	out << "},\"histograms\":{";
+	separator = "";
+	for (const auto& pair : _histograms) {
+		auto s = pair.second->snapshot();
+		out << separator << "\"" << pair.first << "\":{"
+			<< "\"count\":" << s.count << ",\"min\":" << s.min << ",\"mean\":" << s.mean
+			<< ",\"p50\":" << s.p50 << ",\"p90\":" << s.p90 << ",\"p99\":" << s.p99 << ",\"p999\":" << s.p999
+			<< ",\"max\":" << s.max << "}";
+		separator = ",";
+	}
+	out << "}}";
+	return out.str();
+}
@@ -0,0 +1,214 @@
+#pragma once
+#include "Singleton.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace raft {
+	static inline int64_t metrics_now_ns() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	namespace metrics_detail {
+		constexpr size_t shard_count = 8;
+
+		struct alignas(64) PaddedCounter {
+			std::atomic<int64_t> value{ 0 };
+		};
+
+		// threads are spread round robin over the shards the first time they record
+		static inline size_t this_thread_shard() {
+			static std::atomic<size_t> next{ 0 };
+			thread_local size_t shard = next.fetch_add(1, std::memory_order_relaxed) % shard_count;
+			return shard;
+		}
+	}
+
+	class Counter {
+	private:
+		std::array<metrics_detail::PaddedCounter, metrics_detail::shard_count> _shards;
+
+	public:
+		void add(int64_t n = 1) {
+			_shards[metrics_detail::this_thread_shard()].value.fetch_add(n, std::memory_order_relaxed);
+		}
+
+		int64_t value() const {
+			int64_t sum = 0;
+			for (const auto& shard : _shards) {
+				sum += shard.value.load(std::memory_order_relaxed);
+			}
+			return sum;
+		}
+	};
+
+	// point in time value; add() is sharded like Counter, set() replaces the whole value
+	class Gauge {
+	private:
+		std::array<metrics_detail::PaddedCounter, metrics_detail::shard_count> _shards;
+
+	public:
+		void add(int64_t n) {
+			_shards[metrics_detail::this_thread_shard()].value.fetch_add(n, std::memory_order_relaxed);
+		}
+
+		void set(int64_t n) {
+			for (size_t i = 1; i < _shards.size(); ++i) {
+				_shards[i].value.store(0, std::memory_order_relaxed);
+			}
+			_shards[0].value.store(n, std::memory_order_relaxed);
+		}
+
+		int64_t value() const {
+			int64_t sum = 0;
+			for (const auto& shard : _shards) {
+				sum += shard.value.load(std::memory_order_relaxed);
+			}
+			return sum;
+		}
+	};
+
+	struct HistogramSnapshot {
+		uint64_t count;
+		int64_t min;
+		int64_t max;
+		double mean;
+		int64_t p50;
+		int64_t p90;
+		int64_t p99;
+		int64_t p999;
+	};
+
+	// HDR-style log-linear histogram over non-negative integers (nanoseconds by convention).
+	// every power of two is split into 2^(sub_bucket_bits - 1) linear buckets, worst case
+	// relative error is 1/2^(sub_bucket_bits - 1) (~3%)
+	class Histogram {
+	public:
+		static constexpr int sub_bucket_bits = 6;
+		static constexpr int sub_bucket_count = 1 << sub_bucket_bits;
+		static constexpr int sub_bucket_half = sub_bucket_count / 2;
+		static constexpr int bucket_count = (64 - sub_bucket_bits + 1) * sub_bucket_half + sub_bucket_half;
+
+	private:
+		struct alignas(64) Shard {
+			std::array<std::atomic<uint64_t>, bucket_count> buckets;
+			std::atomic<uint64_t> count;
+			std::atomic<int64_t> sum;
+			std::atomic<int64_t> min;
+			std::atomic<int64_t> max;
+		};
+
+		std::unique_ptr<Shard[]> _shards;
+
+	public:
+		Histogram();
+
+		void record(int64_t value) {
+			if (value < 0) {
+				value = 0;
+			}
+
+			Shard& shard = _shards[metrics_detail::this_thread_shard()];
+			shard.buckets[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+			shard.count.fetch_add(1, std::memory_order_relaxed);
+			shard.sum.fetch_add(value, std::memory_order_relaxed);
+
+			int64_t seen = shard.max.load(std::memory_order_relaxed);
+			while (value > seen && !shard.max.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {}
+			seen = shard.min.load(std::memory_order_relaxed);
+			while (value < seen && !shard.min.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {}
+		}
+
+		HistogramSnapshot snapshot() const;
+
+		// zeroes every bucket. samples recorded concurrently may survive it, benches call it between runs
+		void reset();
+
+		static int bucket_of(int64_t value) {
+			if (value < sub_bucket_count) {
+				return (int)value;
+			}
+			int shift = highest_bit((uint64_t)value) - (sub_bucket_bits - 1);
+			return shift * sub_bucket_half + (int)(value >> shift);
+		}
+
+		// largest value that lands in the bucket, INT64_MAX for the buckets that reach past it
+		static int64_t bucket_upper_bound(int bucket) {
+			if (bucket < sub_bucket_count) {
+				return bucket;
+			}
+			int shift = bucket / sub_bucket_half - 1;
+			uint64_t sub = (uint64_t)(bucket - shift * sub_bucket_half);
+			if (shift >= 63 || sub + 1 > ((uint64_t)INT64_MAX >> shift)) {
+				return INT64_MAX;
+			}
+			return (int64_t)(((sub + 1) << shift) - 1);
+		}
+
+	private:
+		static int highest_bit(uint64_t value) {
+#if defined(_MSC_VER)
+			unsigned long index;
+			_BitScanReverse64(&index, value);
+			return (int)index;
+#else
+			return 63 - __builtin_clzll(value);
+#endif
+		}
+	};
+
+	class MetricsRegistry : public CSingleton<MetricsRegistry>
+	{
+	private:
+		std::mutex _mtx;
+		std::map<std::string, std::unique_ptr<Counter>> _counters;
+		std::map<std::string, std::unique_ptr<Gauge>> _gauges;
+		std::map<std::string, std::unique_ptr<Histogram>> _histograms;
+
+	public:
+		// lookups take the registry lock; hot paths keep the returned reference, it stays valid for the process lifetime
+		Counter& counter(const std::string& name);
+
+		Gauge& gauge(const std::string& name);
+
+		Histogram& histogram(const std::string& name);
+
+		std::string to_text();
+
+		std::string to_json();
+	};
+
+	// handles a node records into, resolved once so the hot path never takes the registry lock.
+	// latency histograms are cluster wide, queue gauges are per node
+	struct NodeMetrics {
+		Histogram& queue_wait_ns;
+		Histogram& process_ns;
+		Histogram& election_duration_ns;
+		Histogram& heartbeat_rtt_ns;
+		Histogram& commit_latency_ns;
+		Counter& messages_processed;
+		Counter& messages_collapsed;
+		Counter& elections_started;
+		Counter& leaders_elected;
+		Counter& dropped_messages;
+		Gauge& queue_depth;
+		Gauge& queued_bytes;
+
+		NodeMetrics(const std::string& tag);
+	};
+}
+
+#define METRIC_COUNTER(name) raft::MetricsRegistry::getInstance()->counter(name)
+#define METRIC_GAUGE(name) raft::MetricsRegistry::getInstance()->gauge(name)
+#define METRIC_HISTOGRAM(name) raft::MetricsRegistry::getInstance()->histogram(name)
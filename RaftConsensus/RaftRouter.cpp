@@ -1,12 +1,26 @@
 #include "RaftRouter.h"
 #include "RaftConsensus.h"
+#include "LoopbackTransport.h"
+#include "RaftWire.h"
 
-static void delayed_send() {
-	std::this_thread::sleep_for(std::chrono::seconds(2));
+raft::RaftRouter::RaftRouter(const RaftConfig& config_in)
+	:
+	config(config_in),
+	replaying(false),
+	replay_time(0),
+	faults_active(false)
+{
 }
 
 raft::RaftRouter::~RaftRouter()
 {
+	// node threads send to each other, none may be deleted while another still runs
+	for (auto& node : nodes) {
+		node->stop();
+	}
+	delay_line.reset();
+	transport.reset();
+	trace.reset();
 	for (auto& node : nodes) {
 		delete node;
 	}
@@ -15,11 +29,17 @@ raft::RaftRouter::~RaftRouter()
 
 void raft::RaftRouter::add_node(RaftNode* node)
 {
+	node_index[node->get_tag()] = (int)nodes.size();
 	nodes.push_back(node);
 }
 
 void raft::RaftRouter::start()
 {
+	if (config.loopback_tcp) {
+		transport.reset(new LoopbackTransport(nodes));
+	}
+	open_trace();
+
 	for (auto& node : nodes) {
 		node->start();
 	}
@@ -34,12 +54,12 @@ void raft::RaftRouter::send_votes_request(const std::string& source, const RaftS
 			continue;
 
 		if (!node->equal(source)) {
-			node->push_message(std::make_unique<VotesRequestMessage>(status));
+			deliver(node, std::make_unique<VotesRequestMessage>(status), source);
 		}
 	}
 }
 
-void raft::RaftRouter::send_votes_response(const std::string& target)
+void raft::RaftRouter::send_votes_response(const std::string& target, int term, const std::string& source)
 {
 	delayed_send();
 	for (auto& node : nodes) {
@@ -47,7 +67,7 @@ void raft::RaftRouter::send_votes_response(const std::string& target)
 			continue;
 
 		if (node->equal(target)) {
-			node->push_message(std::make_unique<VotesResponseMessage>());
+			deliver(node, std::make_unique<VotesResponseMessage>(term), source);
 			break;
 		}
 	}
@@ -55,40 +75,63 @@ void raft::RaftRouter::send_votes_response(const std::string& target)
 
 void raft::RaftRouter::send_heartbeat_request(int term, const std::string& source)
 {
+	// the heartbeat thread runs on wall time, a replay only sees the heartbeats recorded
+	if (replaying)
+		return;
+
 	auto nodes = shuffled_nodes();
 	for (auto& node : nodes) {
 		if (node->is_dead())
 			continue;
 
 		if (!node->equal(source)) {
-			node->push_message(std::make_unique<HeartbeatRequestMessage>(term, source));
+			deliver(node, std::make_unique<HeartbeatRequestMessage>(term, source), source);
 		}
 	}
 }
 
-void raft::RaftRouter::send_heartbeat_response(const std::string& target)
+void raft::RaftRouter::send_heartbeat_response(const std::string& target, int term, const std::string& source, int commit_index, int last_log_index, int64_t request_sent_at)
 {
 	for (auto& node : nodes) {
 		if (node->is_dead())
 			continue;
 
 		if (node->equal(target)) {
-			node->push_message(std::make_unique<HeartbeatResponseMessage>());
+			deliver(node, std::make_unique<HeartbeatResponseMessage>(term, source, commit_index, last_log_index, request_sent_at), source);
 			break;
 		}
 	}
 }
 
+bool raft::RaftRouter::send_append_entries_request(const std::string& target, int term, const std::string& leader, int prev_log_index, int prev_log_term, int leader_commit, std::vector<LogEntry> entries)
+{
+	return push_to(target, std::make_unique<AppendEntriesRequestMessage>(term, leader, prev_log_index, prev_log_term, leader_commit, std::move(entries)), leader);
+}
+
+void raft::RaftRouter::send_append_entries_response(const std::string& target, int term, const std::string& source, bool success, int match_index, int applied_index)
+{
+	push_to(target, std::make_unique<AppendEntriesResponseMessage>(term, source, success, match_index, applied_index), source);
+}
+
+bool raft::RaftRouter::send_client_request(const std::string& target, std::string command, std::shared_ptr<std::promise<ClientReply>> reply)
+{
+	return push_to(target, std::make_unique<ClientRequestMessage>(std::move(command), std::move(reply)), std::string());
+}
+
 bool raft::RaftRouter::is_enough_quorum(int n)
 {
-	return n >= ((int)nodes.size() + 1) / 2;
+	return n > (int)nodes.size() / 2;
 }
 
 void raft::RaftRouter::set_dead(const std::string& target)
 {
 	for (auto& node : nodes) {
 		if (node->equal(target)) {
-			node->push_message(std::make_unique<SetDeadMessage>());
+			auto message = std::make_unique<SetDeadMessage>();
+			if (trace) {
+				message->trace_record = trace->record_message(trace_now(), std::string(), target, *message, true);
+			}
+			node->push_message(std::move(message));
 			break;
 		}
 	}
@@ -98,23 +141,164 @@ void raft::RaftRouter::set_restart(const std::string& target)
 {
 	for (auto& node : nodes) {
 		if (node->equal(target)) {
-			node->push_message(std::make_unique<SetRestartMessage>());
+			auto message = std::make_unique<SetRestartMessage>();
+			if (trace) {
+				message->trace_record = trace->record_message(trace_now(), std::string(), target, *message, true);
+			}
+			node->push_message(std::move(message));
 			break;
 		}
 	}
 }
 
+void raft::RaftRouter::set_link(const std::string& from, const std::string& to, const LinkFault& fault)
+{
+	int source = from.empty() ? -1 : index_of(from);
+	int target = to.empty() ? -1 : index_of(to);
+	if ((!from.empty() && source < 0) || (!to.empty() && target < 0)) {
+		return;
+	}
+	update_links(source, target, [&fault](LinkFault& link) {
+		bool cut = link.cut;
+		link = fault;
+		link.cut = cut;
+	});
+}
+
+raft::LinkFault raft::RaftRouter::get_link(const std::string& from, const std::string& to)
+{
+	int source = index_of(from);
+	int target = index_of(to);
+	std::lock_guard<std::mutex> lk(fault_mtx);
+	if (source < 0 || target < 0 || links.empty()) {
+		return LinkFault();
+	}
+	return links[source * nodes.size() + target];
+}
+
+void raft::RaftRouter::set_partition(const std::vector<std::vector<std::string>>& groups)
+{
+	std::vector<int> side(nodes.size(), -1);
+	for (size_t i = 0; i < groups.size(); ++i) {
+		for (const auto& tag : groups[i]) {
+			int index = index_of(tag);
+			if (index >= 0) {
+				side[index] = (int)i;
+			}
+		}
+	}
+
+	// nodes left out of every group keep talking to everyone
+	std::lock_guard<std::mutex> lk(fault_mtx);
+	links.resize(nodes.size() * nodes.size());
+	for (size_t from = 0; from < nodes.size(); ++from) {
+		for (size_t to = 0; to < nodes.size(); ++to) {
+			links[from * nodes.size() + to].cut = side[from] >= 0 && side[to] >= 0 && side[from] != side[to];
+		}
+	}
+	faults_active.store(std::any_of(links.begin(), links.end(), [](const LinkFault& link) { return link.any(); }), std::memory_order_release);
+	ADD_LOG("network partition into %d groups", (int)groups.size());
+}
+
+void raft::RaftRouter::set_drop_rate(double probability)
+{
+	update_links(-1, -1, [probability](LinkFault& link) {
+		link.drop_rate = std::min(std::max(probability, 0.0), 1.0);
+	});
+}
+
+void raft::RaftRouter::set_delay_ms(int ms)
+{
+	update_links(-1, -1, [ms](LinkFault& link) {
+		link.latency_ms = std::max(ms, 0);
+	});
+}
+
+void raft::RaftRouter::heal()
+{
+	update_links(-1, -1, [](LinkFault& link) {
+		link = LinkFault();
+	});
+}
+
+void raft::RaftRouter::set_clock_skew(const std::string& target, double factor)
+{
+	for (auto& node : nodes) {
+		if (node->equal(target)) {
+			node->set_clock_skew(factor);
+			break;
+		}
+	}
+}
+
+void raft::RaftRouter::update_links(int from, int to, const std::function<void(LinkFault&)>& change)
+{
+	const size_t n = nodes.size();
+	std::lock_guard<std::mutex> lk(fault_mtx);
+	links.resize(n * n);
+
+	bool active = false;
+	bool delayed = false;
+	for (size_t i = 0; i < n; ++i) {
+		for (size_t j = 0; j < n; ++j) {
+			LinkFault& link = links[i * n + j];
+			if ((from < 0 || from == (int)i) && (to < 0 || to == (int)j) && i != j) {
+				change(link);
+			}
+			active = active || link.any();
+			delayed = delayed || link.latency_ms > 0 || link.jitter_ms > 0;
+		}
+	}
+
+	if (delayed && !delay_line) {
+		delay_line.reset(new DelayLine([this](RaftNode* node, RaftMessage&& message) {
+			send_to(node, std::move(message));
+		}));
+	}
+	faults_active.store(active, std::memory_order_release);
+}
+
+int raft::RaftRouter::index_of(const std::string& tag) const
+{
+	auto it = node_index.find(tag);
+	return it == node_index.end() ? -1 : it->second;
+}
+
+void raft::RaftRouter::delayed_send() const
+{
+	if (config.vote_delay_ms > 0 && !simulation) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(config.vote_delay_ms));
+	}
+}
+
 std::vector<raft::RaftNode*> raft::RaftRouter::shuffled_nodes()
 {
 	static std::random_device rd{};
 	static std::default_random_engine rng{ rd() };
 
+	// replays and simulations fan out in a fixed order so two runs of one input do the same thing
 	std::vector<raft::RaftNode*> result = nodes;
+	if (replaying || simulation) {
+		return result;
+	}
 	std::shuffle(result.begin(), result.end(), rng);
 
 	return result;
 }
 
+bool raft::RaftRouter::push_to(const std::string& target, RaftMessage&& message, const std::string& source)
+{
+	for (auto& node : nodes) {
+		if (node->equal(target)) {
+			if (node->is_dead())
+				return false;
+
+			return deliver(node, std::move(message), source);
+		}
+	}
+	return false;
+}
+
 raft::RaftNode* raft::RaftRouter::get_random_node() const
 {
 	int node_num = (int)nodes.size();
@@ -123,4 +307,145 @@ raft::RaftNode* raft::RaftRouter::get_random_node() const
 	std::uniform_int_distribution<int> dist(0, node_num - 1);
 
 	return nodes[dist(rng)];
+}
+
+void raft::RaftRouter::trace_event(const std::string& node, raft::trace_event event)
+{
+	if (trace) {
+		uint16_t id = trace->id_of(node);
+		trace->record(trace_now(), id, id, event, TraceDelivered, 0, nullptr, 0);
+	}
+}
+
+void raft::RaftRouter::trace_batch(const std::string& node, const std::vector<RaftMessage>& messages)
+{
+	if (!trace || messages.empty()) {
+		return;
+	}
+
+	thread_local std::string payload;
+	payload.clear();
+	for (const auto& message : messages) {
+		payload.append((const char*)&message->trace_record, sizeof(message->trace_record));
+	}
+	uint16_t id = trace->id_of(node);
+	trace->record(trace_now(), id, id, TraceBatch, TraceDelivered, (uint32_t)messages.size(), payload.data(), payload.size());
+}
+
+void raft::RaftRouter::begin_replay()
+{
+	replaying = true;
+	open_trace();
+}
+
+void raft::RaftRouter::open_trace()
+{
+	if (config.trace_path.empty() || trace) {
+		return;
+	}
+
+	std::vector<std::string> tags;
+	for (auto& node : nodes) {
+		tags.push_back(node->get_tag());
+	}
+	trace.reset(new TraceWriter(config.trace_path, config.trace_capacity_bytes, tags, config));
+	if (!trace->is_open()) {
+		ADD_LOG("cannot open trace file %s", config.trace_path.c_str());
+		trace.reset();
+	}
+}
+
+bool raft::RaftRouter::deliver(RaftNode* node, RaftMessage&& message, const std::string& source)
+{
+	if (replaying) {
+		if (trace) {
+			trace->record_message(replay_time, source, node->get_tag(), *message, true);
+		}
+		return true;
+	}
+	if (simulation) {
+		simulation(node, std::move(message));
+		return true;
+	}
+
+	if (!trace) {
+		return route(node, std::move(message), source);
+	}
+
+	// the record is taken first, the receiver may drain the message and list it in a batch before
+	// route returns. it is stamped with the outcome after
+	uint64_t record = trace->record_message(metrics_now_ns(), source, node->get_tag(), *message, false);
+	message->trace_record = record;
+	bool delivered = route(node, std::move(message), source);
+	if (delivered) {
+		trace->mark_delivered(record);
+	}
+	return delivered;
+}
+
+bool raft::RaftRouter::route(RaftNode* node, RaftMessage&& message, const std::string& source)
+{
+	if (!faults_active.load(std::memory_order_acquire) || !is_wire_message(message->type)) {
+		return send_to(node, std::move(message));
+	}
+
+	int from = index_of(source);
+	int to = index_of(node->get_tag());
+	if (from < 0 || to < 0) {
+		return send_to(node, std::move(message));
+	}
+
+	LinkFault link;
+	DelayLine* line;
+	{
+		std::lock_guard<std::mutex> lk(fault_mtx);
+		link = links[from * nodes.size() + to];
+		line = delay_line.get();
+	}
+
+	// a lost message still reads as sent, the sender finds out through its timeouts as with a real network
+	thread_local std::mt19937 rng{ std::random_device{}() };
+	std::uniform_real_distribution<double> chance(0.0, 1.0);
+	if (link.cut || (link.drop_rate > 0.0 && chance(rng) < link.drop_rate)) {
+		return true;
+	}
+
+	// the copy is rebuilt from the wire encoding, peer messages are the only ones faults apply to
+	RaftMessage duplicate;
+	if (link.duplicate_rate > 0.0 && chance(rng) < link.duplicate_rate) {
+		thread_local std::string encoded;
+		encoded.clear();
+		encode_message(*message, encoded);
+		duplicate = decode_message(encoded.data(), encoded.size());
+		if (duplicate) {
+			duplicate->trace_record = message->trace_record;
+		}
+	}
+
+	auto latency = [&]() {
+		int jitter = link.jitter_ms > 0 ? std::uniform_int_distribution<int>(0, link.jitter_ms * 1000)(rng) : 0;
+		return std::chrono::microseconds(link.latency_ms * 1000 + jitter);
+	};
+
+	// the sender sees a successful send, like a packet that left the host
+	if (line && (link.latency_ms > 0 || link.jitter_ms > 0)) {
+		if (duplicate) {
+			line->push(node, std::move(duplicate), latency());
+		}
+		line->push(node, std::move(message), latency());
+		return true;
+	}
+
+	if (duplicate) {
+		send_to(node, std::move(duplicate));
+	}
+	return send_to(node, std::move(message));
+}
+
+bool raft::RaftRouter::send_to(RaftNode* node, RaftMessage&& message)
+{
+	if (transport && is_wire_message(message->type) && transport->send(node, *message)) {
+		return true;
+	}
+	return node->offer_message(std::move(message));
 }
\ No newline at end of file
@@ -1,29 +1,76 @@
 #pragma once
 
 #include "RaftMessage.h"
+#include "RaftConfig.h"
+#include "RaftTrace.h"
+#include "DelayLine.h"
+
+#include <unordered_map>
 
 namespace raft {
 	class RaftNode;
+	class LoopbackTransport;
+
+	// faults injected on one direction of a peer link, client requests and control messages always get through
+	struct LinkFault {
+		// set by partitions, kept apart from drop_rate so healing a partition leaves the rest alone
+		bool cut = false;
+		double drop_rate = 0.0;
+		double duplicate_rate = 0.0;
+		int latency_ms = 0;
+		// up to this much extra latency per message, later messages overtake earlier ones
+		int jitter_ms = 0;
+
+		bool any() const { return cut || drop_rate > 0.0 || duplicate_rate > 0.0 || latency_ms > 0 || jitter_ms > 0; }
+	};
 
 	class RaftRouter {
 	private:	
 		std::mutex mtx;
 		std::vector<RaftNode*> nodes;
+		RaftConfig config;
+		std::unique_ptr<LoopbackTransport> transport;
+		std::unique_ptr<TraceWriter> trace;
+
+		// replay mode: nothing is delivered, sends are only recorded at the replayed record's time
+		bool replaying;
+		int64_t replay_time;
+
+		// simulation mode: every send is handed to this instead of a node's inbox
+		DelayLine::Deliver simulation;
+
+		// link matrix, links[from * n + to] by position in nodes. faults_active lets the fault free
+		// path skip fault_mtx
+		std::unordered_map<std::string, int> node_index;
+		std::mutex fault_mtx;
+		std::vector<LinkFault> links;
+		std::atomic<bool> faults_active;
+		std::unique_ptr<DelayLine> delay_line;
 	
 	public:
+		RaftRouter(const RaftConfig& config_in = RaftConfig());
+
 		~RaftRouter();
 
+		const RaftConfig& get_config() const { return config; }
+
 		void add_node(RaftNode* node);
 
 		void start();
 
 		void send_votes_request(const std::string& source, const RaftStateNode& status);
 
-		void send_votes_response(const std::string& target);
+		void send_votes_response(const std::string& target, int term, const std::string& source);
 
 		void send_heartbeat_request(int term, const std::string& source);
 
-		void send_heartbeat_response(const std::string& target);
+		void send_heartbeat_response(const std::string& target, int term, const std::string& source, int commit_index, int last_log_index, int64_t request_sent_at);
+
+		bool send_append_entries_request(const std::string& target, int term, const std::string& leader, int prev_log_index, int prev_log_term, int leader_commit, std::vector<LogEntry> entries);
+
+		void send_append_entries_response(const std::string& target, int term, const std::string& source, bool success, int match_index, int applied_index);
+
+		bool send_client_request(const std::string& target, std::string command, std::shared_ptr<std::promise<ClientReply>> reply);
 	
 		bool is_enough_quorum(int n);
 
@@ -31,11 +78,72 @@ namespace raft {
 
 		void set_restart(const std::string& target);
 
+		// one direction, from sends and to receives. an empty tag stands for every node.
+		// fault.cut is ignored, partitions own it
+		void set_link(const std::string& from, const std::string& to, const LinkFault& fault);
+
+		LinkFault get_link(const std::string& from, const std::string& to);
+
+		// groups of tags that only reach each other, an empty list heals the partition
+		void set_partition(const std::vector<std::vector<std::string>>& groups);
+
+		// on every link
+		void set_drop_rate(double probability);
+
+		void set_delay_ms(int ms);
+
+		// clears every fault on every link
+		void heal();
+
+		// timer rate of one node, 2.0 makes its election timeouts and heartbeat interval twice as long
+		void set_clock_skew(const std::string& target, double factor);
+
+
+		// timer driven transitions go into the trace next to the messages so a replay can reproduce them
+		void trace_event(const std::string& node, trace_event event);
+
+		// what one drain of the node's inbox held, in the order the processor sees it
+		void trace_batch(const std::string& node, const std::vector<RaftMessage>& messages);
+
+		// switches the router to replay mode, see TraceReplay.h. call before start() instead of it
+		void begin_replay();
+
+		void set_replay_time(int64_t timestamp_ns) { replay_time = timestamp_ns; }
+
+		bool is_replaying() const { return replaying; }
+
+		// switches the router to simulation mode, the driver delivers each message on its own clock.
+		// vote sends do not sleep out vote_delay_ms, the driver adds it. call before start() instead of it
+		void begin_simulation(DelayLine::Deliver deliver) { simulation = std::move(deliver); }
+
 		std::vector<RaftNode*> get_all_nodes() { return nodes; }
 
+		int get_node_count() const { return (int)nodes.size(); }
+
+		// position in add_node order, what link faults and RaftConfig placements are indexed by. -1 when unknown
+		int index_of(const std::string& tag) const;
+
 		raft::RaftNode* get_random_node() const;
 
 	private:
+		void delayed_send() const;
+
 		std::vector<RaftNode*> shuffled_nodes();
+
+		bool push_to(const std::string& target, RaftMessage&& message, const std::string& source);
+
+		bool deliver(RaftNode* node, RaftMessage&& message, const std::string& source);
+
+		// applies the injected faults, then hands over to send_to
+		bool route(RaftNode* node, RaftMessage&& message, const std::string& source);
+
+		bool send_to(RaftNode* node, RaftMessage&& message);
+
+		// runs change on every link from -> to under fault_mtx, -1 is every node
+		void update_links(int from, int to, const std::function<void(LinkFault&)>& change);
+
+		void open_trace();
+
+		int64_t trace_now() const { return replaying ? replay_time : metrics_now_ns(); }
 	};
 }
\ No newline at end of file
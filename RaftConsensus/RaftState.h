@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <iostream>
 #include <queue>
 #include <thread>
@@ -25,14 +26,36 @@ namespace raft {
 		Dead,
 	};
 	
-	static int random_election_timeout() {
-		static random_device device;
-		static mt19937 rng(device());
-		static uniform_int_distribution<int> rnd(3, 10);
+	// one engine per thread, shared by every translation unit. a driver that runs all nodes on its
+	// own thread seeds it to make the timeouts reproducible
+	inline mt19937& election_timeout_rng() {
+		static thread_local mt19937 rng(random_device{}());
+		return rng;
+	}
+
+	inline int random_election_timeout(int min_ms, int max_ms) {
+		uniform_int_distribution<int> rnd(min_ms, max_ms);
 
-		return rnd(rng);
+		return rnd(election_timeout_rng());
 	}
 
+	// trivially copyable part of RaftStateNode, what a node publishes to observers
+	struct RaftStateSnapshot {
+		int term;
+		RaftStatus status;
+		int election_timeout;
+		int votes;
+		int last_voted_term;
+		int hearbeat_count;
+		int commit_index;
+		int last_log_index;
+		int last_log_term;
+		int queue_depth;
+		int dropped_messages;
+		int elections_started;
+		int64_t messages_processed;
+	};
+
 	struct RaftStateNode {
 		int term;
 		RaftStatus status;
@@ -40,14 +63,47 @@ namespace raft {
 		int votes;
 		int last_voted_term;
 		int hearbeat_count;
+		int commit_index;
+		int last_log_index;
+		int last_log_term;
+		int queue_depth;
+		int dropped_messages;
+		int elections_started;
+		int64_t messages_processed;
 		std::string tag;
 
-		RaftStateNode() : term(0), status(Follower), election_timeout(0), votes(0), last_voted_term(0), hearbeat_count(0) {}
+		RaftStateNode() : term(0), status(Follower), election_timeout(0), votes(0), last_voted_term(0), hearbeat_count(0), commit_index(0), last_log_index(0), last_log_term(0), queue_depth(0), dropped_messages(0), elections_started(0), messages_processed(0) {}
 		RaftStateNode(const std::string& _tag) : RaftStateNode() { tag = _tag; };
+		RaftStateNode(const std::string& _tag, const RaftStateSnapshot& s)
+			:
+			term(s.term), status(s.status), election_timeout(s.election_timeout), votes(s.votes), last_voted_term(s.last_voted_term), hearbeat_count(s.hearbeat_count),
+			commit_index(s.commit_index), last_log_index(s.last_log_index), last_log_term(s.last_log_term), queue_depth(s.queue_depth), dropped_messages(s.dropped_messages),
+			elections_started(s.elections_started), messages_processed(s.messages_processed), tag(_tag)
+		{}
+
+		RaftStateSnapshot snapshot() const {
+			return RaftStateSnapshot{ term, status, election_timeout, votes, last_voted_term, hearbeat_count, commit_index, last_log_index, last_log_term, queue_depth, dropped_messages, elections_started, messages_processed };
+		}
 		
 		int next_term() { return ++term; }
 		void set_status(RaftStatus _status) { status = _status; }
-		void set_new_election_time_out() { election_timeout = random_election_timeout(); }
+		void set_new_election_time_out(int min_ms, int max_ms) { election_timeout = random_election_timeout(min_ms, max_ms); }
 		void set_election_time_out_max() { election_timeout = -1; }
 	};
+
+	// Probe: one append in flight until the follower's match point is known
+	// Replicate: pipelined appends, bounded by max_inflight_appends
+	enum progress_state {
+		Probe,
+		Replicate,
+	};
+
+	// leader side view of a follower's log
+	struct FollowerProgress {
+		progress_state state;
+		int next_index;
+		int match_index;
+		int applied_index;
+		int inflight;
+	};
 }
\ No newline at end of file
@@ -1,6 +1,11 @@
 #pragma once
 #include "RaftConsensus.h"
 #include "RaftVisualizer.h"
+#include "KvClient.h"
+#include "ScenarioRunner.h"
+
+#include <fstream>
+#include <sstream>
 
 namespace raft {
 	static RaftRouter* router = nullptr;
@@ -44,20 +49,12 @@ namespace raft {
 			}
 		}
 
-		void test() {
+		void test(int node_count = 5) {
 			RaftVisualizer* visualizer = RaftVisualizer::getInstance();
 
-			RaftNode* n1 = new RaftNode(router, "n1");
-			RaftNode* n2 = new RaftNode(router, "n2");
-			RaftNode* n3 = new RaftNode(router, "n3");
-			RaftNode* n4 = new RaftNode(router, "n4");
-			RaftNode* n5 = new RaftNode(router, "n5");
-
-			router->add_node(n1);
-			router->add_node(n2);
-			router->add_node(n3);
-			router->add_node(n4);
-			router->add_node(n5);
+			for (int i = 1; i <= node_count; ++i) {
+				router->add_node(new RaftNode(router, FORMAT("n%d", i)));
+			}
 			router->start();
 
 			std::thread t([this]() { keyboard_listen(); });
@@ -122,6 +119,68 @@ namespace raft {
 
 					cv.notify_one();
 				}break;
+				case 'p':
+				{
+					// p <key> <value>, blocks this listener until the put commits
+					std::istringstream args(buf.c_str() + 1);
+					string key, value;
+					args >> key >> value;
+					if (!key.empty()) {
+						KvClient client(router);
+						auto result = client.put(key, value);
+						ADD_LOG("put %s = %s -> %s", key.c_str(), value.c_str(), result.status == KvOk ? "ok" : "timeout");
+					}
+				}break;
+				case 'g':
+				{
+					std::istringstream args(buf.c_str() + 1);
+					string key;
+					args >> key;
+					if (!key.empty()) {
+						KvClient client(router);
+						auto result = client.get(key);
+						ADD_LOG("get %s -> %s", key.c_str(), result.status == KvOk ? result.value.c_str() : "(not found)");
+					}
+				}break;
+				case 'm':
+				{
+					// m [path], dumps the metrics registry as json (default raft_metrics.json)
+					std::istringstream args(buf.c_str() + 1);
+					string path;
+					args >> path;
+					if (path.empty()) {
+						path = "raft_metrics.json";
+					}
+					std::ofstream out(path);
+					out << MetricsRegistry::getInstance()->to_json();
+					ADD_LOG("metrics written to %s", path.c_str());
+				}break;
+				case '!':
+				{
+					// ! <scenario action>, e.g. "! partition n1,n2 n3,n4,n5" or "! drop 0.1"
+					std::istringstream args(buf.c_str() + 1);
+					std::vector<string> words;
+					string word;
+					while (args >> word) {
+						words.push_back(word);
+					}
+					ScenarioAction action;
+					string error;
+					if (parse_scenario_action(words, action, error)) {
+						apply_scenario_action(router, action);
+					}
+					else {
+						ADD_LOG("%s", error.c_str());
+					}
+				}break;
+				case 'n':
+				{
+					RaftVisualizer::getInstance()->next_page();
+				}break;
+				case 'b':
+				{
+					RaftVisualizer::getInstance()->prev_page();
+				}break;
 				case 'r':
 				{
 					string sub = buf.substr(1);
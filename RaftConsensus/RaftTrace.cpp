@@ -0,0 +1,377 @@
+#include "RaftTrace.h"
+#include "RaftWire.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+	const char trace_magic[8] = { 'R', 'A', 'F', 'T', 'T', 'R', 'C', '1' };
+
+	// size, timestamp, source, target, type, flags, bytes
+	const size_t record_header_size = 4 + 8 + 2 + 2 + 1 + 1 + 4;
+
+	template <typename T>
+	void put(char*& out, T value) {
+		memcpy(out, &value, sizeof(T));
+		out += sizeof(T);
+	}
+
+	template <typename T>
+	bool get(const char*& in, const char* end, T& value) {
+		if ((size_t)(end - in) < sizeof(T)) {
+			return false;
+		}
+		memcpy(&value, in, sizeof(T));
+		in += sizeof(T);
+		return true;
+	}
+
+	void put_json_string(std::ostream& out, const std::string& text) {
+		out << '"';
+		for (char c : text) {
+			if (c == '"' || c == '\\') {
+				out << '\\' << c;
+			}
+			else if ((unsigned char)c >= 0x20) {
+				out << c;
+			}
+		}
+		out << '"';
+	}
+}
+
+struct raft::TraceWriter::Mapping {
+#if defined(_WIN32)
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE view = nullptr;
+#else
+	int fd = -1;
+#endif
+};
+
+raft::TraceWriter::TraceWriter(const std::string& path, size_t capacity, const std::vector<std::string>& tags, const RaftConfig& config)
+	:
+	_mapping(new Mapping()),
+	_base(nullptr),
+	_capacity(0),
+	_cursor(0),
+	_dropped(0),
+	_started_at(metrics_now_ns())
+{
+	size_t header_size = sizeof(trace_magic) + sizeof(uint32_t) + sizeof(TraceConfig) + sizeof(int64_t);
+	for (size_t i = 0; i < tags.size(); ++i) {
+		_ids[tags[i]] = (uint16_t)i;
+		header_size += sizeof(uint16_t) + tags[i].size();
+	}
+	capacity = std::max(capacity, header_size + record_header_size + sizeof(uint32_t));
+
+#if defined(_WIN32)
+	_mapping->file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (_mapping->file == INVALID_HANDLE_VALUE) {
+		return;
+	}
+	_mapping->view = CreateFileMappingA(_mapping->file, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)capacity >> 32), (DWORD)(capacity & 0xffffffff), nullptr);
+	if (_mapping->view == nullptr) {
+		return;
+	}
+	_base = (char*)MapViewOfFile(_mapping->view, FILE_MAP_WRITE, 0, 0, capacity);
+#else
+	_mapping->fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (_mapping->fd < 0 || ftruncate(_mapping->fd, (off_t)capacity) != 0) {
+		return;
+	}
+	void* base = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, _mapping->fd, 0);
+	_base = base == MAP_FAILED ? nullptr : (char*)base;
+#endif
+	if (!_base) {
+		return;
+	}
+	_capacity = capacity;
+
+	TraceConfig recorded{
+		config.max_append_entries, config.max_inflight_appends, config.max_apply_lag,
+		config.election_timeout_min_ms, config.election_timeout_max_ms, config.heartbeat_interval_ms,
+		(uint64_t)config.max_append_bytes, (uint64_t)config.apply_queue_capacity };
+
+	char* out = _base;
+	memcpy(out, trace_magic, sizeof(trace_magic)); out += sizeof(trace_magic);
+	put<uint32_t>(out, (uint32_t)tags.size());
+	put<TraceConfig>(out, recorded);
+	put<int64_t>(out, _started_at);
+	for (const auto& tag : tags) {
+		put<uint16_t>(out, (uint16_t)tag.size());
+		memcpy(out, tag.data(), tag.size()); out += tag.size();
+	}
+	_cursor.store(header_size, std::memory_order_relaxed);
+}
+
+raft::TraceWriter::~TraceWriter()
+{
+	close();
+}
+
+uint16_t raft::TraceWriter::id_of(const std::string& tag) const
+{
+	auto it = _ids.find(tag);
+	return it == _ids.end() ? trace_external : it->second;
+}
+
+uint64_t raft::TraceWriter::record(int64_t timestamp_ns, uint16_t source, uint16_t target, uint8_t type, uint8_t flags, uint32_t bytes, const char* payload, size_t payload_size)
+{
+	if (!_base) {
+		return no_trace_record;
+	}
+
+	// the trailing u32 keeps room for the zero size that ends the file
+	size_t size = record_header_size + payload_size;
+	size_t offset = _cursor.fetch_add(size, std::memory_order_relaxed);
+	if (offset + size + sizeof(uint32_t) > _capacity) {
+		_dropped.fetch_add(1, std::memory_order_relaxed);
+		return no_trace_record;
+	}
+
+	char* out = _base + offset + sizeof(uint32_t);
+	put<int64_t>(out, timestamp_ns);
+	put<uint16_t>(out, source);
+	put<uint16_t>(out, target);
+	put<uint8_t>(out, type);
+	put<uint8_t>(out, flags);
+	put<uint32_t>(out, bytes);
+	if (payload_size > 0) {
+		memcpy(out, payload, payload_size);
+	}
+
+	// the size goes in last, a reader of a crashed run stops at the first record still zero
+	std::atomic_thread_fence(std::memory_order_release);
+	uint32_t record_size = (uint32_t)size;
+	memcpy(_base + offset, &record_size, sizeof(record_size));
+	return offset;
+}
+
+void raft::TraceWriter::mark_delivered(uint64_t record)
+{
+	// only the thread that wrote the record touches its flags, the file is read after close
+	if (!_base || record == no_trace_record) {
+		return;
+	}
+	char* flags = _base + record + sizeof(uint32_t) + sizeof(int64_t) + 2 * sizeof(uint16_t) + sizeof(uint8_t);
+	*flags |= TraceDelivered;
+}
+
+uint64_t raft::TraceWriter::record_message(int64_t timestamp_ns, const std::string& source, const std::string& target, const BaseMessage& message, bool delivered)
+{
+	thread_local std::string payload;
+	payload.clear();
+	trace_payload(message, payload);
+
+	return record(timestamp_ns, id_of(source), id_of(target), (uint8_t)message.type, delivered ? TraceDelivered : 0,
+		(uint32_t)message_bytes(message), payload.data(), payload.size());
+}
+
+void raft::trace_payload(const BaseMessage& message, std::string& out)
+{
+	if (is_wire_message(message.type)) {
+		encode_message(message, out);
+	}
+	else if (message.type == ClientRequest) {
+		out.append(static_cast<const ClientRequestMessage&>(message).command);
+	}
+}
+
+void raft::TraceWriter::close()
+{
+	if (!_mapping) {
+		return;
+	}
+
+	size_t used = std::min(_cursor.load(), _capacity);
+#if defined(_WIN32)
+	if (_base) {
+		FlushViewOfFile(_base, used);
+		UnmapViewOfFile(_base);
+	}
+	if (_mapping->view) {
+		CloseHandle(_mapping->view);
+	}
+	if (_mapping->file != INVALID_HANDLE_VALUE) {
+		LARGE_INTEGER end;
+		end.QuadPart = (LONGLONG)used;
+		if (_base && SetFilePointerEx(_mapping->file, end, nullptr, FILE_BEGIN)) {
+			SetEndOfFile(_mapping->file);
+		}
+		CloseHandle(_mapping->file);
+	}
+#else
+	if (_base) {
+		munmap(_base, _capacity);
+	}
+	if (_mapping->fd >= 0) {
+		// on failure the zero padding left behind still reads as the end of the trace
+		if (_base) {
+			int truncated = ftruncate(_mapping->fd, (off_t)used);
+			(void)truncated;
+		}
+		::close(_mapping->fd);
+	}
+#endif
+	_base = nullptr;
+	_mapping.reset();
+}
+
+bool raft::read_trace(const std::string& path, Trace& trace)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in) {
+		return false;
+	}
+	std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	const char* cursor = data.data();
+	const char* end = data.data() + data.size();
+	if (data.size() < sizeof(trace_magic) || memcmp(cursor, trace_magic, sizeof(trace_magic)) != 0) {
+		return false;
+	}
+	cursor += sizeof(trace_magic);
+
+	uint32_t node_count;
+	if (!get(cursor, end, node_count) || !get(cursor, end, trace.config) || !get(cursor, end, trace.started_at_ns)) {
+		return false;
+	}
+	trace.tags.clear();
+	for (uint32_t i = 0; i < node_count; ++i) {
+		uint16_t length;
+		if (!get(cursor, end, length) || (size_t)(end - cursor) < length) {
+			return false;
+		}
+		trace.tags.emplace_back(cursor, length);
+		cursor += length;
+	}
+
+	trace.records.clear();
+	while (true) {
+		const char* record_end = cursor;
+		uint32_t size;
+		if (!get(cursor, end, size) || size < record_header_size || (size_t)(end - record_end) < size) {
+			break;
+		}
+		record_end += size;
+
+		TraceRecord record;
+		record.offset = (uint64_t)(record_end - size - data.data());
+		get(cursor, end, record.timestamp_ns);
+		get(cursor, end, record.source);
+		get(cursor, end, record.target);
+		get(cursor, end, record.type);
+		get(cursor, end, record.flags);
+		get(cursor, end, record.bytes);
+		record.payload.assign(cursor, record_end);
+		cursor = record_end;
+		trace.records.push_back(std::move(record));
+	}
+
+	// slots are reserved in order but filled concurrently, a few may be out of order
+	std::stable_sort(trace.records.begin(), trace.records.end(), [](const TraceRecord& a, const TraceRecord& b) {
+		return a.timestamp_ns < b.timestamp_ns;
+	});
+	return true;
+}
+
+raft::RaftMessage raft::trace_message(const TraceRecord& record)
+{
+	switch (record.type) {
+	case ClientRequest:
+		return std::make_unique<ClientRequestMessage>(record.payload, std::make_shared<std::promise<ClientReply>>());
+	case SetDead:
+		return std::make_unique<SetDeadMessage>();
+	case SetRestart:
+		return std::make_unique<SetRestartMessage>();
+	default:
+		break;
+	}
+
+	if (!is_wire_message((message_type)record.type)) {
+		return nullptr;
+	}
+	return decode_message(record.payload.data(), record.payload.size());
+}
+
+const char* raft::trace_type_name(uint8_t type)
+{
+	switch (type) {
+	case HeartbeatRequest: return "HeartbeatRequest";
+	case HeartbeatResponse: return "HeartbeatResponse";
+	case VotesRequest: return "VotesRequest";
+	case VotesResponse: return "VotesResponse";
+	case SetDead: return "SetDead";
+	case SetRestart: return "SetRestart";
+	case AppendEntriesRequest: return "AppendEntriesRequest";
+	case AppendEntriesResponse: return "AppendEntriesResponse";
+	case ClientRequest: return "ClientRequest";
+	case TraceElectionTimeout: return "ElectionTimeout";
+	case TraceBatch: return "Batch";
+	default: return "Unknown";
+	}
+}
+
+void raft::export_chrome_trace(const Trace& trace, std::ostream& out)
+{
+	// tid 0 is everything outside the cluster, node i is tid i + 1
+	auto tid_of = [](uint16_t id) {
+		return id == trace_external ? 0 : (int)id + 1;
+	};
+	auto name_of = [&trace](uint16_t id) -> std::string {
+		return id < trace.tags.size() ? trace.tags[id] : std::string("external");
+	};
+
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"raft\"}}";
+	out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"external\"}}";
+	for (size_t i = 0; i < trace.tags.size(); ++i) {
+		out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i + 1 << ",\"args\":{\"name\":";
+		put_json_string(out, trace.tags[i]);
+		out << "}}";
+	}
+
+	char ts[32];
+	for (size_t i = 0; i < trace.records.size(); ++i) {
+		const TraceRecord& record = trace.records[i];
+		snprintf(ts, sizeof(ts), "%.3f", (record.timestamp_ns - trace.started_at_ns) / 1000.0);
+		const char* name = trace_type_name(record.type);
+		int target = tid_of(record.target);
+
+		if (record.type == TraceElectionTimeout) {
+			out << ",\n{\"name\":\"" << name << "\",\"cat\":\"timer\",\"ph\":\"X\",\"dur\":1,\"ts\":" << ts << ",\"pid\":1,\"tid\":" << target << "}";
+			continue;
+		}
+		if (record.type == TraceBatch) {
+			out << ",\n{\"name\":\"" << name << "\",\"cat\":\"batch\",\"ph\":\"X\",\"dur\":1,\"ts\":" << ts << ",\"pid\":1,\"tid\":" << target
+				<< ",\"args\":{\"messages\":" << record.bytes << "}}";
+			continue;
+		}
+
+		// a 1us slice on both ends so the viewer has something to hang the flow arrow on
+		int source = tid_of(record.source);
+		out << ",\n{\"name\":\"send " << name << "\",\"cat\":\"message\",\"ph\":\"X\",\"dur\":1,\"ts\":" << ts << ",\"pid\":1,\"tid\":" << source << "}";
+		out << ",\n{\"name\":\"" << name << "\",\"cat\":\"message\",\"ph\":\"X\",\"dur\":1,\"ts\":" << ts << ",\"pid\":1,\"tid\":" << target
+			<< ",\"args\":{\"from\":";
+		put_json_string(out, name_of(record.source));
+		out << ",\"bytes\":" << record.bytes << ",\"delivered\":" << ((record.flags & TraceDelivered) ? "true" : "false") << "}}";
+		out << ",\n{\"name\":\"" << name << "\",\"cat\":\"flow\",\"ph\":\"s\",\"id\":" << i << ",\"ts\":" << ts << ",\"pid\":1,\"tid\":" << source << "}";
+		out << ",\n{\"name\":\"" << name << "\",\"cat\":\"flow\",\"ph\":\"f\",\"bp\":\"e\",\"id\":" << i << ",\"ts\":" << ts << ",\"pid\":1,\"tid\":" << target << "}";
+	}
+	out << "\n]}\n";
+}
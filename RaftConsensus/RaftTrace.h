@@ -0,0 +1,115 @@
+#pragma once
+#include "RaftMessage.h"
+#include "RaftConfig.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace raft {
+	// record kinds beyond message_type, local events the replay needs to reproduce a node
+	enum trace_event : uint8_t {
+		TraceElectionTimeout = 0x80,
+		// one drain of a node's inbox, the payload is the u64 trace_record of each message in
+		// processing order and bytes holds the count
+		TraceBatch = 0x81,
+	};
+
+	// node index of senders outside the cluster (clients, the tester)
+	const uint16_t trace_external = 0xffff;
+
+	enum trace_flags : uint8_t {
+		TraceDelivered = 1,
+	};
+
+	// the config fields that change how a node processes messages, replayed as recorded
+	struct TraceConfig {
+		int32_t max_append_entries;
+		int32_t max_inflight_appends;
+		int32_t max_apply_lag;
+		int32_t election_timeout_min_ms;
+		int32_t election_timeout_max_ms;
+		int32_t heartbeat_interval_ms;
+		uint64_t max_append_bytes;
+		uint64_t apply_queue_capacity;
+	};
+
+	struct TraceRecord {
+		// position in the file, what a message's trace_record holds
+		uint64_t offset;
+		int64_t timestamp_ns;
+		uint16_t source;
+		uint16_t target;
+		uint8_t type;
+		uint8_t flags;
+		// what the message cost against the inbox budget
+		uint32_t bytes;
+		// wire encoding for peer messages, the command for client requests, empty otherwise
+		std::string payload;
+	};
+
+	// appends fixed-layout records to a memory mapped file. writers on any thread reserve their
+	// slot with one atomic add and copy into the mapping, no lock and no syscall per record.
+	// the file is [header][records...], a record is
+	// [u32 size][i64 timestamp][u16 source][u16 target][u8 type][u8 flags][u32 bytes][payload]
+	// and a zero size marks the end. records past the capacity are counted and dropped
+	class TraceWriter {
+	private:
+		struct Mapping;
+		std::unique_ptr<Mapping> _mapping;
+		char* _base;
+		size_t _capacity;
+		alignas(64) std::atomic<size_t> _cursor;
+		std::atomic<uint64_t> _dropped;
+		std::unordered_map<std::string, uint16_t> _ids;
+		int64_t _started_at;
+
+	public:
+		TraceWriter(const std::string& path, size_t capacity, const std::vector<std::string>& tags, const RaftConfig& config);
+
+		~TraceWriter();
+
+		bool is_open() const { return _base != nullptr; }
+
+		uint16_t id_of(const std::string& tag) const;
+
+		// returns the record's offset, no_trace_record when it was dropped
+		uint64_t record(int64_t timestamp_ns, uint16_t source, uint16_t target, uint8_t type, uint8_t flags, uint32_t bytes, const char* payload, size_t payload_size);
+
+		// what the router calls per delivered message, tags outside the cluster map to trace_external
+		uint64_t record_message(int64_t timestamp_ns, const std::string& source, const std::string& target, const BaseMessage& message, bool delivered);
+
+		// sets TraceDelivered on a record already written, for outcomes known only after the send
+		void mark_delivered(uint64_t record);
+
+		uint64_t get_dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+		// unmaps and cuts the file down to the records written, idempotent
+		void close();
+	};
+
+	struct Trace {
+		std::vector<std::string> tags;
+		TraceConfig config;
+		int64_t started_at_ns;
+		std::vector<TraceRecord> records;
+	};
+
+	// the bytes a record keeps of a message, enough for trace_message to rebuild it
+	void trace_payload(const BaseMessage& message, std::string& out);
+
+	// false on a missing file or a bad header, records after a torn one are ignored
+	bool read_trace(const std::string& path, Trace& trace);
+
+	// rebuilds the message a record carried, nullptr for local events and undecodable payloads
+	RaftMessage trace_message(const TraceRecord& record);
+
+	const char* trace_type_name(uint8_t type);
+
+	// chrome://tracing / perfetto trace event json, one track per node and a flow arrow per message
+	void export_chrome_trace(const Trace& trace, std::ostream& out);
+}
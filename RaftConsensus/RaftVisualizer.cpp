@@ -1,8 +1,74 @@
 #include "RaftVisualizer.h"
 #include "RaftConsensus.h"
 
+#include <algorithm>
+#include <cstdio>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
 const int log_line_num = 10;
 
+namespace {
+	// leaders of the most recent terms shown in the header
+	const int leader_term_num = 8;
+
+	// a gap shorter than a cursor move is cheaper to rewrite than to jump over
+	const size_t merge_gap = 8;
+
+	int terminal_width() {
+#if defined(_WIN32)
+		CONSOLE_SCREEN_BUFFER_INFO info;
+		if (GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info)) {
+			return info.srWindow.Right - info.srWindow.Left + 1;
+		}
+#else
+		winsize size;
+		if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0) {
+			return size.ws_col;
+		}
+#endif
+		return 120;
+	}
+
+	// the console host needs vt processing switched on, terminals elsewhere understand it already
+	void enable_vt_mode() {
+#if defined(_WIN32)
+		HANDLE out = GetStdHandle(STD_OUTPUT_HANDLE);
+		DWORD mode = 0;
+		if (GetConsoleMode(out, &mode)) {
+			SetConsoleMode(out, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+		}
+#endif
+	}
+
+	// one terminal row: printable ascii only and never wider than the window, so rows never wrap
+	std::string fit_line(const std::string& text, size_t width) {
+		std::string line = text.substr(0, std::min(text.size(), width));
+		for (auto& c : line) {
+			if ((unsigned char)c < 0x20 || (unsigned char)c > 0x7e) {
+				c = ' ';
+			}
+		}
+		while (!line.empty() && line.back() == ' ') {
+			line.pop_back();
+		}
+		return line;
+	}
+
+	// n2 before n10
+	bool natural_less(const std::string& a, const std::string& b) {
+		return a.size() != b.size() ? a.size() < b.size() : a < b;
+	}
+}
+
 const char* get_status_str(raft::RaftStatus status) {
 	switch (status)
 	{
@@ -29,28 +95,250 @@ void raft::RaftVisualizer::add_logs(std::string log)
 	}
 }
 
-void raft::RaftVisualizer::poll(raft::RaftNode* node)
+void raft::RaftVisualizer::add_logs(std::vector<std::string> logs)
 {
 	std::lock_guard<std::mutex> lk(_mtx);
-	_current_states[node->get_tag()] = node->get_state();
+	size_t skip = logs.size() > log_line_num ? logs.size() - log_line_num : 0;
+	for (size_t i = skip; i < logs.size(); ++i) {
+		_logs.push_back(std::move(logs[i]));
+	}
+	while (_logs.size() > log_line_num) {
+		_logs.pop_front();
+	}
 }
 
-void raft::RaftVisualizer::spin_once()
+void raft::RaftVisualizer::attach(const std::string& tag, std::shared_ptr<const RaftStateSlot> slot)
+{
+	std::lock_guard<std::mutex> lk(_mtx);
+	_slots[tag] = std::move(slot);
+}
+
+void raft::RaftVisualizer::detach(const std::string& tag, const RaftStateSlot* slot)
 {
 	std::lock_guard<std::mutex> lk(_mtx);
-	
-	system("cls");
-	int log_num = (int)_logs.size();
-	for (int i = 0; i < log_num; ++i) {
-		printf("%s\n", _logs[i].c_str());
-	}
-	for (int i = 0; i < log_line_num - log_num; ++i) {
-		printf("\n");
-	}
-	
-	for (const auto& pair : _current_states) {
-		printf("%s : state [%s], term (%d), votes(%d), election_timeout(%d) heartbeat(%d)\n", 
-				pair.first.c_str(),
-				get_status_str(pair.second.status), pair.second.term, pair.second.votes, pair.second.election_timeout, pair.second.hearbeat_count);
+	auto it = _slots.find(tag);
+	if (it != _slots.end() && it->second.get() == slot) {
+		_slots.erase(it);
+	}
+}
+
+std::map<std::string, raft::RaftStateNode> raft::RaftVisualizer::get_states()
+{
+	std::map<std::string, std::shared_ptr<const RaftStateSlot>> slots;
+	{
+		std::lock_guard<std::mutex> lk(_mtx);
+		slots = _slots;
+	}
+
+	// seqlock reads, never wait on a node thread
+	std::map<std::string, raft::RaftStateNode> states;
+	for (const auto& pair : slots) {
+		states.emplace(pair.first, RaftStateNode(pair.first, pair.second->load()));
+	}
+	return states;
+}
+
+void raft::RaftVisualizer::reset()
+{
+	{
+		std::lock_guard<std::mutex> lk(_mtx);
+		_slots.clear();
+		_logs.clear();
+	}
+	std::lock_guard<std::mutex> lk(_render_mtx);
+	_rates.clear();
+	_screen.clear();
+	_page.store(0);
+}
+
+void raft::RaftVisualizer::prev_page()
+{
+	int page = _page.load();
+	while (page > 0 && !_page.compare_exchange_weak(page, page - 1)) {
+	}
+}
+
+void raft::RaftVisualizer::set_page_size(int rows)
+{
+	_page_size.store(std::max(rows, 1));
+}
+
+void raft::RaftVisualizer::invalidate()
+{
+	std::lock_guard<std::mutex> lk(_render_mtx);
+	_screen.clear();
+}
+
+std::vector<std::string> raft::RaftVisualizer::compose_frame(const std::deque<std::string>& logs, const std::map<std::string, RaftStateNode>& states)
+{
+	const size_t width = (size_t)std::max(terminal_width() - 1, 40);
+	const int64_t now = metrics_now_ns();
+
+	std::vector<const RaftStateNode*> nodes;
+	nodes.reserve(states.size());
+	int counts[4] = { 0, 0, 0, 0 };
+	int max_term = 0;
+	std::map<int, int> leaders;
+	double message_rate = 0.0;
+	double election_rate = 0.0;
+
+	for (const auto& pair : states) {
+		const RaftStateNode& state = pair.second;
+		nodes.push_back(&state);
+		if (state.status >= raft::Follower && state.status <= raft::Dead) {
+			counts[state.status]++;
+		}
+		max_term = std::max(max_term, state.term);
+		if (state.status == raft::Leader) {
+			leaders[state.term]++;
+		}
+
+		// rates over the time since this node was last drawn
+		auto it = _rates.find(pair.first);
+		if (it == _rates.end()) {
+			_rates.emplace(pair.first, RateSample{ state.messages_processed, state.elections_started, now, 0.0, 0.0 });
+			continue;
+		}
+		RateSample& sample = it->second;
+		double seconds = (now - sample.at_ns) / 1e9;
+		if (seconds > 0.0) {
+			sample.message_rate = std::max<double>(0.0, (double)(state.messages_processed - sample.messages) / seconds);
+			sample.election_rate = std::max<double>(0.0, (double)(state.elections_started - sample.elections) * 60.0 / seconds);
+		}
+		sample.messages = state.messages_processed;
+		sample.elections = state.elections_started;
+		sample.at_ns = now;
+		message_rate += sample.message_rate;
+		election_rate += sample.election_rate;
+	}
+	for (auto it = _rates.begin(); it != _rates.end();) {
+		it = states.count(it->first) ? std::next(it) : _rates.erase(it);
+	}
+	std::sort(nodes.begin(), nodes.end(), [](const RaftStateNode* a, const RaftStateNode* b) {
+		return natural_less(a->tag, b->tag);
+	});
+
+	const int page_size = _page_size.load();
+	const int page_count = std::max(1, ((int)nodes.size() + page_size - 1) / page_size);
+	int page = std::min(_page.load(), page_count - 1);
+	_page.store(page);
+
+	std::vector<std::string> frame;
+	frame.push_back(FORMAT("nodes %d  term %d  follower %d  candidate %d  leader %d  dead %d  msg/s %.0f  elections/min %.1f",
+		(int)nodes.size(), max_term, counts[raft::Follower], counts[raft::Candidate], counts[raft::Leader], counts[raft::Dead], message_rate, election_rate));
+
+	// more than one leader in a term would be a safety bug, it shows up here first
+	std::string line = "leaders per term:";
+	int shown = 0;
+	for (auto it = leaders.rbegin(); it != leaders.rend() && shown < leader_term_num; ++it, ++shown) {
+		line += FORMAT("  t%d=%d", it->first, it->second);
+		if (it->second > 1) {
+			line += " !!";
+		}
+	}
+	if (leaders.empty()) {
+		line += "  none";
+	}
+	frame.push_back(line);
+	frame.push_back(std::string());
+
+	for (const auto& log : logs) {
+		frame.push_back(log);
+	}
+	for (size_t i = logs.size(); i < (size_t)log_line_num; ++i) {
+		frame.push_back(std::string());
+	}
+	frame.push_back(std::string());
+
+	frame.push_back(FORMAT("%-10s %-9s %6s %5s %8s %8s %6s %7s %9s %9s %9s",
+		"node", "state", "term", "votes", "commit", "log", "queue", "dropped", "msg/s", "elect/min", "timeout"));
+	for (int row = 0; row < page_size; ++row) {
+		size_t index = (size_t)(page * page_size + row);
+		if (index >= nodes.size()) {
+			frame.push_back(std::string());
+			continue;
+		}
+		const RaftStateNode& state = *nodes[index];
+		const RateSample& sample = _rates[state.tag];
+		frame.push_back(FORMAT("%-10s %-9s %6d %5d %8d %8d %6d %7d %9.0f %9.1f %7dms",
+			state.tag.c_str(), get_status_str(state.status), state.term, state.votes, state.commit_index, state.last_log_index,
+			state.queue_depth, state.dropped_messages, sample.message_rate, sample.election_rate, state.election_timeout));
+	}
+	frame.push_back(FORMAT("page %d/%d  (n next, b previous)", page + 1, page_count));
+
+	for (auto& row : frame) {
+		row = fit_line(row, width);
+	}
+	return frame;
+}
+
+std::string raft::RaftVisualizer::diff_frame(const std::vector<std::string>& frame)
+{
+	std::string out;
+	if (_screen.empty()) {
+		out += "\x1b[2J";
+	}
+
+	const size_t rows = std::max(frame.size(), _screen.size());
+	for (size_t row = 0; row < rows; ++row) {
+		static const std::string blank;
+		const std::string& now = row < frame.size() ? frame[row] : blank;
+		const std::string& before = row < _screen.size() ? _screen[row] : blank;
+		if (now == before && !_screen.empty()) {
+			continue;
+		}
+
+		// runs of changed cells, a cell past the end of a line is blank
+		size_t col = 0;
+		while (col < now.size()) {
+			if (col < before.size() && before[col] == now[col]) {
+				++col;
+				continue;
+			}
+			size_t end = col + 1;
+			size_t same = 0;
+			while (end < now.size() && same < merge_gap) {
+				same = (end < before.size() && before[end] == now[end]) ? same + 1 : 0;
+				++end;
+			}
+			end -= same;
+			out += FORMAT("\x1b[%d;%dH", (int)row + 1, (int)col + 1);
+			out.append(now, col, end - col);
+			col = end;
+		}
+		if (before.size() > now.size()) {
+			out += FORMAT("\x1b[%d;%dH\x1b[K", (int)row + 1, (int)now.size() + 1);
+		}
+	}
+
+	if (!out.empty()) {
+		// park the cursor under the frame where typed commands echo
+		out += FORMAT("\x1b[%d;1H", (int)frame.size() + 1);
+	}
+	return out;
+}
+
+void raft::RaftVisualizer::spin_once()
+{
+	std::deque<std::string> logs;
+	{
+		std::lock_guard<std::mutex> lk(_mtx);
+		logs = _logs;
+	}
+	auto states = get_states();
+
+	std::lock_guard<std::mutex> lk(_render_mtx);
+	if (!_terminal_ready) {
+		enable_vt_mode();
+		_terminal_ready = true;
+	}
+
+	// only the changed cells go out, in one write
+	auto frame = compose_frame(logs, states);
+	std::string out = diff_frame(frame);
+	_screen = std::move(frame);
+	if (!out.empty()) {
+		fwrite(out.data(), 1, out.size(), stdout);
+		fflush(stdout);
 	}
 }
@@ -1,31 +1,82 @@
 #pragma once
 #include "Singleton.h"
+#include "SeqLock.h"
 #include "RaftState.h"
 #include "Format.h"
+#include "EventLog.h"
 
 #include <vector>
 #include <map>
 #include <string>
 #include <mutex>
 #include <deque>
+#include <atomic>
+#include <cstdint>
 
 namespace raft {
 	class RaftNode;
+
+	using RaftStateSlot = SeqLock<RaftStateSnapshot>;
+
 	class RaftVisualizer : public CSingleton<RaftVisualizer>
 	{
 	private:
+		// guards the slot registry and the log lines. node threads publish through their own
+		// slot and only take it to attach or detach
 		std::mutex _mtx;
-		std::map<std::string, raft::RaftStateNode> _current_states;
+		std::map<std::string, std::shared_ptr<const RaftStateSlot>> _slots;
 		std::deque<std::string> _logs;
 
+		// per node counters seen at the previous frame, turned into rates
+		struct RateSample {
+			int64_t messages;
+			int elections;
+			int64_t at_ns;
+			double message_rate;
+			double election_rate;
+		};
+
+		// guards the render state. _screen is what the terminal shows right now, a frame only
+		// rewrites the cells that differ from it
+		std::mutex _render_mtx;
+		std::vector<std::string> _screen;
+		std::map<std::string, RateSample> _rates;
+		bool _terminal_ready = false;
+		std::atomic<int> _page{ 0 };
+		std::atomic<int> _page_size{ 20 };
+
 	public:
+		// sink of the event log drain thread, node threads log through ADD_LOG
 		void add_logs(string log);
 
-		void poll(raft::RaftNode* node);
+		void add_logs(std::vector<string> logs);
+
+		void attach(const std::string& tag, std::shared_ptr<const RaftStateSlot> slot);
+
+		// no-op when the tag was re-attached to another slot since
+		void detach(const std::string& tag, const RaftStateSlot* slot);
 
 		void spin_once();
-	};
-}
 
-#define ADD_LOG(fmt, ...)\
-raft::RaftVisualizer::getInstance()->add_logs(Format::format(fmt, ##__VA_ARGS__));
\ No newline at end of file
+		// latest published state of every node, keyed by tag
+		std::map<std::string, raft::RaftStateNode> get_states();
+
+		void reset();
+
+		// node table paging, safe to call from any thread
+		void next_page() { _page.fetch_add(1); }
+
+		void prev_page();
+
+		void set_page_size(int rows);
+
+		// full redraw on the next frame, e.g. after something else wrote to the console
+		void invalidate();
+
+	private:
+		std::vector<std::string> compose_frame(const std::deque<std::string>& logs, const std::map<std::string, RaftStateNode>& states);
+
+		// escape sequences that turn the terminal from _screen into frame
+		std::string diff_frame(const std::vector<std::string>& frame);
+	};
+}
\ No newline at end of file
@@ -0,0 +1,218 @@
+#include "RaftWire.h"
+
+#include <cstring>
+
+namespace {
+	class WireWriter {
+	private:
+		std::string& _out;
+
+	public:
+		WireWriter(std::string& out) : _out(out) {}
+
+		template <typename T>
+		void put(T value) {
+			_out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+		}
+
+		void put_string(const std::string& value) {
+			put<uint32_t>((uint32_t)value.size());
+			_out.append(value);
+		}
+	};
+
+	class WireReader {
+	private:
+		const char* _data;
+		size_t _size;
+		bool _ok;
+
+	public:
+		WireReader(const char* data, size_t size) : _data(data), _size(size), _ok(true) {}
+
+		bool ok() const { return _ok; }
+
+		template <typename T>
+		T get() {
+			T value{};
+			if (_size < sizeof(T)) {
+				_ok = false;
+				return value;
+			}
+			memcpy(&value, _data, sizeof(T));
+			_data += sizeof(T);
+			_size -= sizeof(T);
+			return value;
+		}
+
+		std::string get_string() {
+			uint32_t length = get<uint32_t>();
+			if (!_ok || _size < length) {
+				_ok = false;
+				return std::string();
+			}
+			std::string value(_data, length);
+			_data += length;
+			_size -= length;
+			return value;
+		}
+	};
+
+	void put_state(WireWriter& writer, const raft::RaftStateNode& state) {
+		writer.put<int32_t>(state.term);
+		writer.put<int32_t>(state.status);
+		writer.put<int32_t>(state.last_voted_term);
+		writer.put<int32_t>(state.commit_index);
+		writer.put<int32_t>(state.last_log_index);
+		writer.put<int32_t>(state.last_log_term);
+		writer.put_string(state.tag);
+	}
+
+	raft::RaftStateNode get_state(WireReader& reader) {
+		raft::RaftStateNode state;
+		state.term = reader.get<int32_t>();
+		state.status = (raft::RaftStatus)reader.get<int32_t>();
+		state.last_voted_term = reader.get<int32_t>();
+		state.commit_index = reader.get<int32_t>();
+		state.last_log_index = reader.get<int32_t>();
+		state.last_log_term = reader.get<int32_t>();
+		state.tag = reader.get_string();
+		return state;
+	}
+}
+
+bool raft::is_wire_message(message_type type)
+{
+	switch (type) {
+	case HeartbeatRequest:
+	case HeartbeatResponse:
+	case VotesRequest:
+	case VotesResponse:
+	case AppendEntriesRequest:
+	case AppendEntriesResponse:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void raft::encode_message(const BaseMessage& message, std::string& out)
+{
+	WireWriter writer(out);
+	writer.put<uint8_t>((uint8_t)message.type);
+
+	switch (message.type) {
+	case HeartbeatRequest:
+	{
+		auto& m = static_cast<const HeartbeatRequestMessage&>(message);
+		writer.put<int32_t>(m.term);
+		writer.put<int64_t>(m.sent_at);
+		writer.put_string(m.target);
+	}break;
+	case HeartbeatResponse:
+	{
+		auto& m = static_cast<const HeartbeatResponseMessage&>(message);
+		writer.put<int32_t>(m.term);
+		writer.put<int32_t>(m.commit_index);
+		writer.put<int32_t>(m.last_log_index);
+		writer.put<int64_t>(m.request_sent_at);
+		writer.put_string(m.source);
+	}break;
+	case VotesRequest:
+		put_state(writer, message.node_state);
+		break;
+	case VotesResponse:
+		writer.put<int32_t>(static_cast<const VotesResponseMessage&>(message).term);
+		break;
+	case AppendEntriesRequest:
+	{
+		auto& m = static_cast<const AppendEntriesRequestMessage&>(message);
+		writer.put<int32_t>(m.term);
+		writer.put<int32_t>(m.prev_log_index);
+		writer.put<int32_t>(m.prev_log_term);
+		writer.put<int32_t>(m.leader_commit);
+		writer.put_string(m.leader);
+		writer.put<uint32_t>((uint32_t)m.entries.size());
+		for (const auto& entry : m.entries) {
+			writer.put<int32_t>(entry.term);
+			writer.put<int32_t>(entry.index);
+			writer.put_string(entry.command);
+		}
+	}break;
+	case AppendEntriesResponse:
+	{
+		auto& m = static_cast<const AppendEntriesResponseMessage&>(message);
+		writer.put<int32_t>(m.term);
+		writer.put<uint8_t>(m.success ? 1 : 0);
+		writer.put<int32_t>(m.match_index);
+		writer.put<int32_t>(m.applied_index);
+		writer.put_string(m.source);
+	}break;
+	default:
+		break;
+	}
+}
+
+raft::RaftMessage raft::decode_message(const char* data, size_t size)
+{
+	WireReader reader(data, size);
+	message_type type = (message_type)reader.get<uint8_t>();
+	RaftMessage message;
+
+	switch (type) {
+	case HeartbeatRequest:
+	{
+		int term = reader.get<int32_t>();
+		int64_t sent_at = reader.get<int64_t>();
+		auto m = std::make_unique<HeartbeatRequestMessage>(term, reader.get_string());
+		m->sent_at = sent_at;
+		message = std::move(m);
+	}break;
+	case HeartbeatResponse:
+	{
+		int term = reader.get<int32_t>();
+		int commit_index = reader.get<int32_t>();
+		int last_log_index = reader.get<int32_t>();
+		int64_t request_sent_at = reader.get<int64_t>();
+		message = std::make_unique<HeartbeatResponseMessage>(term, reader.get_string(), commit_index, last_log_index, request_sent_at);
+	}break;
+	case VotesRequest:
+		message = std::make_unique<VotesRequestMessage>(get_state(reader));
+		break;
+	case VotesResponse:
+		message = std::make_unique<VotesResponseMessage>(reader.get<int32_t>());
+		break;
+	case AppendEntriesRequest:
+	{
+		int term = reader.get<int32_t>();
+		int prev_log_index = reader.get<int32_t>();
+		int prev_log_term = reader.get<int32_t>();
+		int leader_commit = reader.get<int32_t>();
+		std::string leader = reader.get_string();
+		uint32_t count = reader.get<uint32_t>();
+
+		std::vector<LogEntry> entries;
+		for (uint32_t i = 0; i < count && reader.ok(); ++i) {
+			int entry_term = reader.get<int32_t>();
+			int entry_index = reader.get<int32_t>();
+			entries.emplace_back(entry_term, entry_index, reader.get_string());
+		}
+		message = std::make_unique<AppendEntriesRequestMessage>(term, leader, prev_log_index, prev_log_term, leader_commit, std::move(entries));
+	}break;
+	case AppendEntriesResponse:
+	{
+		int term = reader.get<int32_t>();
+		bool success = reader.get<uint8_t>() != 0;
+		int match_index = reader.get<int32_t>();
+		int applied_index = reader.get<int32_t>();
+		message = std::make_unique<AppendEntriesResponseMessage>(term, reader.get_string(), success, match_index, applied_index);
+	}break;
+	default:
+		return nullptr;
+	}
+
+	if (!reader.ok()) {
+		return nullptr;
+	}
+	return message;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "RaftMessage.h"
+
+#include <string>
+
+namespace raft {
+	// binary codec for peer messages that cross a transport. host byte order, the loopback
+	// transport never leaves the process. client requests and control messages carry local
+	// state (promises, kill switches) and are never encoded
+	bool is_wire_message(message_type type);
+
+	void encode_message(const BaseMessage& message, std::string& out);
+
+	// nullptr on a truncated or unknown frame
+	RaftMessage decode_message(const char* data, size_t size);
+}
@@ -0,0 +1,539 @@
+#include "ScenarioRunner.h"
+#include "RaftConsensus.h"
+#include "KvClient.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace {
+	double percentile(const std::vector<double>& sorted, double q) {
+		if (sorted.empty()) {
+			return 0.0;
+		}
+		size_t rank = (size_t)std::ceil(q * (double)sorted.size());
+		return sorted[std::max<size_t>(rank, 1) - 1];
+	}
+
+	bool parse_int(const std::string& text, int& value) {
+		char* end = nullptr;
+		long parsed = strtol(text.c_str(), &end, 10);
+		if (text.empty() || *end != '\0') {
+			return false;
+		}
+		value = (int)parsed;
+		return true;
+	}
+
+	bool parse_double(const std::string& text, double& value) {
+		char* end = nullptr;
+		value = strtod(text.c_str(), &end);
+		return !text.empty() && *end == '\0';
+	}
+
+	std::vector<std::string> split(const std::string& text, char separator) {
+		std::vector<std::string> parts;
+		std::istringstream in(text);
+		std::string part;
+		while (std::getline(in, part, separator)) {
+			if (!part.empty()) {
+				parts.push_back(part);
+			}
+		}
+		return parts;
+	}
+
+	// the leader of the highest live term, empty while there is none
+	std::string observe_leader(int& max_term) {
+		auto states = raft::RaftVisualizer::getInstance()->get_states();
+		std::string leader;
+		max_term = 0;
+		for (const auto& pair : states) {
+			if (pair.second.status != raft::Dead) {
+				max_term = std::max(max_term, pair.second.term);
+			}
+		}
+		for (const auto& pair : states) {
+			if (pair.second.status == raft::Leader && pair.second.term == max_term) {
+				leader = pair.first;
+			}
+		}
+		return leader;
+	}
+
+	int total_elections() {
+		int elections = 0;
+		for (const auto& pair : raft::RaftVisualizer::getInstance()->get_states()) {
+			elections += pair.second.elections_started;
+		}
+		return elections;
+	}
+
+	struct ClientStats {
+		uint64_t committed = 0;
+		uint64_t failed = 0;
+		std::vector<double> latencies_us;
+	};
+}
+
+bool raft::parse_scenario_action(const std::vector<std::string>& words, ScenarioAction& action, std::string& error)
+{
+	if (words.empty()) {
+		error = "missing action";
+		return false;
+	}
+
+	const std::string& verb = words[0];
+	size_t want = 2;
+	if (verb == "kill") {
+		action.kind = ScenarioKill;
+	}
+	else if (verb == "restart") {
+		action.kind = ScenarioRestart;
+	}
+	else if (verb == "isolate") {
+		action.kind = ScenarioIsolate;
+	}
+	else if (verb == "heal") {
+		action.kind = ScenarioHeal;
+		want = 1;
+	}
+	else if (verb == "delay") {
+		action.kind = ScenarioDelay;
+	}
+	else if (verb == "drop") {
+		action.kind = ScenarioDrop;
+	}
+	else if (verb == "skew") {
+		action.kind = ScenarioSkew;
+		want = 3;
+	}
+	else if (verb == "link") {
+		action.kind = ScenarioLink;
+		if (words.size() < 3 || words.size() % 2 == 0) {
+			error = "link <from> <to> [drop p] [dup p] [delay ms] [jitter ms]";
+			return false;
+		}
+		action.target = words[1];
+		action.peer = words[2];
+		action.link = LinkFault();
+		for (size_t i = 3; i + 1 < words.size(); i += 2) {
+			double value = 0.0;
+			if (!parse_double(words[i + 1], value) || value < 0.0) {
+				error = "bad link value '" + words[i + 1] + "'";
+				return false;
+			}
+			if (words[i] == "drop" && value <= 1.0) {
+				action.link.drop_rate = value;
+			}
+			else if (words[i] == "dup" && value <= 1.0) {
+				action.link.duplicate_rate = value;
+			}
+			else if (words[i] == "delay") {
+				action.link.latency_ms = (int)value;
+			}
+			else if (words[i] == "jitter") {
+				action.link.jitter_ms = (int)value;
+			}
+			else {
+				error = "bad link option '" + words[i] + " " + words[i + 1] + "'";
+				return false;
+			}
+		}
+		return true;
+	}
+	else if (verb == "partition") {
+		action.kind = ScenarioPartition;
+		if (words.size() < 3) {
+			error = "partition needs at least two groups";
+			return false;
+		}
+		action.groups.clear();
+		for (size_t i = 1; i < words.size(); ++i) {
+			action.groups.push_back(split(words[i], ','));
+		}
+		return true;
+	}
+	else {
+		error = "unknown action '" + verb + "'";
+		return false;
+	}
+
+	if (words.size() != want) {
+		error = verb + " takes " + std::to_string(want - 1) + " argument(s)";
+		return false;
+	}
+
+	switch (action.kind) {
+	case ScenarioKill:
+	case ScenarioRestart:
+	case ScenarioIsolate:
+		action.target = words[1];
+		break;
+	case ScenarioDelay:
+	case ScenarioDrop:
+		if (!parse_double(words[1], action.value) || action.value < 0.0 || (action.kind == ScenarioDrop && action.value > 1.0)) {
+			error = "bad " + verb + " value '" + words[1] + "'";
+			return false;
+		}
+		break;
+	case ScenarioSkew:
+		action.target = words[1];
+		if (!parse_double(words[2], action.value) || action.value <= 0.0) {
+			error = "bad skew factor '" + words[2] + "'";
+			return false;
+		}
+		break;
+	default:
+		break;
+	}
+	return true;
+}
+
+bool raft::parse_scenario(std::istream& in, Scenario& scenario, std::string& error)
+{
+	std::string line;
+	int line_number = 0;
+	auto fail = [&](const std::string& message) {
+		error = "line " + std::to_string(line_number) + ": " + message;
+		return false;
+	};
+
+	while (std::getline(in, line)) {
+		++line_number;
+		line = line.substr(0, line.find('#'));
+
+		std::istringstream tokens(line);
+		std::vector<std::string> words;
+		std::string word;
+		while (tokens >> word) {
+			words.push_back(word);
+		}
+		if (words.empty()) {
+			continue;
+		}
+
+		const std::string& key = words[0];
+		int a = 0, b = 0;
+		if (key == "phase") {
+			ScenarioPhase phase;
+			if (words.size() < 3 || !parse_int(words[2], phase.duration_ms) || phase.duration_ms <= 0) {
+				return fail("phase <name> <ms> [clients n] [payload bytes]");
+			}
+			phase.name = words[1];
+			if (!scenario.phases.empty()) {
+				phase.clients = scenario.phases.back().clients;
+				phase.payload_bytes = scenario.phases.back().payload_bytes;
+			}
+			for (size_t i = 3; i + 1 < words.size(); i += 2) {
+				int value = 0;
+				if (!parse_int(words[i + 1], value) || value < 0) {
+					return fail("bad value '" + words[i + 1] + "'");
+				}
+				if (words[i] == "clients") {
+					phase.clients = value;
+				}
+				else if (words[i] == "payload") {
+					phase.payload_bytes = value;
+				}
+				else {
+					return fail("unknown phase option '" + words[i] + "'");
+				}
+			}
+			scenario.phases.push_back(std::move(phase));
+		}
+		else if (key == "at") {
+			if (scenario.phases.empty()) {
+				return fail("'at' before the first phase");
+			}
+			ScenarioAction action;
+			if (words.size() < 3 || !parse_int(words[1], action.at_ms) || action.at_ms < 0) {
+				return fail("at <ms> <action>");
+			}
+			std::string action_error;
+			if (!parse_scenario_action(std::vector<std::string>(words.begin() + 2, words.end()), action, action_error)) {
+				return fail(action_error);
+			}
+			auto& actions = scenario.phases.back().actions;
+			actions.push_back(std::move(action));
+			std::stable_sort(actions.begin(), actions.end(), [](const ScenarioAction& x, const ScenarioAction& y) {
+				return x.at_ms < y.at_ms;
+			});
+		}
+		else if (!scenario.phases.empty()) {
+			return fail("cluster setting '" + key + "' after the first phase");
+		}
+		else if (key == "nodes" && words.size() == 2 && parse_int(words[1], a) && a > 0) {
+			scenario.nodes = a;
+		}
+		else if (key == "timeout" && words.size() == 3 && parse_int(words[1], a) && parse_int(words[2], b) && a > 0 && b >= a) {
+			scenario.config.election_timeout_min_ms = a;
+			scenario.config.election_timeout_max_ms = b;
+		}
+		else if (key == "heartbeat" && words.size() == 2 && parse_int(words[1], a) && a > 0) {
+			scenario.config.heartbeat_interval_ms = a;
+		}
+		else if (key == "vote_delay" && words.size() == 2 && parse_int(words[1], a) && a >= 0) {
+			scenario.config.vote_delay_ms = a;
+		}
+		else if (key == "batch" && words.size() == 2 && parse_int(words[1], a) && a > 0) {
+			scenario.config.max_append_entries = a;
+		}
+		else if (key == "transport" && words.size() == 2 && (words[1] == "inproc" || words[1] == "tcp")) {
+			scenario.config.loopback_tcp = words[1] == "tcp";
+		}
+		else if (key == "trace" && words.size() == 2) {
+			scenario.config.trace_path = words[1];
+		}
+		else {
+			return fail("bad statement '" + line + "'");
+		}
+	}
+
+	if (scenario.phases.empty()) {
+		error = "no phase declared";
+		return false;
+	}
+	return true;
+}
+
+void raft::apply_scenario_action(RaftRouter* router, const ScenarioAction& action)
+{
+	// "leader" is resolved when the action fires, "*" becomes the router's every-node tag
+	std::string target = action.target;
+	std::string peer = action.peer == "*" ? std::string() : action.peer;
+	if (target == "*") {
+		target.clear();
+	}
+	if (target == "leader" || peer == "leader") {
+		int term = 0;
+		std::string leader = observe_leader(term);
+		if (leader.empty()) {
+			ADD_LOG("scenario: no leader to act on");
+			return;
+		}
+		target = target == "leader" ? leader : target;
+		peer = peer == "leader" ? leader : peer;
+	}
+
+	switch (action.kind) {
+	case ScenarioKill:
+		router->set_dead(target);
+		break;
+	case ScenarioRestart:
+		for (auto node : router->get_all_nodes()) {
+			if (target == "all" || node->equal(target)) {
+				router->set_restart(node->get_tag());
+			}
+		}
+		break;
+	case ScenarioPartition:
+		router->set_partition(action.groups);
+		break;
+	case ScenarioIsolate:
+	{
+		std::vector<std::vector<std::string>> groups{ { target }, {} };
+		for (auto node : router->get_all_nodes()) {
+			if (!node->equal(target)) {
+				groups[1].push_back(node->get_tag());
+			}
+		}
+		router->set_partition(groups);
+	}break;
+	case ScenarioHeal:
+		router->heal();
+		ADD_LOG("network healed");
+		break;
+	case ScenarioDelay:
+		router->set_delay_ms((int)action.value);
+		ADD_LOG("network delay %dms", (int)action.value);
+		break;
+	case ScenarioDrop:
+		router->set_drop_rate(action.value);
+		ADD_LOG("network drop rate %.2f", action.value);
+		break;
+	case ScenarioSkew:
+		router->set_clock_skew(target, action.value);
+		ADD_LOG("node %s clock skew %.2f", target.c_str(), action.value);
+		break;
+	case ScenarioLink:
+		router->set_link(target, peer, action.link);
+		ADD_LOG("link %s -> %s drop %.2f dup %.2f delay %dms jitter %dms", target.empty() ? "*" : target.c_str(), peer.empty() ? "*" : peer.c_str(),
+			action.link.drop_rate, action.link.duplicate_rate, action.link.latency_ms, action.link.jitter_ms);
+		break;
+	}
+}
+
+bool raft::run_scenario(const Scenario& scenario, std::vector<ScenarioPhaseResult>& results)
+{
+	RaftRouter* router = new RaftRouter(scenario.config);
+	for (int i = 1; i <= scenario.nodes; ++i) {
+		router->add_node(new RaftNode(router, FORMAT("n%d", i)));
+	}
+	router->start();
+
+	// the first put waits out the initial election
+	KvClient warmup(router);
+	if (warmup.put("warmup", std::string()).status != KvOk) {
+		delete router;
+		return false;
+	}
+
+	for (const auto& phase : scenario.phases) {
+		const std::string payload(phase.payload_bytes, 'x');
+		std::vector<ClientStats> stats(phase.clients);
+		std::vector<std::thread> threads;
+
+		int elections_before = total_elections();
+		auto started = std::chrono::steady_clock::now();
+		auto deadline = started + std::chrono::milliseconds(phase.duration_ms);
+
+		for (int c = 0; c < phase.clients; ++c) {
+			threads.emplace_back([&, c]() {
+				// short attempts so a client notices the end of the phase even behind a partition
+				KvClient client(router, 4, std::chrono::milliseconds(500));
+				ClientStats& mine = stats[c];
+				for (uint64_t i = 0; std::chrono::steady_clock::now() < deadline; ++i) {
+					auto begin = std::chrono::steady_clock::now();
+					auto reply = client.put(FORMAT("c%d-%d", c, (int)(i % 1024)), payload);
+					auto end = std::chrono::steady_clock::now();
+
+					if (reply.status == KvOk) {
+						mine.committed++;
+						mine.latencies_us.push_back(std::chrono::duration<double, std::micro>(end - begin).count());
+					}
+					else {
+						mine.failed++;
+					}
+				}
+			});
+		}
+
+		// fires the phase's actions on time and watches the leader in between
+		size_t next_action = 0;
+		int leader_changes = 0;
+		int term = 0;
+		std::string leader = observe_leader(term);
+		while (true) {
+			auto now = std::chrono::steady_clock::now();
+			int elapsed_ms = (int)std::chrono::duration_cast<std::chrono::milliseconds>(now - started).count();
+			while (next_action < phase.actions.size() && phase.actions[next_action].at_ms <= elapsed_ms) {
+				apply_scenario_action(router, phase.actions[next_action++]);
+			}
+
+			std::string observed = observe_leader(term);
+			if (observed != leader) {
+				leader = observed;
+				++leader_changes;
+			}
+
+			if (now >= deadline) {
+				break;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+
+		for (auto& t : threads) {
+			t.join();
+		}
+
+		ScenarioPhaseResult result{ phase.name, phase.clients, phase.payload_bytes, 0.0, 0, 0, 0.0, 0.0, 0.0, 0.0, 0, leader_changes, term, leader };
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+		result.elections_started = total_elections() - elections_before;
+
+		std::vector<double> latencies;
+		for (auto& s : stats) {
+			result.committed_ops += s.committed;
+			result.failed_ops += s.failed;
+			latencies.insert(latencies.end(), s.latencies_us.begin(), s.latencies_us.end());
+		}
+		std::sort(latencies.begin(), latencies.end());
+		result.ops_per_sec = (double)result.committed_ops / result.seconds;
+		result.latency_p50_us = percentile(latencies, 0.5);
+		result.latency_p99_us = percentile(latencies, 0.99);
+		result.latency_max_us = latencies.empty() ? 0.0 : latencies.back();
+		results.push_back(std::move(result));
+	}
+
+	delete router;
+	return true;
+}
+
+std::string raft::scenario_results_to_json(const std::vector<ScenarioPhaseResult>& results)
+{
+	std::ostringstream out;
+	out << "{\"benchmark\":\"scenario\",\"phases\":[";
+	const char* separator = "";
+	for (const auto& r : results) {
+		out << separator << "{"
+			<< "\"name\":\"" << r.name << "\""
+			<< ",\"clients\":" << r.clients
+			<< ",\"payload_bytes\":" << r.payload_bytes
+			<< ",\"seconds\":" << r.seconds
+			<< ",\"committed_ops\":" << r.committed_ops
+			<< ",\"failed_ops\":" << r.failed_ops
+			<< ",\"ops_per_sec\":" << r.ops_per_sec
+			<< ",\"latency_us\":{\"p50\":" << r.latency_p50_us << ",\"p99\":" << r.latency_p99_us << ",\"max\":" << r.latency_max_us << "}"
+			<< ",\"elections_started\":" << r.elections_started
+			<< ",\"leader_changes\":" << r.leader_changes
+			<< ",\"final_term\":" << r.final_term
+			<< ",\"final_leader\":\"" << r.final_leader << "\""
+			<< "}";
+		separator = ",";
+	}
+	out << "]}";
+	return out.str();
+}
+
+int raft::run_scenario_tool(int argc, char** argv)
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage: --scenario <file> [--out file.json]\n");
+		return 1;
+	}
+
+	std::string out_path;
+	for (int i = 2; i + 1 < argc; ++i) {
+		if (strcmp(argv[i], "--out") == 0) {
+			out_path = argv[++i];
+		}
+	}
+
+	std::ifstream in(argv[1]);
+	if (!in) {
+		fprintf(stderr, "cannot open scenario %s\n", argv[1]);
+		return 1;
+	}
+
+	Scenario scenario;
+	std::string error;
+	if (!parse_scenario(in, scenario, error)) {
+		fprintf(stderr, "%s: %s\n", argv[1], error.c_str());
+		return 1;
+	}
+
+	std::vector<ScenarioPhaseResult> results;
+	if (!run_scenario(scenario, results)) {
+		fprintf(stderr, "no leader was elected, nothing ran\n");
+		return 1;
+	}
+
+	printf("%-16s %7s %9s %9s %7s %10s %10s %10s %9s %8s %5s %s\n",
+		"phase", "clients", "committed", "ops/s", "failed", "p50_us", "p99_us", "max_us", "elections", "changes", "term", "leader");
+	for (const auto& r : results) {
+		printf("%-16s %7d %9llu %9.0f %7llu %10.0f %10.0f %10.0f %9d %8d %5d %s\n",
+			r.name.c_str(), r.clients, (unsigned long long)r.committed_ops, r.ops_per_sec, (unsigned long long)r.failed_ops,
+			r.latency_p50_us, r.latency_p99_us, r.latency_max_us, r.elections_started, r.leader_changes, r.final_term,
+			r.final_leader.empty() ? "-" : r.final_leader.c_str());
+	}
+
+	if (!out_path.empty()) {
+		std::ofstream out(out_path);
+		out << scenario_results_to_json(results) << "\n";
+	}
+	return 0;
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include "RaftConfig.h"
+#include "RaftRouter.h"
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace raft {
+	enum scenario_action_kind {
+		ScenarioKill,
+		ScenarioRestart,
+		ScenarioPartition,
+		ScenarioIsolate,
+		ScenarioHeal,
+		ScenarioDelay,
+		ScenarioDrop,
+		ScenarioSkew,
+		ScenarioLink,
+	};
+
+	struct ScenarioAction {
+		int at_ms = 0;
+		scenario_action_kind kind = ScenarioHeal;
+		// a node tag, "leader" or "all"
+		std::string target;
+		// receiving end of a link action, target is the sending end. "*" is every node
+		std::string peer;
+		LinkFault link;
+		std::vector<std::vector<std::string>> groups;
+		double value = 0.0;
+	};
+
+	struct ScenarioPhase {
+		std::string name;
+		int duration_ms = 1000;
+		int clients = 1;
+		int payload_bytes = 64;
+		std::vector<ScenarioAction> actions;
+	};
+
+	// a scenario file is one statement per line, # starts a comment:
+	//
+	//   nodes 5                          cluster settings, before the first phase
+	//   timeout 150 300
+	//   heartbeat 50
+	//   vote_delay 5
+	//   batch 64
+	//   transport inproc|tcp
+	//   trace file
+	//
+	//   phase <name> <ms> [clients n] [payload bytes]
+	//   at <ms> kill <node|leader>       actions, at an offset into the phase above them
+	//   at <ms> restart <node|all>
+	//   at <ms> partition n1,n2 n3,n4,n5
+	//   at <ms> isolate <node|leader>    partition of the node against everyone else
+	//   at <ms> heal                     clears every link fault
+	//   at <ms> delay <ms>
+	//   at <ms> drop <probability>
+	//   at <ms> skew <node|leader> <factor>
+	//   at <ms> link <from> <to> [drop p] [dup p] [delay ms] [jitter ms]
+	//                                    one direction only, from/to are a node, leader or *.
+	//                                    options left out are cleared, "link a b" alone resets it
+	//
+	// phases run back to back and faults carry over until healed
+	struct Scenario {
+		int nodes = 5;
+		RaftConfig config;
+		std::vector<ScenarioPhase> phases;
+
+		Scenario() {
+			config.election_timeout_min_ms = 150;
+			config.election_timeout_max_ms = 300;
+			config.heartbeat_interval_ms = 50;
+			config.vote_delay_ms = 5;
+		}
+	};
+
+	struct ScenarioPhaseResult {
+		std::string name;
+		int clients;
+		int payload_bytes;
+		double seconds;
+		uint64_t committed_ops;
+		uint64_t failed_ops;
+		double ops_per_sec;
+		// put latency as seen by the client, in microseconds
+		double latency_p50_us;
+		double latency_p99_us;
+		double latency_max_us;
+		int elections_started;
+		// times the observed leader changed, including to and from no leader
+		int leader_changes;
+		int final_term;
+		std::string final_leader;
+	};
+
+	// false with a message naming the line on a syntax error
+	bool parse_scenario(std::istream& in, Scenario& scenario, std::string& error);
+
+	// the words after "at <ms>", shared with the interactive tester
+	bool parse_scenario_action(const std::vector<std::string>& words, ScenarioAction& action, std::string& error);
+
+	void apply_scenario_action(RaftRouter* router, const ScenarioAction& action);
+
+	// runs every phase against a fresh cluster, false when no leader came up to start with
+	bool run_scenario(const Scenario& scenario, std::vector<ScenarioPhaseResult>& results);
+
+	std::string scenario_results_to_json(const std::vector<ScenarioPhaseResult>& results);
+
+	// --scenario <file> [--out file.json]
+	int run_scenario_tool(int argc, char** argv);
+}
@@ -0,0 +1,182 @@
+#include "ThreadPlacement.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+std::vector<int> raft::available_cpus()
+{
+	std::vector<int> cpus;
+#if defined(_WIN32)
+	DWORD_PTR process_mask = 0, system_mask = 0;
+	if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask)) {
+		for (int cpu = 0; cpu < (int)(sizeof(DWORD_PTR) * 8); ++cpu) {
+			if (process_mask & ((DWORD_PTR)1 << cpu)) {
+				cpus.push_back(cpu);
+			}
+		}
+	}
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+		for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+			if (CPU_ISSET(cpu, &set)) {
+				cpus.push_back(cpu);
+			}
+		}
+	}
+#endif
+	return cpus;
+}
+
+int raft::numa_node_of(int cpu)
+{
+	if (cpu < 0) {
+		return 0;
+	}
+#if defined(_WIN32)
+	PROCESSOR_NUMBER processor{};
+	processor.Group = 0;
+	processor.Number = (BYTE)cpu;
+	USHORT node = 0;
+	if (GetNumaProcessorNodeEx(&processor, &node) && node != 0xffff) {
+		return (int)node;
+	}
+#elif defined(__linux__)
+	// sysfs links every cpu into its node directory
+	for (int node = 0; node < 64; ++node) {
+		std::string path = "/sys/devices/system/node/node" + std::to_string(node) + "/cpu" + std::to_string(cpu);
+		if (access(path.c_str(), F_OK) == 0) {
+			return node;
+		}
+	}
+#endif
+	return 0;
+}
+
+bool raft::pin_current_thread(int cpu)
+{
+	if (cpu < 0) {
+		return true;
+	}
+#if defined(_WIN32)
+	if (cpu >= (int)(sizeof(DWORD_PTR) * 8)) {
+		return false;
+	}
+	return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0;
+#elif defined(__linux__)
+	if (cpu >= CPU_SETSIZE) {
+		return false;
+	}
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
+
+bool raft::parse_cpu_list(const std::string& text, std::vector<int>& cpus)
+{
+	cpus.clear();
+	std::istringstream in(text);
+	std::string item;
+	while (std::getline(in, item, ',')) {
+		if (item.empty()) {
+			continue;
+		}
+		char* end = nullptr;
+		long first = strtol(item.c_str(), &end, 10);
+		long last = first;
+		if (end == item.c_str() || first < 0) {
+			return false;
+		}
+		if (*end == '-') {
+			const char* from = end + 1;
+			last = strtol(from, &end, 10);
+			if (end == from || last < first) {
+				return false;
+			}
+		}
+		if (*end != '\0') {
+			return false;
+		}
+		for (long cpu = first; cpu <= last; ++cpu) {
+			cpus.push_back((int)cpu);
+		}
+	}
+	std::sort(cpus.begin(), cpus.end());
+	cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+	return !cpus.empty();
+}
+
+void raft::spread_placement(RaftConfig& config, int nodes, const std::vector<int>& cpus)
+{
+	config.node_cpus.assign(nodes, -1);
+	config.heartbeat_cpus.assign(nodes, -1);
+
+	std::map<int, std::vector<int>> by_numa;
+	for (int cpu : cpus.empty() ? available_cpus() : cpus) {
+		by_numa[numa_node_of(cpu)].push_back(cpu);
+	}
+	if (by_numa.empty() || nodes <= 0) {
+		return;
+	}
+
+	std::vector<std::vector<int>*> numa_nodes;
+	for (auto& entry : by_numa) {
+		numa_nodes.push_back(&entry.second);
+	}
+
+	// workers first so every node gets a core of its own before any heartbeat thread does
+	std::vector<size_t> used(numa_nodes.size(), 0);
+	for (int i = 0; i < nodes; ++i) {
+		size_t numa = (size_t)i % numa_nodes.size();
+		const std::vector<int>& local = *numa_nodes[numa];
+		config.node_cpus[i] = local[used[numa]++ % local.size()];
+	}
+	for (int i = 0; i < nodes; ++i) {
+		size_t numa = (size_t)i % numa_nodes.size();
+		const std::vector<int>& local = *numa_nodes[numa];
+		config.heartbeat_cpus[i] = used[numa] < local.size() ? local[used[numa]++] : config.node_cpus[i];
+	}
+}
+
+std::string raft::describe_placement(const RaftConfig& config, const std::vector<std::string>& tags)
+{
+	std::ostringstream out;
+	for (size_t i = 0; i < tags.size(); ++i) {
+		int worker = i < config.node_cpus.size() ? config.node_cpus[i] : -1;
+		int heartbeat = i < config.heartbeat_cpus.size() ? config.heartbeat_cpus[i] : -1;
+		out << tags[i] << " -> ";
+		if (worker < 0) {
+			out << "any cpu";
+		}
+		else {
+			out << "cpu " << worker << " (numa " << numa_node_of(worker) << ")";
+		}
+		out << ", heartbeat ";
+		if (heartbeat < 0) {
+			out << "any cpu";
+		}
+		else {
+			out << "cpu " << heartbeat;
+		}
+		out << "\n";
+	}
+	return out.str();
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "RaftConfig.h"
+
+#include <string>
+#include <vector>
+
+namespace raft {
+	// cpus this process is allowed to run on, ascending. only the first 64 on windows (one processor group)
+	std::vector<int> available_cpus();
+
+	// numa node a cpu belongs to, 0 when the topology is unknown
+	int numa_node_of(int cpu);
+
+	// pins the calling thread to one cpu, false when the os refused. a negative cpu leaves the thread alone
+	bool pin_current_thread(int cpu);
+
+	// "0-3,8,10-11", false on a syntax error
+	bool parse_cpu_list(const std::string& text, std::vector<int>& cpus);
+
+	// fills config.node_cpus and config.heartbeat_cpus for nodes nodes over cpus (available_cpus() when empty).
+	// nodes are dealt round robin over the numa nodes, each worker gets a cpu of its own where there are enough
+	// and the heartbeat thread takes a spare cpu on the same numa node, or shares the worker's
+	void spread_placement(RaftConfig& config, int nodes, const std::vector<int>& cpus = {});
+
+	// "n1 -> cpu 0 (numa 0), heartbeat cpu 1" per node, for logs and bench output
+	std::string describe_placement(const RaftConfig& config, const std::vector<std::string>& tags);
+}
@@ -0,0 +1,277 @@
+#include "ThroughputBench.h"
+#include "RaftConsensus.h"
+#include "KvClient.h"
+#include "ThreadPlacement.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace {
+	double percentile(const std::vector<double>& sorted, double q) {
+		if (sorted.empty()) {
+			return 0.0;
+		}
+		size_t rank = (size_t)std::ceil(q * (double)sorted.size());
+		return sorted[std::max<size_t>(rank, 1) - 1];
+	}
+
+	std::vector<int> parse_list(const std::string& text) {
+		std::vector<int> values;
+		std::istringstream in(text);
+		std::string item;
+		while (std::getline(in, item, ',')) {
+			int value = atoi(item.c_str());
+			if (value > 0) {
+				values.push_back(value);
+			}
+		}
+		return values;
+	}
+
+	struct ClientStats {
+		uint64_t committed = 0;
+		uint64_t failed = 0;
+		std::vector<double> latencies_us;
+	};
+}
+
+raft::ThroughputBenchResult raft::run_throughput_case(int nodes, int payload_bytes, int clients, int batch_limit, bool loopback_tcp, bool pinned, const ThroughputBenchOptions& options)
+{
+	RaftConfig config = options.config;
+	config.max_append_entries = batch_limit;
+	config.loopback_tcp = loopback_tcp;
+	if (pinned) {
+		spread_placement(config, nodes, options.cpus);
+	}
+
+	// the histogram is process wide, earlier cases must not leak into this one
+	Histogram& heartbeat_rtt = METRIC_HISTOGRAM("raft.heartbeat_rtt_ns");
+	heartbeat_rtt.reset();
+
+	RaftRouter* router = new RaftRouter(config);
+	for (int i = 1; i <= nodes; ++i) {
+		router->add_node(new RaftNode(router, FORMAT("n%d", i)));
+	}
+	router->start();
+
+	ThroughputBenchResult result{ loopback_tcp ? "tcp" : "inproc", pinned ? "spread" : "none", nodes, payload_bytes, clients, batch_limit, 0, 0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0, 0.0, 0.0, 0.0 };
+
+	// the first put waits out the initial election
+	KvClient warmup(router);
+	if (warmup.put("warmup", std::string()).status != KvOk) {
+		delete router;
+		return result;
+	}
+	// recorded by the leader, process wide like the heartbeat one. the warmup entry waited out the election
+	Histogram& commit_latency = METRIC_HISTOGRAM("raft.commit_latency_ns");
+	commit_latency.reset();
+
+	const std::string payload(payload_bytes, 'x');
+	std::vector<ClientStats> stats(clients);
+	std::vector<std::thread> threads;
+
+	auto started = std::chrono::steady_clock::now();
+	auto deadline = started + std::chrono::milliseconds(options.duration_ms);
+	for (int c = 0; c < clients; ++c) {
+		threads.emplace_back([&, c]() {
+			KvClient client(router);
+			ClientStats& mine = stats[c];
+			// a bounded key space keeps the state machine small, the log still grows with every put
+			for (uint64_t i = 0; std::chrono::steady_clock::now() < deadline; ++i) {
+				auto begin = std::chrono::steady_clock::now();
+				auto reply = client.put(FORMAT("c%d-%d", c, (int)(i % 1024)), payload);
+				auto end = std::chrono::steady_clock::now();
+
+				if (reply.status == KvOk) {
+					mine.committed++;
+					mine.latencies_us.push_back(std::chrono::duration<double, std::micro>(end - begin).count());
+				}
+				else {
+					mine.failed++;
+				}
+			}
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+	delete router;
+
+	HistogramSnapshot rtt = heartbeat_rtt.snapshot();
+	result.heartbeats = rtt.count;
+	result.heartbeat_rtt_p50_us = rtt.p50 / 1000.0;
+	result.heartbeat_rtt_p99_us = rtt.p99 / 1000.0;
+	result.heartbeat_rtt_max_us = rtt.max / 1000.0;
+
+	HistogramSnapshot commits = commit_latency.snapshot();
+	result.commit_latency_p50_us = commits.p50 / 1000.0;
+	result.commit_latency_p99_us = commits.p99 / 1000.0;
+	result.commit_latency_max_us = commits.max / 1000.0;
+
+	std::vector<double> latencies;
+	for (auto& s : stats) {
+		result.committed_ops += s.committed;
+		result.failed_ops += s.failed;
+		latencies.insert(latencies.end(), s.latencies_us.begin(), s.latencies_us.end());
+	}
+	std::sort(latencies.begin(), latencies.end());
+
+	result.ops_per_sec = (double)result.committed_ops / result.seconds;
+	result.bytes_per_sec = result.ops_per_sec * payload_bytes;
+	result.client_rtt_p50_us = percentile(latencies, 0.5);
+	result.client_rtt_p90_us = percentile(latencies, 0.9);
+	result.client_rtt_p99_us = percentile(latencies, 0.99);
+	result.client_rtt_p999_us = percentile(latencies, 0.999);
+	result.client_rtt_max_us = latencies.empty() ? 0.0 : latencies.back();
+	return result;
+}
+
+std::string raft::throughput_results_to_json(const std::vector<ThroughputBenchResult>& results)
+{
+	std::ostringstream out;
+	out << "{\"benchmark\":\"replication_throughput\",\"runs\":[";
+	const char* separator = "";
+	for (const auto& r : results) {
+		out << separator << "{"
+			<< "\"transport\":\"" << r.transport << "\""
+			<< ",\"placement\":\"" << r.placement << "\""
+			<< ",\"nodes\":" << r.nodes
+			<< ",\"payload_bytes\":" << r.payload_bytes
+			<< ",\"clients\":" << r.clients
+			<< ",\"max_append_entries\":" << r.batch_limit
+			<< ",\"committed_ops\":" << r.committed_ops
+			<< ",\"failed_ops\":" << r.failed_ops
+			<< ",\"seconds\":" << r.seconds
+			<< ",\"ops_per_sec\":" << r.ops_per_sec
+			<< ",\"bytes_per_sec\":" << r.bytes_per_sec
+			<< ",\"client_rtt_us\":{"
+			<< "\"p50\":" << r.client_rtt_p50_us
+			<< ",\"p90\":" << r.client_rtt_p90_us
+			<< ",\"p99\":" << r.client_rtt_p99_us
+			<< ",\"p999\":" << r.client_rtt_p999_us
+			<< ",\"max\":" << r.client_rtt_max_us
+			<< "},\"commit_latency_us\":{"
+			<< "\"p50\":" << r.commit_latency_p50_us
+			<< ",\"p99\":" << r.commit_latency_p99_us
+			<< ",\"max\":" << r.commit_latency_max_us
+			<< "},\"heartbeat_rtt_us\":{"
+			<< "\"count\":" << r.heartbeats
+			<< ",\"p50\":" << r.heartbeat_rtt_p50_us
+			<< ",\"p99\":" << r.heartbeat_rtt_p99_us
+			<< ",\"max\":" << r.heartbeat_rtt_max_us
+			<< "}}";
+		separator = ",";
+	}
+	out << "]}";
+	return out.str();
+}
+
+int raft::run_throughput_bench(int argc, char** argv)
+{
+	ThroughputBenchOptions options;
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : "";
+
+		if (arg == "--sizes") {
+			options.cluster_sizes = parse_list(value); ++i;
+		}
+		else if (arg == "--payloads") {
+			options.payload_bytes = parse_list(value); ++i;
+		}
+		else if (arg == "--clients") {
+			options.client_counts = parse_list(value); ++i;
+		}
+		else if (arg == "--batches") {
+			options.batch_limits = parse_list(value); ++i;
+		}
+		else if (arg == "--transport") {
+			options.in_process = strcmp(value, "tcp") != 0;
+			options.loopback_tcp = strcmp(value, "inproc") != 0;
+			++i;
+		}
+		else if (arg == "--duration") {
+			options.duration_ms = atoi(value); ++i;
+		}
+		else if (arg == "--pin") {
+			if (strcmp(value, "none") != 0 && strcmp(value, "spread") != 0 && strcmp(value, "both") != 0) {
+				fprintf(stderr, "bad placement '%s', expected none, spread or both\n", value);
+				return 1;
+			}
+			options.unpinned = strcmp(value, "spread") != 0;
+			options.pinned = strcmp(value, "none") != 0;
+			++i;
+		}
+		else if (arg == "--cpus") {
+			if (!parse_cpu_list(value, options.cpus)) {
+				fprintf(stderr, "bad cpu list '%s'\n", value);
+				return 1;
+			}
+			++i;
+		}
+		else if (arg == "--heartbeat") {
+			options.config.heartbeat_interval_ms = atoi(value); ++i;
+		}
+		else if (arg == "--trace") {
+			options.config.trace_path = value; ++i;
+		}
+		else if (arg == "--out") {
+			options.output_path = value; ++i;
+		}
+	}
+
+	std::vector<bool> transports;
+	if (options.in_process) transports.push_back(false);
+	if (options.loopback_tcp) transports.push_back(true);
+
+	std::vector<bool> placements;
+	if (options.unpinned) placements.push_back(false);
+	if (options.pinned && !options.cluster_sizes.empty()) {
+		placements.push_back(true);
+
+		RaftConfig preview;
+		std::vector<std::string> tags;
+		int largest = *std::max_element(options.cluster_sizes.begin(), options.cluster_sizes.end());
+		for (int i = 1; i <= largest; ++i) {
+			tags.push_back(FORMAT("n%d", i));
+		}
+		spread_placement(preview, largest, options.cpus);
+		fprintf(stderr, "pinned placement:\n%s", describe_placement(preview, tags).c_str());
+	}
+
+	// progress goes to stderr so stdout stays plain json
+	std::vector<ThroughputBenchResult> results;
+	for (bool tcp : transports) {
+		for (int nodes : options.cluster_sizes) {
+			for (int batch : options.batch_limits) {
+				for (int payload : options.payload_bytes) {
+					for (int clients : options.client_counts) {
+						for (bool pinned : placements) {
+							auto r = run_throughput_case(nodes, payload, clients, batch, tcp, pinned, options);
+							fprintf(stderr, "%-6s %-6s nodes=%d batch=%d payload=%d clients=%d: %.0f ops/s %.1f MB/s rtt p50=%.0fus p99=%.0fus commit p50=%.0fus p99=%.0fus heartbeat p50=%.0fus p99=%.0fus failed=%llu\n",
+								r.transport.c_str(), r.placement.c_str(), nodes, batch, payload, clients, r.ops_per_sec, r.bytes_per_sec / (1 << 20),
+								r.client_rtt_p50_us, r.client_rtt_p99_us, r.commit_latency_p50_us, r.commit_latency_p99_us, r.heartbeat_rtt_p50_us, r.heartbeat_rtt_p99_us, (unsigned long long)r.failed_ops);
+							results.push_back(std::move(r));
+						}
+					}
+				}
+			}
+		}
+	}
+
+	std::string json = throughput_results_to_json(results);
+	if (!options.output_path.empty()) {
+		std::ofstream out(options.output_path);
+		out << json << "\n";
+	}
+	else {
+		printf("%s\n", json.c_str());
+	}
+	return 0;
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "RaftConfig.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace raft {
+	struct ThroughputBenchOptions {
+		std::vector<int> cluster_sizes = { 3 };
+		std::vector<int> payload_bytes = { 64, 1024 };
+		std::vector<int> client_counts = { 1, 16 };
+		// leader side batch limit, RaftConfig::max_append_entries
+		std::vector<int> batch_limits = { 64 };
+		bool in_process = true;
+		bool loopback_tcp = true;
+		// runs every case with threads left to the os, pinned by spread_placement, or both
+		bool unpinned = true;
+		bool pinned = false;
+		// cpus the pinned runs spread over, every allowed cpu when empty
+		std::vector<int> cpus;
+		int duration_ms = 1000;
+		std::string output_path;
+
+		RaftConfig config;
+
+		ThroughputBenchOptions() {
+			config.election_timeout_min_ms = 150;
+			config.election_timeout_max_ms = 300;
+			config.heartbeat_interval_ms = 50;
+			config.vote_delay_ms = 0;
+		}
+	};
+
+	struct ThroughputBenchResult {
+		std::string transport;
+		// "none" or "spread", see ThreadPlacement.h
+		std::string placement;
+		int nodes;
+		int payload_bytes;
+		int clients;
+		int batch_limit;
+		uint64_t committed_ops;
+		uint64_t failed_ops;
+		double seconds;
+		double ops_per_sec;
+		double bytes_per_sec;
+		// put to reply as seen by the client, in microseconds
+		double client_rtt_p50_us;
+		double client_rtt_p90_us;
+		double client_rtt_p99_us;
+		double client_rtt_p999_us;
+		double client_rtt_max_us;
+		// leader append to commit, in microseconds
+		double commit_latency_p50_us;
+		double commit_latency_p99_us;
+		double commit_latency_max_us;
+		// leader heartbeat to follower response, in microseconds
+		uint64_t heartbeats;
+		double heartbeat_rtt_p50_us;
+		double heartbeat_rtt_p99_us;
+		double heartbeat_rtt_max_us;
+	};
+
+	// KvClient puts from clients threads against one cluster for duration_ms
+	ThroughputBenchResult run_throughput_case(int nodes, int payload_bytes, int clients, int batch_limit, bool loopback_tcp, bool pinned, const ThroughputBenchOptions& options);
+
+	std::string throughput_results_to_json(const std::vector<ThroughputBenchResult>& results);
+
+	// --bench-throughput [--sizes 3,5] [--payloads 64,1024] [--clients 1,16] [--batches 16,64]
+	//                    [--transport inproc|tcp|both] [--duration ms] [--out file.json]
+	//                    [--pin none|spread|both] [--cpus 0-7,16-23] [--heartbeat ms]
+	//                    [--trace file] (message trace of the last case, see RaftTrace.h)
+	int run_throughput_bench(int argc, char** argv);
+}
@@ -0,0 +1,202 @@
+#include "TraceReplay.h"
+#include "RaftConsensus.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <unordered_map>
+
+static uint64_t log_digest(const raft::RaftLog& log)
+{
+	uint64_t hash = 14695981039346656037ull;
+	auto mix = [&hash](const void* data, size_t size) {
+		for (size_t i = 0; i < size; ++i) {
+			hash = (hash ^ ((const unsigned char*)data)[i]) * 1099511628211ull;
+		}
+	};
+	for (int index = 1; index <= log.last_index(); ++index) {
+		const auto& entry = log.at(index);
+		mix(&entry.term, sizeof(entry.term));
+		mix(&entry.index, sizeof(entry.index));
+		mix(entry.command.data(), entry.command.size());
+	}
+	return hash;
+}
+
+void raft::TraceReplayer::settle(RaftNode* node)
+{
+	do {
+		node->_processor->dispatch_committed();
+		while (node->get_applied_index() < node->_last_dispatched) {
+			std::this_thread::yield();
+		}
+		// a full apply queue leaves the rest of the committed entries for the next round
+	} while (node->_last_dispatched < node->_inner_state.commit_index);
+}
+
+bool raft::TraceReplayer::replay(const Trace& trace, const std::string& out_path, TraceReplayResult& result)
+{
+	RaftConfig config;
+	config.max_append_entries = trace.config.max_append_entries;
+	config.max_inflight_appends = trace.config.max_inflight_appends;
+	config.max_apply_lag = trace.config.max_apply_lag;
+	config.election_timeout_min_ms = trace.config.election_timeout_min_ms;
+	config.election_timeout_max_ms = trace.config.election_timeout_max_ms;
+	config.heartbeat_interval_ms = trace.config.heartbeat_interval_ms;
+	config.max_append_bytes = (size_t)trace.config.max_append_bytes;
+	config.apply_queue_capacity = (size_t)trace.config.apply_queue_capacity;
+	config.vote_delay_ms = 0;
+	config.trace_path = out_path;
+
+	// nodes are never started, their threads stay parked and this thread drives the processors
+	RaftRouter router(config);
+	for (const auto& tag : trace.tags) {
+		router.add_node(new RaftNode(&router, tag));
+	}
+	router.begin_replay();
+	auto nodes = router.get_all_nodes();
+
+	// traces with batch records replay each inbox drain as the node processed it, older traces
+	// fall back to one message per process call
+	std::unordered_map<uint64_t, const TraceRecord*> by_offset;
+	bool batched = std::any_of(trace.records.begin(), trace.records.end(), [](const TraceRecord& record) {
+		return record.type == TraceBatch;
+	});
+	if (batched) {
+		for (const auto& record : trace.records) {
+			by_offset.emplace(record.offset, &record);
+		}
+	}
+	std::vector<RaftMessage> batch;
+
+	for (const auto& record : trace.records) {
+		if (record.target >= nodes.size()) {
+			result.skipped++;
+			continue;
+		}
+		if (!(record.flags & TraceDelivered)) {
+			result.undelivered++;
+			continue;
+		}
+
+		if (batched && record.type == TraceBatch) {
+			RaftNode* node = nodes[record.target];
+			router.set_replay_time(record.timestamp_ns);
+			size_t count = record.payload.size() / sizeof(uint64_t);
+			for (size_t i = 0; i < count; ++i) {
+				uint64_t offset;
+				memcpy(&offset, record.payload.data() + i * sizeof(offset), sizeof(offset));
+				auto it = by_offset.find(offset);
+				RaftMessage message = it == by_offset.end() ? nullptr : trace_message(*it->second);
+				if (!message) {
+					result.skipped++;
+					continue;
+				}
+				batch.push_back(std::move(message));
+			}
+			if (!batch.empty()) {
+				node->_processor->process_batch(batch);
+				result.replayed += batch.size();
+				batch.clear();
+			}
+			settle(node);
+			continue;
+		}
+		if (batched && record.type != TraceElectionTimeout) {
+			// replayed with the batch that drained it
+			continue;
+		}
+
+		RaftNode* node = nodes[record.target];
+		router.set_replay_time(record.timestamp_ns);
+		if (record.type == TraceElectionTimeout) {
+			node->start_election();
+		}
+		else {
+			RaftMessage message = trace_message(record);
+			if (!message) {
+				result.skipped++;
+				continue;
+			}
+			node->_processor->process(std::move(message));
+		}
+		settle(node);
+		result.replayed++;
+	}
+
+	for (auto node : nodes) {
+		result.states.push_back(node->get_state());
+		result.log_digests.push_back(log_digest(node->_log));
+	}
+	return true;
+}
+
+int raft::run_trace_tool(int argc, char** argv)
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage: --trace-export <trace> [--out file.json] | --trace-replay <trace> [--out file] [--check]\n");
+		return 1;
+	}
+
+	std::string mode = argv[0];
+	std::string path = argv[1];
+	std::string out_path;
+	bool check = false;
+	for (int i = 2; i < argc; ++i) {
+		if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+			out_path = argv[++i];
+		}
+		else if (strcmp(argv[i], "--check") == 0) {
+			check = true;
+		}
+	}
+
+	Trace trace;
+	if (!read_trace(path, trace)) {
+		fprintf(stderr, "cannot read trace %s\n", path.c_str());
+		return 1;
+	}
+
+	if (mode == "--trace-export") {
+		if (out_path.empty()) {
+			export_chrome_trace(trace, std::cout);
+		}
+		else {
+			std::ofstream out(out_path);
+			export_chrome_trace(trace, out);
+		}
+		return 0;
+	}
+
+	TraceReplayResult result;
+	TraceReplayer::replay(trace, out_path, result);
+	printf("replayed %zu records, %zu undelivered, %zu skipped\n", result.replayed, result.undelivered, result.skipped);
+	for (const auto& state : result.states) {
+		printf("%s : term (%d) voted(%d) log(%d/%d) commit(%d) elections(%d)\n",
+			state.tag.c_str(), state.term, state.last_voted_term, state.last_log_index, state.last_log_term, state.commit_index, state.elections_started);
+	}
+	if (!check) {
+		return 0;
+	}
+
+	// the second run records nothing, out_path already holds what the first one sent
+	TraceReplayResult again;
+	TraceReplayer::replay(trace, "", again);
+	int mismatches = 0;
+	for (size_t i = 0; i < result.states.size(); ++i) {
+		const auto& a = result.states[i];
+		const auto& b = again.states[i];
+		if (a.term != b.term || a.last_voted_term != b.last_voted_term || a.last_log_index != b.last_log_index
+			|| a.last_log_term != b.last_log_term || a.commit_index != b.commit_index || result.log_digests[i] != again.log_digests[i]) {
+			printf("%s : second replay differs, term (%d) log(%d/%d) commit(%d)\n",
+				b.tag.c_str(), b.term, b.last_log_index, b.last_log_term, b.commit_index);
+			mismatches++;
+		}
+	}
+	if (mismatches) {
+		return 1;
+	}
+	printf("second replay matches\n");
+	return 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "RaftTrace.h"
+
+#include <string>
+#include <vector>
+
+namespace raft {
+	struct TraceReplayResult {
+		size_t replayed = 0;
+		// records the router refused for the inbox budget. what a faulty link lost counts as sent
+		// and only ever goes missing from the receiver's batches
+		size_t undelivered = 0;
+		// records naming an unknown node or carrying a payload that no longer decodes
+		size_t skipped = 0;
+		std::vector<RaftStateNode> states;
+		// fnv-1a over every log entry (term, index, command) per node, in states order
+		std::vector<uint64_t> log_digests;
+	};
+
+	// feeds a recorded trace back through fresh nodes on the calling thread. each batch record is
+	// rebuilt from the messages it lists and handed to process_batch, so a node sees the same inbox
+	// drains, heartbeat collapsing and end of batch commit as in the recorded run, plus its election
+	// timeouts in between. traces without batch records replay one message per process call.
+	// the term, vote and log transitions repeat without any timers or network involved.
+	// how far each apply stage had got in the recorded run is not in the trace, so after every step
+	// the replay waits for the applier to catch up with what was dispatched. the applied_index of
+	// responses and the max_apply_lag check then see a drained apply stage and two replays of the
+	// same trace produce the same logs
+	class TraceReplayer {
+	private:
+		// dispatches what the node committed and waits until its apply thread has applied all of it
+		static void settle(RaftNode* node);
+
+	public:
+		// what the replayed nodes send is recorded into out_path (when set) instead of delivered
+		static bool replay(const Trace& trace, const std::string& out_path, TraceReplayResult& result);
+	};
+
+	// --trace-export <trace> [--out file.json]   chrome trace event json, stdout by default
+	// --trace-replay <trace> [--out file]        replays and prints each node's final state
+	//                [--check]                  replays twice, non-zero exit when the logs differ
+	int run_trace_tool(int argc, char** argv);
+}
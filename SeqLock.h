@@ -0,0 +1,79 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// single writer publishing slot. the writer never blocks, readers retry while a write is in
+// progress and always come back with a consistent copy. the payload lives in relaxed atomic
+// words so concurrent reads of a torn value are never a data race
+template <typename T>
+class SeqLock
+{
+private:
+	static_assert(std::is_trivially_copyable<T>::value, "SeqLock payload must be trivially copyable");
+
+	static constexpr size_t word_count = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+	alignas(64) std::atomic<uint32_t> _sequence;
+	std::atomic<uint64_t> _words[word_count];
+
+public:
+	SeqLock()
+		:
+		_sequence(0)
+	{
+		for (auto& word : _words) {
+			word.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	explicit SeqLock(const T& initial) : SeqLock()
+	{
+		store(initial);
+	}
+
+	SeqLock(const SeqLock&) = delete;
+	SeqLock& operator=(const SeqLock&) = delete;
+
+	// only ever called from the owning thread
+	void store(const T& value)
+	{
+		uint64_t raw[word_count] = {};
+		memcpy(raw, &value, sizeof(T));
+
+		const uint32_t sequence = _sequence.load(std::memory_order_relaxed);
+		_sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		for (size_t i = 0; i < word_count; ++i) {
+			_words[i].store(raw[i], std::memory_order_relaxed);
+		}
+
+		_sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	T load() const
+	{
+		uint64_t raw[word_count];
+		uint32_t before, after;
+		do {
+			before = _sequence.load(std::memory_order_acquire);
+			for (size_t i = 0; i < word_count; ++i) {
+				raw[i] = _words[i].load(std::memory_order_relaxed);
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+			after = _sequence.load(std::memory_order_relaxed);
+		} while ((before & 1) != 0 || before != after);
+
+		T value;
+		memcpy(&value, raw, sizeof(T));
+		return value;
+	}
+
+	// number of completed stores, lets a reader skip an unchanged slot
+	uint32_t version() const
+	{
+		return _sequence.load(std::memory_order_acquire) >> 1;
+	}
+};
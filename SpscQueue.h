@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// bounded lock-free ring buffer, exactly one producer thread and one consumer thread
+template <typename T>
+class SpscQueue
+{
+private:
+	static constexpr size_t cache_line = 64;
+
+	const size_t _mask;
+	std::unique_ptr<T[]> _slots;
+
+	alignas(cache_line) std::atomic<size_t> _head;	// next slot to pop, written by consumer
+	alignas(cache_line) size_t _cached_tail;		// consumer's last view of _tail
+
+	alignas(cache_line) std::atomic<size_t> _tail;	// next slot to push, written by producer
+	alignas(cache_line) size_t _cached_head;		// producer's last view of _head
+
+public:
+	explicit SpscQueue(size_t capacity)
+		:
+		_mask(round_up(capacity) - 1),
+		_slots(new T[_mask + 1]),
+		_head(0),
+		_cached_tail(0),
+		_tail(0),
+		_cached_head(0)
+	{}
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	// moves from value only when there is room
+	bool try_push(T&& value)
+	{
+		const size_t tail = _tail.load(std::memory_order_relaxed);
+		if (tail - _cached_head > _mask) {
+			_cached_head = _head.load(std::memory_order_acquire);
+			if (tail - _cached_head > _mask) {
+				return false;
+			}
+		}
+
+		_slots[tail & _mask] = std::move(value);
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool try_pop(T& value)
+	{
+		const size_t head = _head.load(std::memory_order_relaxed);
+		if (head == _cached_tail) {
+			_cached_tail = _tail.load(std::memory_order_acquire);
+			if (head == _cached_tail) {
+				return false;
+			}
+		}
+
+		value = std::move(_slots[head & _mask]);
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	size_t size() const
+	{
+		const size_t head = _head.load(std::memory_order_acquire);
+		return _tail.load(std::memory_order_acquire) - head;
+	}
+
+	bool empty() const
+	{
+		return size() == 0;
+	}
+
+	size_t capacity() const
+	{
+		return _mask + 1;
+	}
+
+private:
+	static size_t round_up(size_t n)
+	{
+		size_t capacity = 2;
+		while (capacity < n) {
+			capacity <<= 1;
+		}
+		return capacity;
+	}
+};
@@ -0,0 +1,281 @@
+#pragma once
+
+#include "doctest.h"
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+namespace tictactoe {
+	/*
+		non-owning views of the lines of a square board stored as rows, anything with board[row][column]
+		and size(), e.g. vector<vector<char>>.
+		a LineView is a start cell and a step, a LinesView is a range of line numbers: the rows 0..n-1,
+		the columns n..2n-1, then the main and the secondary diagonal. both are a pointer and a few ints
+		and iterate like containers, so all_of/any_of over them read the board in place and allocate
+		nothing. the board has to outlive its views
+	*/
+
+	template<typename Board>
+	class LineView {
+	public:
+		using value_type = std::decay_t<decltype(std::declval<const Board&>()[0][0])>;
+
+		// holds a copy of the view, it stays valid past a temporary view
+		class iterator {
+		private:
+			LineView _line;
+			int _index;
+
+		public:
+			using iterator_category = std::input_iterator_tag;
+			using value_type = typename LineView::value_type;
+			using difference_type = std::ptrdiff_t;
+			using pointer = const value_type*;
+			using reference = value_type;
+
+			iterator(const LineView& line, int index) : _line(line), _index(index) {}
+
+			value_type operator*() const {
+				return _line[_index];
+			}
+
+			iterator& operator++() {
+				++_index;
+				return *this;
+			}
+
+			iterator operator++(int) {
+				iterator before = *this;
+				++_index;
+				return before;
+			}
+
+			bool operator==(const iterator& other) const {
+				return _index == other._index;
+			}
+
+			bool operator!=(const iterator& other) const {
+				return _index != other._index;
+			}
+		};
+
+	private:
+		const Board* _board;
+		int _row;
+		int _column;
+		int _rowStep;
+		int _columnStep;
+		int _size;
+
+	public:
+		LineView(const Board& board, int row, int column, int rowStep, int columnStep)
+			: _board(&board), _row(row), _column(column), _rowStep(rowStep), _columnStep(columnStep), _size((int)board.size()) {}
+
+		size_t size() const {
+			return (size_t)_size;
+		}
+
+		value_type operator[](int index) const {
+			return (*_board)[_row + index * _rowStep][_column + index * _columnStep];
+		}
+
+		iterator begin() const {
+			return iterator(*this, 0);
+		}
+
+		iterator end() const {
+			return iterator(*this, _size);
+		}
+	};
+
+	template<typename Board>
+	class LinesView {
+	public:
+		using value_type = LineView<Board>;
+
+		class iterator {
+		private:
+			LinesView _lines;
+			int _number;
+
+		public:
+			using iterator_category = std::input_iterator_tag;
+			using value_type = LineView<Board>;
+			using difference_type = std::ptrdiff_t;
+			using pointer = const value_type*;
+			using reference = value_type;
+
+			iterator(const LinesView& lines, int number) : _lines(lines), _number(number) {}
+
+			value_type operator*() const {
+				return _lines.lineNumbered(_number);
+			}
+
+			iterator& operator++() {
+				++_number;
+				return *this;
+			}
+
+			iterator operator++(int) {
+				iterator before = *this;
+				++_number;
+				return before;
+			}
+
+			bool operator==(const iterator& other) const {
+				return _number == other._number;
+			}
+
+			bool operator!=(const iterator& other) const {
+				return _number != other._number;
+			}
+		};
+
+	private:
+		const Board* _board;
+		int _first;
+		int _last;
+
+		LineView<Board> lineNumbered(int number) const {
+			const int n = (int)_board->size();
+			if (number < n) {
+				return LineView<Board>(*_board, number, 0, 0, 1);
+			}
+			if (number < 2 * n) {
+				return LineView<Board>(*_board, 0, number - n, 1, 0);
+			}
+			if (number == 2 * n) {
+				return LineView<Board>(*_board, 0, 0, 1, 1);
+			}
+			return LineView<Board>(*_board, 0, n - 1, 1, -1);
+		}
+
+	public:
+		static int lineCount(const Board& board) {
+			return 2 * (int)board.size() + 2;
+		}
+
+		// lines first up to, not including, last
+		LinesView(const Board& board, int first, int last) : _board(&board), _first(first), _last(last) {}
+
+		const Board& board() const {
+			return *_board;
+		}
+
+		int first() const {
+			return _first;
+		}
+
+		int last() const {
+			return _last;
+		}
+
+		size_t size() const {
+			return (size_t)(_last - _first);
+		}
+
+		LineView<Board> operator[](int index) const {
+			return lineNumbered(_first + index);
+		}
+
+		iterator begin() const {
+			return iterator(*this, _first);
+		}
+
+		iterator end() const {
+			return iterator(*this, _last);
+		}
+
+		// copies the cells out, for callers that want to keep the lines past the board
+		operator std::vector<std::vector<typename LineView<Board>::value_type>>() const {
+			std::vector<std::vector<typename LineView<Board>::value_type>> lines;
+			lines.reserve(size());
+			for (const auto& line : *this) {
+				lines.emplace_back(line.begin(), line.end());
+			}
+			return lines;
+		}
+	};
+
+	template<typename Board>
+	LinesView<Board> rowsOf(const Board& board) {
+		return LinesView<Board>(board, 0, (int)board.size());
+	}
+
+	template<typename Board>
+	LinesView<Board> columnsOf(const Board& board) {
+		return LinesView<Board>(board, (int)board.size(), 2 * (int)board.size());
+	}
+
+	template<typename Board>
+	LinesView<Board> diagonalsOf(const Board& board) {
+		return LinesView<Board>(board, 2 * (int)board.size(), LinesView<Board>::lineCount(board));
+	}
+
+	// two neighbouring ranges of the same board as one, no copy. rows, columns and diagonals line up in that order
+	template<typename Board>
+	LinesView<Board> concatenateViews(const LinesView<Board>& first, const LinesView<Board>& second) {
+		assert(&first.board() == &second.board() && first.last() == second.first());
+		return LinesView<Board>(first.board(), first.first(), second.last());
+	}
+
+	template<typename Board, typename Token>
+	bool operator==(const std::vector<Token>& cells, const LineView<Board>& line) {
+		return cells.size() == line.size() && std::equal(cells.begin(), cells.end(), line.begin());
+	}
+
+	template<typename Board, typename Line>
+	bool operator==(const std::vector<Line>& lines, const LinesView<Board>& view) {
+		if (lines.size() != view.size()) {
+			return false;
+		}
+		for (size_t i = 0; i < lines.size(); ++i) {
+			if (!(lines[i] == view[(int)i])) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	TEST_SUITE("line views") {
+		TEST_CASE("views read the board in place") {
+			std::vector<std::vector<char>> board{
+				{'X', 'X', 'X'},
+				{' ', 'O', ' '},
+				{' ', ' ', 'O'}
+			};
+
+			auto all = concatenateViews(concatenateViews(rowsOf(board), columnsOf(board)), diagonalsOf(board));
+			CHECK_EQ(all.size(), 8u);
+			CHECK(std::vector<char>{ 'X', ' ', ' ' } == all[3]);
+			CHECK(std::vector<char>{ 'X', 'O', 'O' } == all[6]);
+			CHECK(std::vector<char>{ 'X', 'O', ' ' } == all[7]);
+
+			// no copy was taken, a change to the board shows through
+			board[2][0] = 'O';
+			CHECK_EQ(all[7][2], 'O');
+			CHECK_EQ(columnsOf(board)[0][2], 'O');
+			CHECK_EQ(std::count_if(rowsOf(board).begin(), rowsOf(board).end(), [](const auto& line) {
+				return std::all_of(line.begin(), line.end(), [](char token) { return token == 'X'; });
+			}), 1);
+		}
+
+		TEST_CASE("views work on larger boards") {
+			std::vector<std::vector<int>> board(4, std::vector<int>(4, 0));
+			for (int i = 0; i < 4; ++i) {
+				board[i][3 - i] = 1;
+			}
+			auto diagonals = diagonalsOf(board);
+			CHECK_EQ(diagonals.size(), 2u);
+			CHECK(std::all_of(diagonals[1].begin(), diagonals[1].end(), [](int cell) { return cell == 1; }));
+			CHECK_EQ(LinesView<std::vector<std::vector<int>>>::lineCount(board), 10);
+
+			std::vector<std::vector<int>> copied = columnsOf(board);
+			CHECK(copied == columnsOf(board));
+			board[0][0] = 7;
+			CHECK_EQ(copied[0][0], 0);
+		}
+	}
+}
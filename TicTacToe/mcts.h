@@ -0,0 +1,430 @@
+#pragma once
+
+#include "doctest.h"
+#include "mnk_board.h"
+#include "zobrist.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace tictactoe {
+	/*
+		monte carlo tree search over MnkBoard, for boards too big for Searcher.
+		a playout walks down the tree by UCT, expands the leaf it reaches, and plays random moves to
+		the end of the game. the result is added to every node on the way down.
+
+		tree parallel: every thread walks the same tree. node statistics are atomics, a node is
+		expanded by whichever thread wins a compare exchange on its state, and the children are
+		carved out of a shared pool with one fetch_add. a thread on its way down adds a virtual loss
+		to each node it passes, so the threads behind it spread over other branches until its
+		result is in.
+
+		each thread's random numbers come from the seed and the thread's index. with one thread and
+		a playout budget the whole search is deterministic; with more threads the order in which
+		they reach the shared nodes is up to the scheduler
+	*/
+
+	struct MctsLimits {
+		// total over all threads
+		int playouts = 10000;
+		// stops early past this, 0 runs the whole budget
+		int timeBudgetMs = 0;
+		int threads = 1;
+		uint64_t seed = 1;
+		double exploration = 1.4;
+		// as in SearchLimits, -1 picks 2 on boards over 36 cells and every empty cell otherwise.
+		// only the tree is limited, the playouts use every empty cell
+		int candidateRadius = -1;
+	};
+
+	struct MctsResult {
+		// the most visited move, -1 when the game is already over
+		int bestMove;
+		int playouts;
+		int nodes;
+		double seconds;
+		double playoutsPerSecond;
+		// of bestMove for the side to move, a draw counts half
+		double winRate;
+	};
+
+	template<typename Board>
+	class MonteCarloSearcher {
+	private:
+		static constexpr int cells = Board::cells;
+		static constexpr int checkEvery = 64;
+		static constexpr uint32_t none = UINT32_MAX;
+
+		using Clock = std::chrono::steady_clock;
+
+		enum NodeState : uint8_t {
+			Leaf,
+			Expanding,
+			Expanded,
+			// the pool ran out, playouts start here from now on
+			Frozen
+		};
+
+		struct Node {
+			// 2 per win and 1 per draw, for the player who made move
+			std::atomic<uint32_t> reward;
+			std::atomic<uint32_t> visits;
+			std::atomic<uint32_t> virtualLoss;
+			std::atomic<uint8_t> state;
+			// written before state becomes Expanded, read after
+			uint32_t firstChild;
+			uint16_t childCount;
+			int16_t move;
+
+			void reset(int cell) {
+				reward.store(0, std::memory_order_relaxed);
+				visits.store(0, std::memory_order_relaxed);
+				virtualLoss.store(0, std::memory_order_relaxed);
+				state.store(Leaf, std::memory_order_relaxed);
+				firstChild = none;
+				childCount = 0;
+				move = (int16_t)cell;
+			}
+		};
+
+		std::unique_ptr<Node[]> _nodes;
+		size_t _capacity;
+		std::atomic<uint32_t> _used;
+		std::atomic<int> _started;
+		std::atomic<bool> _stopped;
+		Board _root;
+		MctsLimits _limits;
+		int _radius;
+		Clock::time_point _deadline;
+
+		// false when the pool is full, the node is frozen then
+		bool expand(Node& node, const Board& board) {
+			std::array<int16_t, cells> moves;
+			int count = 0;
+			for (int cell = 0; cell < cells; ++cell) {
+				if (isCandidate(board, cell, _radius)) {
+					moves[count++] = (int16_t)cell;
+				}
+			}
+
+			const uint32_t first = _used.fetch_add((uint32_t)count, std::memory_order_relaxed);
+			if (count == 0 || first + count > _capacity) {
+				node.state.store(Frozen, std::memory_order_release);
+				return false;
+			}
+			for (int i = 0; i < count; ++i) {
+				_nodes[first + i].reset(moves[i]);
+			}
+			node.firstChild = first;
+			node.childCount = (uint16_t)count;
+			node.state.store(Expanded, std::memory_order_release);
+			return true;
+		}
+
+		// UCT with the virtual losses counted as visits that won nothing. unvisited children go first, in order
+		uint32_t selectChild(const Node& node) const {
+			const Node* children = &_nodes[node.firstChild];
+			const double parentVisits = (double)node.visits.load(std::memory_order_relaxed) + node.virtualLoss.load(std::memory_order_relaxed);
+			const double logParent = std::log(std::max(parentVisits, 1.0));
+			uint32_t best = node.firstChild;
+			double bestValue = -1.0;
+			for (int i = 0; i < node.childCount; ++i) {
+				const Node& child = children[i];
+				const uint32_t visits = child.visits.load(std::memory_order_relaxed) + child.virtualLoss.load(std::memory_order_relaxed);
+				if (visits == 0) {
+					return node.firstChild + i;
+				}
+				const double value = child.reward.load(std::memory_order_relaxed) / (2.0 * visits)
+					+ _limits.exploration * std::sqrt(logParent / visits);
+				if (value > bestValue) {
+					bestValue = value;
+					best = node.firstChild + i;
+				}
+			}
+			return best;
+		}
+
+		// random moves to the end of the game, the empty cells kept in a list and swap removed
+		static GameStatus playout(Board& board, uint64_t& random) {
+			if (board.isOver()) {
+				return board.status();
+			}
+			std::array<int16_t, cells> empties;
+			int count = 0;
+			for (int cell = 0; cell < cells; ++cell) {
+				if (board.isEmpty(cell)) {
+					empties[count++] = (int16_t)cell;
+				}
+			}
+			while (!board.isOver()) {
+				const int pick = (int)((splitMix64(random) >> 32) % (uint32_t)count);
+				board.play(empties[pick]);
+				empties[pick] = empties[--count];
+			}
+			return board.status();
+		}
+
+		void runPlayout(std::vector<uint32_t>& path, uint64_t& random) {
+			Board board = _root;
+			path.clear();
+			uint32_t index = 0;
+			path.push_back(index);
+			_nodes[index].virtualLoss.fetch_add(1, std::memory_order_relaxed);
+
+			while (!board.isOver()) {
+				Node& node = _nodes[index];
+				uint8_t state = node.state.load(std::memory_order_acquire);
+				if (state == Leaf) {
+					uint8_t expected = Leaf;
+					if (!node.state.compare_exchange_strong(expected, Expanding, std::memory_order_acq_rel)) {
+						// someone else is expanding it, play out from here
+						break;
+					}
+					if (!expand(node, board)) {
+						break;
+					}
+					state = Expanded;
+				}
+				if (state != Expanded) {
+					break;
+				}
+
+				index = selectChild(node);
+				board.play(_nodes[index].move);
+				path.push_back(index);
+				_nodes[index].virtualLoss.fetch_add(1, std::memory_order_relaxed);
+				// a fresh node gets its first result from a playout before it grows children
+				if (_nodes[index].visits.load(std::memory_order_relaxed) == 0) {
+					break;
+				}
+			}
+
+			const GameStatus status = playout(board, random);
+			// the root's move was made by the side not to move at the root, and the movers alternate from there
+			Mark mover = opponentOf(_root.sideToMove());
+			for (uint32_t node : path) {
+				const uint32_t reward = status == GameStatus::Draw ? 1
+					: (status == GameStatus::XWins) == (mover == Mark::X) ? 2 : 0;
+				_nodes[node].reward.fetch_add(reward, std::memory_order_relaxed);
+				_nodes[node].visits.fetch_add(1, std::memory_order_relaxed);
+				_nodes[node].virtualLoss.fetch_sub(1, std::memory_order_relaxed);
+				mover = opponentOf(mover);
+			}
+		}
+
+		void work(int thread) {
+			uint64_t random = _limits.seed;
+			for (int i = 0; i <= thread; ++i) {
+				splitMix64(random);
+			}
+			std::vector<uint32_t> path;
+			path.reserve(cells + 1);
+			int done = 0;
+			while (!_stopped.load(std::memory_order_relaxed) && _started.fetch_add(1, std::memory_order_relaxed) < _limits.playouts) {
+				runPlayout(path, random);
+				if (_limits.timeBudgetMs > 0 && (++done % checkEvery) == 0 && Clock::now() >= _deadline) {
+					_stopped.store(true, std::memory_order_relaxed);
+				}
+			}
+		}
+
+	public:
+		// maxNodes bounds the tree, a search that fills it keeps playing out from the leaves it has
+		explicit MonteCarloSearcher(size_t maxNodes = 1 << 20) : _nodes(new Node[maxNodes]), _capacity(maxNodes), _used(0), _started(0), _stopped(false), _radius(0) {}
+
+		MonteCarloSearcher(const MonteCarloSearcher&) = delete;
+		MonteCarloSearcher& operator=(const MonteCarloSearcher&) = delete;
+
+		// not safe to call from more than one thread at a time, it spawns its own
+		MctsResult search(const Board& board, const MctsLimits& limits = MctsLimits()) {
+			const auto started = Clock::now();
+			MctsResult result{ -1, 0, 0, 0.0, 0.0, 0.0 };
+			if (board.isOver()) {
+				return result;
+			}
+
+			_root = board;
+			_limits = limits;
+			_radius = effectiveCandidateRadius<Board>(limits.candidateRadius);
+			_deadline = started + std::chrono::milliseconds(limits.timeBudgetMs);
+			_started.store(0, std::memory_order_relaxed);
+			_stopped.store(false, std::memory_order_relaxed);
+			_nodes[0].reset(-1);
+			_used.store(1, std::memory_order_relaxed);
+
+			std::vector<std::thread> helpers;
+			for (int thread = 1; thread < limits.threads; ++thread) {
+				helpers.emplace_back(&MonteCarloSearcher::work, this, thread);
+			}
+			work(0);
+			for (auto& helper : helpers) {
+				helper.join();
+			}
+
+			const Node& root = _nodes[0];
+			if (root.state.load(std::memory_order_acquire) == Expanded) {
+				const Node* best = nullptr;
+				for (int i = 0; i < root.childCount; ++i) {
+					const Node& child = _nodes[root.firstChild + i];
+					if (!best || child.visits > best->visits || (child.visits == best->visits && child.reward > best->reward)) {
+						best = &child;
+					}
+				}
+				result.bestMove = best->move;
+				result.winRate = best->visits > 0 ? best->reward / (2.0 * best->visits) : 0.0;
+			}
+			result.playouts = (int)root.visits.load(std::memory_order_relaxed);
+			result.nodes = (int)std::min<size_t>(_used.load(std::memory_order_relaxed), _capacity);
+			result.seconds = std::chrono::duration<double>(Clock::now() - started).count();
+			result.playoutsPerSecond = result.seconds > 0.0 ? result.playouts / result.seconds : 0.0;
+			return result;
+		}
+	};
+
+	template<typename Board>
+	MctsResult mctsBestMove(const Board& board, const MctsLimits& limits = MctsLimits()) {
+		MonteCarloSearcher<Board> searcher;
+		return searcher.search(board, limits);
+	}
+
+	TEST_SUITE("monte carlo tree search") {
+		TEST_CASE("a lost position reads as lost") {
+			MctsLimits limits;
+			limits.playouts = 4000;
+
+			TicTacToeBoard board;
+			// X: (0,0) (0,1) (1,0), O: (1,1) (2,2). X threatens (0,2) and (2,0), O to move blocks one of them
+			board.play(0, 0);
+			board.play(1, 1);
+			board.play(0, 1);
+			board.play(2, 2);
+			board.play(1, 0);
+			auto lost = mctsBestMove(board, limits);
+			CHECK_NE(lost.bestMove, -1);
+			CHECK_LT(lost.winRate, 0.25);
+
+			// one move on, X finishes a line whichever threat is left
+			REQUIRE(board.play(lost.bestMove));
+			auto won = mctsBestMove(board, limits);
+			CHECK_EQ(won.winRate, 1.0);
+		}
+
+		TEST_CASE("the tree opens in the centre and stays near the stones") {
+			MctsLimits limits;
+			limits.playouts = 500;
+
+			// the default radius on a 225 cell board leaves only the centre at the root
+			auto opening = mctsBestMove(GomokuBoard(), limits);
+			CHECK_EQ(opening.bestMove, GomokuBoard::cellIndex(7, 7));
+
+			GomokuBoard board;
+			board.play(7, 7);
+			board.play(0, 0);
+			limits.candidateRadius = 1;
+			MonteCarloSearcher<GomokuBoard> searcher;
+			auto result = searcher.search(board, limits);
+			const int row = result.bestMove / GomokuBoard::columns;
+			const int column = result.bestMove % GomokuBoard::columns;
+			const bool nearCentre = std::abs(row - 7) <= 1 && std::abs(column - 7) <= 1;
+			const bool nearCorner = row <= 1 && column <= 1;
+			CHECK((nearCentre || nearCorner));
+		}
+
+		TEST_CASE("one thread with a fixed seed repeats itself") {
+			MctsLimits limits;
+			limits.playouts = 3000;
+			limits.seed = 42;
+			MnkBoard<6, 6, 4> board;
+			board.play(2, 2);
+			board.play(3, 3);
+
+			MonteCarloSearcher<MnkBoard<6, 6, 4>> searcher;
+			auto first = searcher.search(board, limits);
+			auto second = searcher.search(board, limits);
+			CHECK_EQ(first.playouts, limits.playouts);
+			CHECK_EQ(first.bestMove, second.bestMove);
+			CHECK_EQ(first.winRate, second.winRate);
+			CHECK_EQ(first.nodes, second.nodes);
+		}
+
+		TEST_CASE("threads share the budget and the tree") {
+			MctsLimits limits;
+			limits.playouts = 8000;
+			limits.threads = 4;
+
+			GomokuBoard board;
+			// X has an open four on row 7, columns 3 to 6, O is scattered; X to move
+			const int xs[] = { 3, 4, 5, 6 };
+			const int os[] = { 0, 14, 100, 200 };
+			for (int i = 0; i < 4; ++i) {
+				REQUIRE(board.play(7, xs[i]));
+				REQUIRE(board.play(os[i]));
+			}
+			auto result = mctsBestMove(board, limits);
+			CHECK_EQ(result.playouts, limits.playouts);
+			const bool completes = result.bestMove == GomokuBoard::cellIndex(7, 2) || result.bestMove == GomokuBoard::cellIndex(7, 7);
+			CHECK(completes);
+			CHECK_EQ(result.winRate, 1.0);
+		}
+
+		TEST_CASE("a full pool stops growing the tree, not the search") {
+			MctsLimits limits;
+			limits.playouts = 2000;
+			MonteCarloSearcher<MnkBoard<5, 5, 4>> searcher(64);
+			auto result = searcher.search(MnkBoard<5, 5, 4>(), limits);
+			CHECK_EQ(result.playouts, limits.playouts);
+			CHECK_LE(result.nodes, 64);
+			CHECK_NE(result.bestMove, -1);
+		}
+
+		TEST_CASE("gomoku playouts per second") {
+			GomokuBoard board;
+			board.play(7, 7);
+			board.play(7, 8);
+
+			const int threads = std::max(2, (int)std::thread::hardware_concurrency());
+			MctsLimits limits;
+			limits.playouts = 20000;
+			auto single = mctsBestMove(board, limits);
+			limits.threads = threads;
+			auto parallel = mctsBestMove(board, limits);
+			CHECK_EQ(parallel.playouts, limits.playouts);
+			MESSAGE("gomoku mcts: " << (long long)single.playoutsPerSecond << " playouts/sec on 1 thread, "
+				<< (long long)parallel.playoutsPerSecond << " on " << threads);
+		}
+
+		TEST_CASE("win rate grows with the budget") {
+			// each budget against a 16 playout opponent on 5x5 four in a row, taking turns to start
+			using Board = MnkBoard<5, 5, 4>;
+			MonteCarloSearcher<Board> searcher;
+			const int games = 20;
+			const int budgets[] = { 16, 128, 1024 };
+			double scores[3] = {};
+			for (int b = 0; b < 3; ++b) {
+				double score = 0.0;
+				for (int game = 0; game < games; ++game) {
+					Board board;
+					const Mark player = (game & 1) ? Mark::O : Mark::X;
+					while (!board.isOver()) {
+						MctsLimits limits;
+						limits.seed = (uint64_t)(game * 1000 + board.moveCount() + 1);
+						limits.playouts = board.sideToMove() == player ? budgets[b] : 16;
+						REQUIRE(board.play(searcher.search(board, limits).bestMove));
+					}
+					const GameStatus won = player == Mark::X ? GameStatus::XWins : GameStatus::OWins;
+					score += board.status() == won ? 1.0 : board.status() == GameStatus::Draw ? 0.5 : 0.0;
+				}
+				scores[b] = score / games;
+				MESSAGE("mcts with " << budgets[b] << " playouts scores " << scores[b] << " against 16");
+			}
+			CHECK_GT(scores[2], scores[0]);
+			CHECK_GT(scores[2], 0.5);
+		}
+	}
+}
@@ -0,0 +1,331 @@
+#pragma once
+
+#include "doctest.h"
+#include "win_lines.h"
+#include "zobrist.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <random>
+
+namespace tictactoe {
+	/*
+		m,n,k-game: Rows x Columns board, players alternate, X first, K or more in a row wins.
+		3x3x3 is tictactoe, 15x15x5 is free style gomoku
+	*/
+
+	enum class Mark : uint8_t {
+		Empty,
+		X,
+		O
+	};
+
+	enum class GameStatus : uint8_t {
+		InProgress,
+		XWins,
+		OWins,
+		Draw
+	};
+
+	static inline Mark opponentOf(Mark mark) {
+		return mark == Mark::X ? Mark::O : Mark::X;
+	}
+
+	template<int Rows, int Columns, int K>
+	class MnkBoard {
+	public:
+		using Lines = WinLineTable<Rows, Columns, K>;
+		using Mask = typename Lines::Mask;
+		using Symmetries = BoardSymmetries<Rows, Columns>;
+
+		static constexpr int rows = Rows;
+		static constexpr int columns = Columns;
+		static constexpr int length = K;
+		static constexpr int cells = Rows * Columns;
+
+	private:
+		Mask _x;
+		Mask _o;
+		std::array<int16_t, cells> _history;
+		int _moveCount;
+		GameStatus _status;
+		SymmetricHash<Rows, Columns> _hash;
+
+		int runFrom(int row, int column, int rowStep, int columnStep, const Mask& taken) const {
+			int run = 0;
+			for (int i = 1; i < K; ++i) {
+				const int r = row + i * rowStep;
+				const int c = column + i * columnStep;
+				if (r < 0 || r >= Rows || c < 0 || c >= Columns || !taken.test(Lines::cellIndex(r, c))) {
+					break;
+				}
+				++run;
+			}
+			return run;
+		}
+
+		// walks out from the new stone in the four directions, at most 2 * (K - 1) cells each
+		bool completesLine(int cell, const Mask& taken) const {
+			const int row = cell / Columns;
+			const int column = cell % Columns;
+			const int directions[4][2] = { {0, 1}, {1, 0}, {1, 1}, {1, -1} };
+			for (const auto& direction : directions) {
+				const int run = 1
+					+ runFrom(row, column, direction[0], direction[1], taken)
+					+ runFrom(row, column, -direction[0], -direction[1], taken);
+				if (run >= K) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+	public:
+		MnkBoard() : _x{}, _o{}, _history{}, _moveCount(0), _status(GameStatus::InProgress) {}
+
+		static constexpr int cellIndex(int row, int column) {
+			return Lines::cellIndex(row, column);
+		}
+
+		Mark at(int cell) const {
+			return _x.test(cell) ? Mark::X : _o.test(cell) ? Mark::O : Mark::Empty;
+		}
+
+		Mark at(int row, int column) const {
+			return at(cellIndex(row, column));
+		}
+
+		bool isEmpty(int cell) const {
+			return !_x.test(cell) && !_o.test(cell);
+		}
+
+		const Mask& stonesOf(Mark mark) const {
+			return mark == Mark::X ? _x : _o;
+		}
+
+		Mark sideToMove() const {
+			return (_moveCount & 1) ? Mark::O : Mark::X;
+		}
+
+		int moveCount() const {
+			return _moveCount;
+		}
+
+		// -1 before the first move
+		int lastMove() const {
+			return _moveCount > 0 ? _history[_moveCount - 1] : -1;
+		}
+
+		GameStatus status() const {
+			return _status;
+		}
+
+		bool isOver() const {
+			return _status != GameStatus::InProgress;
+		}
+
+		// false for an occupied cell or a finished game. only the lines through cell are checked, O(K)
+		bool play(int cell) {
+			if (isOver() || cell < 0 || cell >= cells || !isEmpty(cell)) {
+				return false;
+			}
+
+			const Mark mover = sideToMove();
+			Mask& taken = mover == Mark::X ? _x : _o;
+			taken.set(cell);
+			_hash.toggle(cell, mover == Mark::X ? 0 : 1);
+			_history[_moveCount++] = (int16_t)cell;
+
+			if (completesLine(cell, taken)) {
+				_status = mover == Mark::X ? GameStatus::XWins : GameStatus::OWins;
+			}
+			else if (_moveCount == cells) {
+				_status = GameStatus::Draw;
+			}
+			return true;
+		}
+
+		bool play(int row, int column) {
+			return play(cellIndex(row, column));
+		}
+
+		// takes back the last move, a finished game is in progress again
+		void undo() {
+			if (_moveCount == 0) {
+				return;
+			}
+			const int cell = _history[--_moveCount];
+			_hash.toggle(cell, _x.test(cell) ? 0 : 1);
+			_x.clear(cell);
+			_o.clear(cell);
+			_status = GameStatus::InProgress;
+		}
+
+		// zobrist hash of the stones, updated with every play and undo
+		uint64_t hash() const {
+			return _hash.hash();
+		}
+
+		// the same for every rotation and mirror of the position
+		uint64_t canonicalHash() const {
+			return _hash.canonicalHash();
+		}
+
+		// maps this board's cells onto the canonical orientation, see BoardSymmetries::map
+		int canonicalSymmetry() const {
+			return _hash.canonicalSymmetry();
+		}
+
+		// the status recomputed from every line, what play() keeps up to date incrementally
+		GameStatus rescan() const {
+			if (Lines::anyLineFilled(_x)) {
+				return GameStatus::XWins;
+			}
+			if (Lines::anyLineFilled(_o)) {
+				return GameStatus::OWins;
+			}
+			return _moveCount == cells ? GameStatus::Draw : GameStatus::InProgress;
+		}
+	};
+
+	using TicTacToeBoard = MnkBoard<3, 3, 3>;
+	using GomokuBoard = MnkBoard<15, 15, 5>;
+
+	// the candidateRadius of the search limits, -1 picks 2 on boards over 36 cells and 0 otherwise
+	template<typename Board>
+	int effectiveCandidateRadius(int requested) {
+		return requested >= 0 ? requested : (Board::cells > 36 ? 2 : 0);
+	}
+
+	// the moves the searchers look at: at radius 0 every empty cell, otherwise the empty cells
+	// within radius (chebyshev) of a stone, and only the centre on an empty board
+	template<typename Board>
+	bool isCandidate(const Board& board, int cell, int radius) {
+		if (!board.isEmpty(cell)) {
+			return false;
+		}
+		if (radius == 0) {
+			return true;
+		}
+		if (board.moveCount() == 0) {
+			return cell == Board::cellIndex(Board::rows / 2, Board::columns / 2);
+		}
+		const int row = cell / Board::columns;
+		const int column = cell % Board::columns;
+		for (int r = std::max(0, row - radius); r <= std::min(Board::rows - 1, row + radius); ++r) {
+			for (int c = std::max(0, column - radius); c <= std::min(Board::columns - 1, column + radius); ++c) {
+				if (!board.isEmpty(Board::cellIndex(r, c))) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	TEST_SUITE("mnk board") {
+		TEST_CASE("3x3 alternates and wins on a row") {
+			TicTacToeBoard board;
+			CHECK_EQ(board.sideToMove(), Mark::X);
+			CHECK(board.play(0, 0));
+			CHECK_EQ(board.sideToMove(), Mark::O);
+			CHECK(!board.play(0, 0));
+			CHECK(board.play(1, 0));
+			CHECK(board.play(0, 1));
+			CHECK(board.play(1, 1));
+			CHECK_EQ(board.status(), GameStatus::InProgress);
+			CHECK(board.play(0, 2));
+			CHECK_EQ(board.status(), GameStatus::XWins);
+			CHECK(!board.play(2, 2));
+
+			board.undo();
+			CHECK_EQ(board.status(), GameStatus::InProgress);
+			CHECK_EQ(board.at(0, 2), Mark::Empty);
+			CHECK_EQ(board.lastMove(), TicTacToeBoard::cellIndex(1, 1));
+		}
+
+		TEST_CASE("candidates keep to the radius") {
+			GomokuBoard board;
+			CHECK(isCandidate(board, GomokuBoard::cellIndex(7, 7), 2));
+			CHECK(!isCandidate(board, GomokuBoard::cellIndex(7, 8), 2));
+			CHECK(isCandidate(board, GomokuBoard::cellIndex(0, 0), 0));
+
+			board.play(7, 7);
+			CHECK(!isCandidate(board, GomokuBoard::cellIndex(7, 7), 2));
+			CHECK(isCandidate(board, GomokuBoard::cellIndex(9, 5), 2));
+			CHECK(!isCandidate(board, GomokuBoard::cellIndex(10, 7), 2));
+
+			CHECK_EQ(effectiveCandidateRadius<GomokuBoard>(-1), 2);
+			CHECK_EQ(effectiveCandidateRadius<TicTacToeBoard>(-1), 0);
+			CHECK_EQ(effectiveCandidateRadius<GomokuBoard>(1), 1);
+		}
+
+		TEST_CASE("hash follows play and undo") {
+			TicTacToeBoard board;
+			const uint64_t empty = board.hash();
+			board.play(0, 0);
+			board.play(1, 1);
+			const uint64_t twoMoves = board.hash();
+			board.play(2, 2);
+			CHECK_NE(board.hash(), twoMoves);
+			board.undo();
+			CHECK_EQ(board.hash(), twoMoves);
+			board.undo();
+			board.undo();
+			CHECK_EQ(board.hash(), empty);
+
+			// the same two stones mirrored
+			TicTacToeBoard mirrored;
+			mirrored.play(0, 2);
+			mirrored.play(1, 1);
+			board.play(0, 0);
+			board.play(1, 1);
+			CHECK_NE(mirrored.hash(), board.hash());
+			CHECK_EQ(mirrored.canonicalHash(), board.canonicalHash());
+		}
+
+		TEST_CASE("3x3 draw") {
+			TicTacToeBoard board;
+			// XOX / OOX / XXO
+			const int moves[9][2] = { {0, 0}, {0, 1}, {0, 2}, {1, 0}, {1, 2}, {1, 1}, {2, 0}, {2, 2}, {2, 1} };
+			for (const auto& move : moves) {
+				REQUIRE(board.play(move[0], move[1]));
+			}
+			CHECK_EQ(board.status(), GameStatus::Draw);
+		}
+
+		TEST_CASE("an overline wins on gomoku") {
+			GomokuBoard board;
+			const int xs[] = { 0, 1, 2, 4, 5, 3 };
+			for (int column : xs) {
+				REQUIRE(board.play(7, column));
+				if (board.isOver()) {
+					break;
+				}
+				REQUIRE(board.play(0, column + 8));
+			}
+			CHECK_EQ(board.status(), GameStatus::XWins);
+		}
+
+		TEST_CASE("incremental status matches a full rescan") {
+			std::mt19937 rng(7);
+			auto playRandomGames = [&rng](auto board, int games) {
+				for (int game = 0; game < games; ++game) {
+					while (board.moveCount() > 0) {
+						board.undo();
+					}
+					while (!board.isOver()) {
+						int cell = (int)(rng() % decltype(board)::cells);
+						if (board.play(cell)) {
+							REQUIRE_EQ(board.status(), board.rescan());
+						}
+					}
+				}
+			};
+
+			playRandomGames(TicTacToeBoard(), 200);
+			playRandomGames(MnkBoard<4, 4, 3>(), 100);
+			playRandomGames(MnkBoard<6, 7, 4>(), 50);
+			playRandomGames(GomokuBoard(), 10);
+		}
+	}
+}
@@ -4,9 +4,27 @@
 #include "doctest.h"
 #include <vector>
 #include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <functional>
 #include <numeric>
 #include <optional>
+#include <tuple>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "win_lines.h"
+#include "mnk_board.h"
+#include "zobrist.h"
+#include "transposition.h"
+#include "search.h"
+#include "tablebase.h"
+#include "mcts.h"
+#include "line_views.h"
 
 using namespace std;
 using namespace std::placeholders;
@@ -292,35 +310,28 @@ namespace tictactoe {
 
 		using Lines = vector<Line>;
 
-		auto allLines = [](auto board) {
-			auto range = toRange(board);
-			return transformAll<Lines>(range, [board](auto index) {
-				return line(board, index);
-			});
+		// views over the board, see line_views.h. nothing is copied, so the board must outlive them
+		auto allLines = [](const auto& board) {
+			return rowsOf(board);
 		};
 
-		auto allColumns = [](auto board) {
-			auto range = toRange(board);
-			return transformAll<Lines>(range, [board](auto index) {
-				return column(board, index);
-			});
+		auto allColumns = [](const auto& board) {
+			return columnsOf(board);
 		};
 
-		auto allDiagonals = [](auto board) -> Lines {
-			return { mainDiagonal(board), secondaryDiagonal(board) };
+		auto allDiagonals = [](const auto& board) {
+			return diagonalsOf(board);
 		};
 
-		auto concatenate = [](auto first, const auto second) {
-			auto result(first);
-			result.insert(result.end(), std::make_move_iterator(second.begin()), std::make_move_iterator(second.end()));
-			return result;
+		auto concatenate = [](const auto& first, const auto& second) {
+			return concatenateViews(first, second);
 		};
 
-		auto concatenate3 = [](auto first, auto const second, auto const third) {
+		auto concatenate3 = [](const auto& first, const auto& second, const auto& third) {
 			return concatenate(concatenate(first, second), third);
 		};
 
-		auto allLinesColumnsAndDiagonals = [](const auto board) {
+		auto allLinesColumnsAndDiagonals = [](const auto& board) {
 			return concatenate3(allLines(board), allColumns(board), allDiagonals(board));
 		};
 
@@ -390,8 +401,8 @@ namespace tictactoe {
 			CHECK_EQ(" XO", lineToString(line));
 		}
 
-		auto boardToLinesString = [](const auto board) {
-			return transformAll<vector<string>>(board, lineToString);
+		auto boardToLinesString = [](const auto& board) {
+			return transformAll<vector<string>>(allLines(board), lineToString);
 		};
 
 		TEST_CASE("board to string") {
@@ -431,11 +442,15 @@ namespace tictactoe {
 			return accumulate(source.begin(), source.end(), typename decltype(source)::value_type(), lambda);
 		};
 
-		auto boardToString = [](const auto board) {
-			auto linesAsString = boardToLinesString(board);
-			return accumulateAll(linesAsString, [](string current, string lineAsString) {
-				return current + lineAsString + "\n";
-			});
+		// straight into one string, no string per line
+		auto boardToString = [](const auto& board) {
+			string result;
+			result.reserve(board.size() * (board.size() + 1));
+			for (const auto& line : allLines(board)) {
+				result.append(line.begin(), line.end());
+				result += '\n';
+			}
+			return result;
 		};
 
 		TEST_CASE("board to lines string") {
@@ -628,18 +643,12 @@ namespace tictactoe {
 			return range;
 		};
 
-		auto allLines = [](auto board) {
-			auto range = toRange(board);
-			return transformAll<Lines>(range, [board](auto index) {
-				return line(board, index);
-				});
+		auto allLines = [](const auto& board) {
+			return rowsOf(board);
 		};
 
-		auto allColumns = [](auto board) {
-			auto range = toRange(board);
-			return transformAll<Lines>(range, [board](auto index) {
-				return column(board, index);
-				});
+		auto allColumns = [](const auto& board) {
+			return columnsOf(board);
 		};
 
 		auto mainDiagonalCoordinates = [](const auto board) {
@@ -673,21 +682,20 @@ namespace tictactoe {
 			return projectCoordinates(board, secondaryDiagonalCoordinates(board));
 		};
 
-		auto allDiagonals = [](auto board) -> Lines {
-			return { mainDiagonal(board), secondaryDiagonal(board) };
+		auto allDiagonals = [](const auto& board) {
+			return diagonalsOf(board);
 		};
 
-		auto concatenate = [](auto first, const auto second) {
-			auto result(first);
-			result.insert(result.end(), std::make_move_iterator(second.begin()), std::make_move_iterator(second.end()));
-			return result;
+		auto concatenate = [](const auto& first, const auto& second) {
+			return concatenateViews(first, second);
 		};
 
-		auto concatenate3 = [](auto first, auto const second, auto const third) {
+		auto concatenate3 = [](const auto& first, const auto& second, const auto& third) {
 			return concatenate(concatenate(first, second), third);
 		};
 
-		auto allLinesColumnsAndDiagonals = [](const auto board) {
+		// a view of all 8 lines, tokenWins and friends walk it without copying a cell
+		auto allLinesColumnsAndDiagonals = [](const auto& board) {
 			return concatenate3(allLines(board), allColumns(board), allDiagonals(board));
 		};
 
@@ -781,6 +789,10 @@ namespace tictactoe {
 			
 			CBoard(const vector<CLine>& initial) : _board(initial) {}
 
+			Token at(int row, int column) const {
+				return _board[row][column];
+			}
+
 			bool anyLineFilledWith(const Token& token) const {
 				for (int i = 0; i < 3; ++i) {
 					if (_board[i][0] == token && _board[i][1] == token && _board[i][2] == token) {
@@ -816,7 +828,7 @@ namespace tictactoe {
 				}
 
 				for (int i = 0; i < 3; ++i) {
-					if (_board[i][3 - i] != token) {
+					if (_board[i][2 - i] != token) {
 						return false;
 					}
 				}
@@ -835,6 +847,91 @@ namespace tictactoe {
 			}
 		};
 
+		// X and O packed into two 9 bit masks, bit (row * 3 + column). every check is an AND and a compare
+		// against a precomputed line mask, and the board is a value type, no allocation
+		class BitBoard {
+		private:
+			uint16_t _x;
+			uint16_t _o;
+
+			static constexpr uint16_t lineMasks[3] = { 0007, 0070, 0700 };
+			static constexpr uint16_t columnMasks[3] = { 0111, 0222, 0444 };
+			static constexpr uint16_t diagonalMasks[2] = { 0421, 0124 };
+			static constexpr uint16_t fullMask = 0777;
+
+			static constexpr uint16_t bitAt(int row, int column) {
+				return (uint16_t)(1 << (row * 3 + column));
+			}
+
+			static bool anyMaskFilled(const uint16_t* masks, int count, uint16_t taken) {
+				for (int i = 0; i < count; ++i) {
+					if ((taken & masks[i]) == masks[i]) {
+						return true;
+					}
+				}
+				return false;
+			}
+
+		public:
+			constexpr BitBoard() : _x(0), _o(0) {}
+
+			constexpr BitBoard(uint16_t x, uint16_t o) : _x(x & fullMask), _o(o & fullMask) {}
+
+			BitBoard(const vector<CLine>& initial) : _x(0), _o(0) {
+				for (int i = 0; i < 3; ++i) {
+					for (int j = 0; j < 3; ++j) {
+						if (initial[i][j] == Token::X) {
+							_x |= bitAt(i, j);
+						}
+						else if (initial[i][j] == Token::O) {
+							_o |= bitAt(i, j);
+						}
+					}
+				}
+			}
+
+			uint16_t xMask() const { return _x; }
+
+			uint16_t oMask() const { return _o; }
+
+			uint16_t maskOf(const Token& token) const {
+				return token == Token::X ? _x : token == Token::O ? _o : (uint16_t)(~(_x | _o) & fullMask);
+			}
+
+			Token at(int row, int column) const {
+				const uint16_t bit = bitAt(row, column);
+				return (_x & bit) ? Token::X : (_o & bit) ? Token::O : Token::Blank;
+			}
+
+			// a new board with the cell taken by token, Blank clears it
+			BitBoard with(int row, int column, const Token& token) const {
+				const uint16_t bit = bitAt(row, column);
+				const uint16_t x = (uint16_t)(_x & ~bit);
+				const uint16_t o = (uint16_t)(_o & ~bit);
+				return BitBoard(token == Token::X ? (uint16_t)(x | bit) : x, token == Token::O ? (uint16_t)(o | bit) : o);
+			}
+
+			bool anyLineFilledWith(const Token& token) const {
+				return anyMaskFilled(lineMasks, 3, maskOf(token));
+			}
+
+			bool anyColumnFilledWith(const Token& token) const {
+				return anyMaskFilled(columnMasks, 3, maskOf(token));
+			}
+
+			bool anyDiagonalFilledWith(const Token& token) const {
+				return anyMaskFilled(diagonalMasks, 2, maskOf(token));
+			}
+
+			bool notFilledYet() const {
+				return (_x | _o) != fullMask;
+			}
+
+			bool operator==(const BitBoard& other) const {
+				return _x == other._x && _o == other._o;
+			}
+		};
+
 		auto tokenWinsDelegate = [](const auto& board, const auto& token) {
 			return board.anyLineFilledWith(token) ||
 				board.anyColumnFilledWith(token) ||
@@ -847,66 +944,336 @@ namespace tictactoe {
 			return board.notFilledYet();
 		};
 
-		auto True = []() {
+		auto True = [](const auto&) {
 			return true;
 		};
 
-		using Rule = pair<function<bool()>, Result>;
+		// a condition on the board and the result it decides. the condition is the plain callable, not a
+		// function<>, so a set of rules has a concrete type and checking it inlines
+		template<typename Condition>
+		struct Rule {
+			Condition condition;
+			Result result;
+		};
 
-		auto condition = [](auto rule) {
-			return rule.first();
+		auto rule = [](auto condition, const Result& result) {
+			return Rule<decltype(condition)>{ condition, result };
 		};
 
-		auto result = [](auto rule) {
-			return rule.second;
+		// the rules are tried left to right and the fold stops at the first that applies.
+		// when none does, the last rule's result is the answer
+		template<typename BoardType, typename... Conditions>
+		Result resultForfirstRuleThatApplies(const BoardType& board, const Rule<Conditions>&... rules) {
+			static_assert(sizeof...(Conditions) > 0, "at least one rule");
+			Result found{};
+			(void)(((found = rules.result), rules.condition(board)) || ...);
+			return found;
+		}
+
+		// CBoard or BitBoard, anything with the any*FilledWith and notFilledYet queries
+		template<typename BoardType>
+		Result winner(const BoardType& board) {
+			return resultForfirstRuleThatApplies(board,
+				rule(xWinsDelegate, XWins),
+				rule(oWinsDelegate, OWins),
+				rule(gameNotOverYetDelegate, GameNotOverYet),
+				rule(True, Draw)
+			);
+		}
+
+		// the rules don't depend on the board, so they are built once
+		auto winnerRules = make_tuple(
+			rule(xWinsDelegate, XWins),
+			rule(oWinsDelegate, OWins),
+			rule(gameNotOverYetDelegate, GameNotOverYet),
+			rule(True, Draw)
+		);
+
+		template<typename BoardType>
+		Result winner2(const BoardType& board) {
+			return apply([&board](const auto&... rules) {
+				return resultForfirstRuleThatApplies(board, rules...);
+			}, winnerRules);
+		}
+
+		// the 3^9 boards in base 3, cell (row * 3 + column) is the digit at that position
+		auto boardFromIndex = [](int index) {
+			vector<CLine> rows(3, CLine(3, Token::Blank));
+			for (int cell = 0; cell < 9; ++cell, index /= 3) {
+				rows[cell / 3][cell % 3] = index % 3 == 0 ? Token::Blank : index % 3 == 1 ? Token::X : Token::O;
+			}
+			return rows;
 		};
 
-		auto findTheRule = [](const auto& rules) {
-			return *find_if(rules.begin(), rules.end(), [](auto rule) {
-				return condition(rule);
+		TEST_CASE("bitboard packs tokens by cell") {
+			BitBoard board({
+				{ Token::X, Token::O, Token::Blank },
+				{ Token::Blank, Token::X, Token::Blank },
+				{ Token::O, Token::Blank, Token::X }
 			});
-		};
 
-		auto resultForfirstRuleThatApplies = [](auto rules) {
-			return result(findTheRule(rules));
+			CHECK_EQ(board.xMask(), 0421);
+			CHECK_EQ(board.oMask(), 0102);
+			CHECK_EQ(board.at(0, 1), Token::O);
+			CHECK_EQ(board.at(1, 2), Token::Blank);
+			CHECK_EQ(board.with(1, 2, Token::O).at(1, 2), Token::O);
+			CHECK_EQ(board.with(0, 0, Token::Blank).at(0, 0), Token::Blank);
+			CHECK_EQ(board.with(0, 0, Token::Blank).with(0, 0, Token::X), board);
+		}
+
+		TEST_CASE("bitboard wins on every line, column and diagonal") {
+			const uint16_t winning[8] = { 0007, 0070, 0700, 0111, 0222, 0444, 0421, 0124 };
+			for (uint16_t mask : winning) {
+				CHECK_EQ(winner(BitBoard(mask, 0)), XWins);
+				CHECK_EQ(winner(BitBoard(0, mask)), OWins);
+			}
+			CHECK_EQ(winner(BitBoard()), GameNotOverYet);
+			// XOX / OOX / XXO
+			CHECK_EQ(winner(BitBoard(0345, 0432)), Draw);
+		}
+
+		TEST_CASE("secondary diagonal") {
+			CBoard board({
+				{ Token::Blank, Token::Blank, Token::O },
+				{ Token::Blank, Token::O, Token::Blank },
+				{ Token::O, Token::X, Token::X }
+			});
+
+			CHECK_EQ(winner(board), OWins);
+			CHECK_EQ(winner(BitBoard({
+				{ Token::Blank, Token::Blank, Token::O },
+				{ Token::Blank, Token::O, Token::Blank },
+				{ Token::O, Token::X, Token::X }
+			})), OWins);
+		}
+
+		auto playerOfToken = [](const Token& token) {
+			return token == Token::X ? 0 : token == Token::O ? 1 : -1;
 		};
 
-		Result winner(const CBoard& board) {
-			auto gameNotOverYetOnBoard = bind(gameNotOverYetDelegate, board);
-			auto xWinsOnBoard = bind(xWinsDelegate, board);
-			auto oWinsOnBoard = bind(oWinsDelegate, board);
-			
-			vector<pair<function<bool()>, Result>> rules = {
-				{xWinsOnBoard, XWins},
-				{oWinsOnBoard, OWins},
-				{gameNotOverYetOnBoard, GameNotOverYet},
-				{True, Draw}
+		// zobrist hashes of either board, see zobrist.h. a move is one toggle on the result
+		template<typename BoardType>
+		SymmetricHash<3, 3> hashOf(const BoardType& board) {
+			return symmetricHashOf<3, 3>([&board](int row, int column) {
+				return playerOfToken(board.at(row, column));
+			});
+		}
+
+		TEST_CASE("CBoard and BitBoard hash alike") {
+			vector<CLine> rows{
+				{ Token::X, Token::O, Token::Blank },
+				{ Token::Blank, Token::X, Token::Blank },
+				{ Token::Blank, Token::Blank, Token::Blank }
 			};
+			CHECK_EQ(hashOf(CBoard(rows)).hash(), hashOf(BitBoard(rows)).hash());
 
-			auto theRule = find_if(rules.begin(), rules.end(), [](auto pair) {
-				return pair.first();
-			});
+			// the same position turned a quarter
+			vector<CLine> turned{
+				{ Token::Blank, Token::Blank, Token::X },
+				{ Token::Blank, Token::X, Token::O },
+				{ Token::Blank, Token::Blank, Token::Blank }
+			};
+			CHECK_NE(hashOf(CBoard(turned)).hash(), hashOf(CBoard(rows)).hash());
+			CHECK_EQ(hashOf(CBoard(turned)).canonicalHash(), hashOf(CBoard(rows)).canonicalHash());
 
-			return theRule->second;
+			BitBoard board(rows);
+			auto hash = hashOf(board);
+			hash.toggle(8, playerOfToken(Token::O));
+			CHECK_EQ(hash.hash(), hashOf(board.with(2, 2, Token::O)).hash());
 		}
 
-		Result winner2(const CBoard& board) {
-			auto gameNotOverYetOnBoard = bind(gameNotOverYetDelegate, board);
-			auto xWinsOnBoard = bind(xWinsDelegate, board);
-			auto oWinsOnBoard = bind(oWinsDelegate, board);
+		TEST_CASE("bitboard agrees with CBoard on every board") {
+			for (int index = 0; index < 19683; ++index) {
+				auto rows = boardFromIndex(index);
+				REQUIRE_EQ(winner(BitBoard(rows)), winner(CBoard(rows)));
+				REQUIRE_EQ(winner2(BitBoard(rows)), winner(CBoard(rows)));
+			}
+		}
 
-			vector<Rule> rules = {
-				{xWinsOnBoard, XWins},
-				{oWinsOnBoard, OWins},
-				{gameNotOverYetOnBoard, GameNotOverYet},
-				{True, Draw}
+		TEST_CASE("the first rule that applies decides") {
+			auto False = [](const auto&) {
+				return false;
 			};
+			const BitBoard board;
+			CHECK_EQ(resultForfirstRuleThatApplies(board, rule(True, OWins), rule(True, XWins)), OWins);
+			CHECK_EQ(resultForfirstRuleThatApplies(board, rule(False, OWins), rule(True, XWins)), XWins);
+			CHECK_EQ(resultForfirstRuleThatApplies(board, rule(False, OWins), rule(False, Draw)), Draw);
+			CHECK_EQ(resultForfirstRuleThatApplies(board, rule(gameNotOverYetDelegate, GameNotOverYet), rule(True, Draw)), GameNotOverYet);
+		}
 
-			auto theRule = find_if(rules.begin(), rules.end(), [](auto pair) {
-				return pair.first();
-			});
+		// many BitBoards as a structure of arrays, board i is (xs[i], os[i]), the layout the batch winner loads 8 or 16 at a time
+		struct BitBoardBatch {
+			vector<uint16_t> xs;
+			vector<uint16_t> os;
+
+			void push_back(const BitBoard& board) {
+				xs.push_back(board.xMask());
+				os.push_back(board.oMask());
+			}
+
+			size_t size() const {
+				return xs.size();
+			}
+		};
+
+		static constexpr uint16_t batchWinMasks[8] = { 0007, 0070, 0700, 0111, 0222, 0444, 0421, 0124 };
+
+		// winner() without the rule chain, the reference for the vector kernels and the tail they leave
+		static Result winnerOfMasks(uint16_t x, uint16_t o) {
+			bool xWins = false;
+			bool oWins = false;
+			for (uint16_t mask : batchWinMasks) {
+				xWins |= (x & mask) == mask;
+				oWins |= (o & mask) == mask;
+			}
+			return xWins ? XWins : oWins ? OWins : (x | o) != 0777 ? GameNotOverYet : Draw;
+		}
+
+		static void batchWinnerScalar(const uint16_t* xs, const uint16_t* os, size_t count, Result* results) {
+			for (size_t i = 0; i < count; ++i) {
+				results[i] = winnerOfMasks(xs[i], os[i]);
+			}
+		}
+
+#if defined(__AVX2__)
+		static constexpr const char* batchWinnerKernel = "avx2";
+
+		// 16 boards per register, each win mask is an and plus a compare for all of them
+		static void batchWinnerVector(const uint16_t* xs, const uint16_t* os, size_t count, Result* results) {
+			const __m256i full = _mm256_set1_epi16(0777);
+			const __m256i xResult = _mm256_set1_epi16(XWins);
+			const __m256i oResult = _mm256_set1_epi16(OWins);
+			const __m256i openResult = _mm256_set1_epi16(GameNotOverYet);
+			const __m256i drawResult = _mm256_set1_epi16(Draw);
+			size_t i = 0;
+			for (; i + 16 <= count; i += 16) {
+				const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(xs + i));
+				const __m256i o = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(os + i));
+				__m256i xWins = _mm256_setzero_si256();
+				__m256i oWins = _mm256_setzero_si256();
+				for (uint16_t mask : batchWinMasks) {
+					const __m256i line = _mm256_set1_epi16((short)mask);
+					xWins = _mm256_or_si256(xWins, _mm256_cmpeq_epi16(_mm256_and_si256(x, line), line));
+					oWins = _mm256_or_si256(oWins, _mm256_cmpeq_epi16(_mm256_and_si256(o, line), line));
+				}
+				const __m256i filled = _mm256_cmpeq_epi16(_mm256_or_si256(x, o), full);
+
+				// the same precedence as the rules: X, then O, then not over yet, then draw
+				__m256i result = _mm256_blendv_epi8(openResult, drawResult, filled);
+				result = _mm256_blendv_epi8(result, oResult, oWins);
+				result = _mm256_blendv_epi8(result, xResult, xWins);
+
+				alignas(32) uint16_t lanes[16];
+				_mm256_store_si256(reinterpret_cast<__m256i*>(lanes), result);
+				for (int lane = 0; lane < 16; ++lane) {
+					results[i + lane] = (Result)lanes[lane];
+				}
+			}
+			batchWinnerScalar(xs + i, os + i, count - i, results + i);
+		}
+#elif defined(_M_X64) || defined(__SSE2__)
+		static constexpr const char* batchWinnerKernel = "sse2";
+
+		static __m128i selectLanes(__m128i condition, __m128i whenSet, __m128i otherwise) {
+			return _mm_or_si128(_mm_and_si128(condition, whenSet), _mm_andnot_si128(condition, otherwise));
+		}
+
+		// 8 boards per register, each win mask is an and plus a compare for all of them
+		static void batchWinnerVector(const uint16_t* xs, const uint16_t* os, size_t count, Result* results) {
+			const __m128i full = _mm_set1_epi16(0777);
+			const __m128i xResult = _mm_set1_epi16(XWins);
+			const __m128i oResult = _mm_set1_epi16(OWins);
+			const __m128i openResult = _mm_set1_epi16(GameNotOverYet);
+			const __m128i drawResult = _mm_set1_epi16(Draw);
+			size_t i = 0;
+			for (; i + 8 <= count; i += 8) {
+				const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(xs + i));
+				const __m128i o = _mm_loadu_si128(reinterpret_cast<const __m128i*>(os + i));
+				__m128i xWins = _mm_setzero_si128();
+				__m128i oWins = _mm_setzero_si128();
+				for (uint16_t mask : batchWinMasks) {
+					const __m128i line = _mm_set1_epi16((short)mask);
+					xWins = _mm_or_si128(xWins, _mm_cmpeq_epi16(_mm_and_si128(x, line), line));
+					oWins = _mm_or_si128(oWins, _mm_cmpeq_epi16(_mm_and_si128(o, line), line));
+				}
+				const __m128i filled = _mm_cmpeq_epi16(_mm_or_si128(x, o), full);
+
+				// the same precedence as the rules: X, then O, then not over yet, then draw
+				__m128i result = selectLanes(filled, drawResult, openResult);
+				result = selectLanes(oWins, oResult, result);
+				result = selectLanes(xWins, xResult, result);
+
+				alignas(16) uint16_t lanes[8];
+				_mm_store_si128(reinterpret_cast<__m128i*>(lanes), result);
+				for (int lane = 0; lane < 8; ++lane) {
+					results[i + lane] = (Result)lanes[lane];
+				}
+			}
+			batchWinnerScalar(xs + i, os + i, count - i, results + i);
+		}
+#else
+		static constexpr const char* batchWinnerKernel = "scalar";
+
+		static void batchWinnerVector(const uint16_t* xs, const uint16_t* os, size_t count, Result* results) {
+			batchWinnerScalar(xs, os, count, results);
+		}
+#endif
+
+		// winner() of every board in the batch, results must hold batch.size()
+		static void winners(const BitBoardBatch& batch, Result* results) {
+			batchWinnerVector(batch.xs.data(), batch.os.data(), batch.size(), results);
+		}
+
+		static vector<Result> winners(const BitBoardBatch& batch) {
+			vector<Result> results(batch.size());
+			winners(batch, results.data());
+			return results;
+		}
+
+		TEST_CASE("batch winner agrees with winner on every board") {
+			BitBoardBatch batch;
+			vector<Result> expected;
+			for (int index = 0; index < 19683; ++index) {
+				const BitBoard board(boardFromIndex(index));
+				batch.push_back(board);
+				expected.push_back(winner(board));
+			}
+
+			CHECK(winners(batch) == expected);
+
+			vector<Result> scalar(batch.size());
+			batchWinnerScalar(batch.xs.data(), batch.os.data(), batch.size(), scalar.data());
+			CHECK(scalar == expected);
+
+			// a count that is not a multiple of the vector width goes through the scalar tail
+			vector<Result> partial(13);
+			batchWinnerVector(batch.xs.data() + 100, batch.os.data() + 100, partial.size(), partial.data());
+			CHECK(equal(partial.begin(), partial.end(), expected.begin() + 100));
+		}
+
+		TEST_CASE("batch winner throughput") {
+			// every board 64 times over, about 1.26M boards
+			BitBoardBatch batch;
+			for (int copy = 0; copy < 64; ++copy) {
+				for (int index = 0; index < 19683; ++index) {
+					batch.push_back(BitBoard(boardFromIndex(index)));
+				}
+			}
+
+			auto boardsPerSecond = [&batch](auto kernel, vector<Result>& results) {
+				results.resize(batch.size());
+				const auto started = chrono::steady_clock::now();
+				kernel(batch.xs.data(), batch.os.data(), batch.size(), results.data());
+				const double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+				return seconds > 0 ? batch.size() / seconds : 0.0;
+			};
 
-			return resultForfirstRuleThatApplies(rules);
+			vector<Result> scalarResults;
+			vector<Result> vectorResults;
+			const double scalar = boardsPerSecond(batchWinnerScalar, scalarResults);
+			const double vectorised = boardsPerSecond(batchWinnerVector, vectorResults);
+			CHECK(vectorResults == scalarResults);
+			MESSAGE("batch winner: " << (long long)scalar << " boards/sec scalar, " << (long long)vectorised << " boards/sec " << string(batchWinnerKernel));
 		}
 	
 		auto bindAllToBoard = [](const auto& board) {
@@ -948,7 +1315,7 @@ namespace tictactoe {
 			BoardResult(const vector<Line>& board) : board(board) {
 			}
 
-			Lines allLinesColumnsAndDiagonals() const {
+			LinesView<Board> allLinesColumnsAndDiagonals() const {
 				return concatenate3(allLines(board), allColumns(board), allDiagonals(board));
 			}
 		};
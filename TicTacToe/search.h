@@ -0,0 +1,427 @@
+#pragma once
+
+#include "doctest.h"
+#include "mnk_board.h"
+#include "transposition.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+
+namespace tictactoe {
+	/*
+		negamax with alpha-beta pruning over MnkBoard, iterative deepening under a time budget.
+		moves are tried best move of the last iteration (or the table's move) first, then the killers
+		of the ply, then by history score. scores are from the side to move, a win at ply p is
+		searchWinScore - p so quicker wins and slower losses are preferred.
+		with a TranspositionTable positions are keyed by their canonical hash, so a position reached
+		by another move order or in another orientation is searched once. the stored move is in the
+		canonical orientation and mapped back on probe
+	*/
+
+	static constexpr int searchWinScore = 100000000;
+
+	static inline bool isWinScore(int score) {
+		return std::abs(score) > searchWinScore - 1000;
+	}
+
+	struct SearchLimits {
+		// plies, the number of empty cells when 0
+		int maxDepth = 0;
+		// iterative deepening stops starting new iterations past this, and abandons the running one
+		int timeBudgetMs = 1000;
+		// only empty cells this close (chebyshev) to a stone are searched. -1 picks 2 on boards
+		// over 36 cells and every empty cell otherwise, 0 is every empty cell
+		int candidateRadius = -1;
+	};
+
+	struct SearchResult {
+		// cell index, -1 when the game is already over
+		int bestMove;
+		int score;
+		// deepest iteration that completed
+		int depth;
+		uint64_t nodes;
+		double seconds;
+		double nodesPerSecond;
+		// score is the game theoretic value: a forced win or loss was found, or the whole tree was searched
+		bool solved;
+	};
+
+	template<typename Board>
+	class Searcher {
+	private:
+		static constexpr int cells = Board::cells;
+		static constexpr int checkEvery = 1024;
+
+		using Lines = typename Board::Lines;
+		using Symmetries = typename Board::Symmetries;
+		using Clock = std::chrono::steady_clock;
+
+		Board _board;
+		TranspositionTable* _table;
+		std::array<std::array<int16_t, 2>, cells + 1> _killers;
+		std::array<std::array<uint32_t, cells>, 2> _history;
+		int _radius;
+		int _rootBest;
+		int _previousBest;
+		uint64_t _nodes;
+		bool _stopped;
+		bool _timed;
+		Clock::time_point _deadline;
+
+		// line counts weighted 4^stones, a line with both players in it is dead
+		int evaluate() const {
+			const Mark me = _board.sideToMove();
+			const auto& mine = _board.stonesOf(me);
+			const auto& theirs = _board.stonesOf(opponentOf(me));
+			int score = 0;
+			for (int i = 0; i < Lines::count; ++i) {
+				const int own = mine.countCommon(Lines::mask(i));
+				const int other = theirs.countCommon(Lines::mask(i));
+				if (own > 0 && other == 0) {
+					score += 1 << (2 * own);
+				}
+				else if (other > 0 && own == 0) {
+					score -= 1 << (2 * other);
+				}
+			}
+			return score;
+		}
+
+		// win scores are stored relative to the position, not the root
+		static int toTable(int score, int ply) {
+			return isWinScore(score) ? (score > 0 ? score + ply : score - ply) : score;
+		}
+
+		static int fromTable(int score, int ply) {
+			return isWinScore(score) ? (score > 0 ? score - ply : score + ply) : score;
+		}
+
+		int generateMoves(std::array<int16_t, cells>& moves, int ply, int hashMove) const {
+			int count = 0;
+			std::array<uint32_t, cells> order;
+			const int side = _board.sideToMove() == Mark::X ? 0 : 1;
+			for (int cell = 0; cell < cells; ++cell) {
+				if (!isCandidate(_board, cell, _radius)) {
+					continue;
+				}
+				uint32_t key = _history[side][cell];
+				if (cell == hashMove) {
+					key = UINT32_MAX;
+				}
+				else if (cell == _killers[ply][0]) {
+					key = UINT32_MAX - 1;
+				}
+				else if (cell == _killers[ply][1]) {
+					key = UINT32_MAX - 2;
+				}
+				order[count] = key;
+				moves[count++] = (int16_t)cell;
+			}
+
+			// insertion sort, the lists are short and mostly ordered already
+			for (int i = 1; i < count; ++i) {
+				const uint32_t key = order[i];
+				const int16_t move = moves[i];
+				int j = i - 1;
+				for (; j >= 0 && order[j] < key; --j) {
+					order[j + 1] = order[j];
+					moves[j + 1] = moves[j];
+				}
+				order[j + 1] = key;
+				moves[j + 1] = move;
+			}
+			return count;
+		}
+
+		void rememberCutoff(int move, int ply, int depth) {
+			if (_killers[ply][0] != move) {
+				_killers[ply][1] = _killers[ply][0];
+				_killers[ply][0] = (int16_t)move;
+			}
+			const int side = _board.sideToMove() == Mark::X ? 0 : 1;
+			_history[side][move] += (uint32_t)(depth * depth);
+		}
+
+		int negamax(int depth, int ply, int alpha, int beta) {
+			++_nodes;
+			if (_timed && (_nodes % checkEvery) == 0 && Clock::now() >= _deadline) {
+				_stopped = true;
+			}
+			if (_stopped) {
+				return 0;
+			}
+			if (depth == 0) {
+				return evaluate();
+			}
+
+			const int alphaOriginal = alpha;
+			int hashMove = ply == 0 ? _previousBest : -1;
+			const int symmetry = _table ? _board.canonicalSymmetry() : 0;
+			const uint64_t key = _table ? _board.canonicalHash() : 0;
+			TableEntry entry;
+			if (_table && _table->probe(key, entry)) {
+				if (hashMove < 0 && entry.move >= 0) {
+					hashMove = Symmetries::map(Symmetries::inverse(symmetry), entry.move);
+				}
+				// the root always searches, it has to name a move
+				if (ply > 0 && entry.depth >= depth) {
+					const int score = fromTable(entry.score, ply);
+					if (entry.bound == Bound::Exact
+						|| (entry.bound == Bound::Lower && score >= beta)
+						|| (entry.bound == Bound::Upper && score <= alpha)) {
+						return score;
+					}
+				}
+			}
+
+			std::array<int16_t, cells> moves;
+			const int count = generateMoves(moves, ply, hashMove);
+			int best = -searchWinScore - 1;
+			int bestMove = -1;
+			for (int i = 0; i < count; ++i) {
+				const int move = moves[i];
+				_board.play(move);
+
+				int score;
+				const GameStatus status = _board.status();
+				if (status == GameStatus::XWins || status == GameStatus::OWins) {
+					score = searchWinScore - (ply + 1);
+				}
+				else if (status == GameStatus::Draw) {
+					score = 0;
+				}
+				else {
+					score = -negamax(depth - 1, ply + 1, -beta, -alpha);
+				}
+				_board.undo();
+
+				if (_stopped) {
+					return 0;
+				}
+				if (score > best) {
+					best = score;
+					bestMove = move;
+					if (ply == 0) {
+						_rootBest = move;
+					}
+				}
+				if (best > alpha) {
+					alpha = best;
+				}
+				if (alpha >= beta) {
+					rememberCutoff(move, ply, depth);
+					break;
+				}
+			}
+			// no candidates only happens on a full board, which play() already scored as a draw
+			if (count == 0) {
+				return 0;
+			}
+
+			if (_table) {
+				const Bound bound = best <= alphaOriginal ? Bound::Upper : best >= beta ? Bound::Lower : Bound::Exact;
+				_table->store(key, toTable(best, ply), Symmetries::map(symmetry, bestMove), depth, bound);
+			}
+			return best;
+		}
+
+	public:
+		// table may be shared with other searchers, nullptr searches without one
+		explicit Searcher(TranspositionTable* table = nullptr) : _table(table), _killers{}, _history{}, _radius(0), _rootBest(-1), _previousBest(-1), _nodes(0), _stopped(false), _timed(false) {}
+
+		SearchResult search(const Board& board, const SearchLimits& limits = SearchLimits()) {
+			const auto started = Clock::now();
+			SearchResult result{ -1, 0, 0, 0, 0.0, 0.0, false };
+			if (board.isOver()) {
+				result.solved = true;
+				return result;
+			}
+
+			_board = board;
+			_radius = effectiveCandidateRadius<Board>(limits.candidateRadius);
+			_nodes = 0;
+			_stopped = false;
+			_previousBest = -1;
+			_deadline = started + std::chrono::milliseconds(limits.timeBudgetMs);
+			if (_table) {
+				_table->newSearch();
+			}
+			for (auto& killers : _killers) {
+				killers = { -1, -1 };
+			}
+			// older cutoffs still say something about the position, they just count for less
+			for (auto& side : _history) {
+				for (auto& score : side) {
+					score >>= 2;
+				}
+			}
+
+			const int empties = cells - board.moveCount();
+			const int maxDepth = limits.maxDepth > 0 ? std::min(limits.maxDepth, empties) : empties;
+			for (int depth = 1; depth <= maxDepth; ++depth) {
+				// the first iteration always completes, so there is a move to return
+				_timed = depth > 1;
+				_rootBest = -1;
+				const int score = negamax(depth, 0, -searchWinScore - 1, searchWinScore + 1);
+				if (_stopped) {
+					break;
+				}
+
+				result.bestMove = _rootBest;
+				result.score = score;
+				result.depth = depth;
+				_previousBest = _rootBest;
+
+				if (isWinScore(score) || (depth == empties && _radius == 0)) {
+					result.solved = true;
+					break;
+				}
+				if (Clock::now() >= _deadline) {
+					break;
+				}
+			}
+
+			result.nodes = _nodes;
+			result.seconds = std::chrono::duration<double>(Clock::now() - started).count();
+			result.nodesPerSecond = result.seconds > 0.0 ? (double)_nodes / result.seconds : 0.0;
+			return result;
+		}
+	};
+
+	template<typename Board>
+	SearchResult searchBestMove(const Board& board, const SearchLimits& limits = SearchLimits(), TranspositionTable* table = nullptr) {
+		Searcher<Board> searcher(table);
+		return searcher.search(board, limits);
+	}
+
+	TEST_SUITE("alpha-beta search") {
+		TEST_CASE("3x3 is a draw from the empty board") {
+			auto result = searchBestMove(TicTacToeBoard());
+			CHECK(result.solved);
+			CHECK_EQ(result.score, 0);
+			CHECK_EQ(result.depth, 9);
+			CHECK_NE(result.bestMove, -1);
+		}
+
+		TEST_CASE("3x3 takes the win and blocks the loss") {
+			TicTacToeBoard board;
+			// X: (0,0) (0,1), O: (1,1) (2,2), X to move wins on (0,2)
+			board.play(0, 0);
+			board.play(1, 1);
+			board.play(0, 1);
+			board.play(2, 2);
+			auto win = searchBestMove(board);
+			CHECK_EQ(win.bestMove, TicTacToeBoard::cellIndex(0, 2));
+			CHECK_EQ(win.score, searchWinScore - 1);
+
+			TicTacToeBoard defend;
+			// X: (0,0) (0,1), O: (1,1), O to move must take (0,2)
+			defend.play(0, 0);
+			defend.play(1, 1);
+			defend.play(0, 1);
+			auto block = searchBestMove(defend);
+			CHECK_EQ(block.bestMove, TicTacToeBoard::cellIndex(0, 2));
+			CHECK(!isWinScore(-block.score));
+		}
+
+		TEST_CASE("every 3x3 reply of the solver holds the draw") {
+			// after any opening the solver plays both sides, perfect play from there is always a draw
+			for (int first = 0; first < 9; ++first) {
+				TicTacToeBoard board;
+				board.play(first);
+				while (!board.isOver()) {
+					auto result = searchBestMove(board);
+					REQUIRE(result.solved);
+					REQUIRE_EQ(result.score, 0);
+					board.play(result.bestMove);
+				}
+				CHECK_EQ(board.status(), GameStatus::Draw);
+			}
+		}
+
+		TEST_CASE("4x4 three in a row is a first player win") {
+			auto result = searchBestMove(MnkBoard<4, 4, 3>());
+			CHECK(result.solved);
+			CHECK(isWinScore(result.score));
+			CHECK_GT(result.score, 0);
+		}
+
+		TEST_CASE("the transposition table keeps the result and cuts the tree") {
+			TranspositionTable table(1 << 20);
+			auto plain = searchBestMove(TicTacToeBoard());
+			auto hashed = searchBestMove(TicTacToeBoard(), SearchLimits(), &table);
+			CHECK(hashed.solved);
+			CHECK_EQ(hashed.score, plain.score);
+			CHECK_LT(hashed.nodes * 4, plain.nodes);
+			MESSAGE("3x3 solve: " << plain.nodes << " nodes plain, " << hashed.nodes << " with the table");
+
+			table.clear();
+			auto plain4 = searchBestMove(MnkBoard<4, 4, 3>());
+			auto hashed4 = searchBestMove(MnkBoard<4, 4, 3>(), SearchLimits(), &table);
+			CHECK_EQ(hashed4.score, plain4.score);
+			CHECK_LE(hashed4.nodes, plain4.nodes);
+		}
+
+		TEST_CASE("table moves are mapped back to the board's orientation") {
+			// the same position in two orientations, X to win on the open end of the row
+			TranspositionTable table(1 << 20);
+			TicTacToeBoard board;
+			board.play(0, 0);
+			board.play(1, 1);
+			board.play(0, 1);
+			board.play(2, 2);
+			CHECK_EQ(searchBestMove(board, SearchLimits(), &table).bestMove, TicTacToeBoard::cellIndex(0, 2));
+
+			TicTacToeBoard mirrored;
+			mirrored.play(0, 2);
+			mirrored.play(1, 1);
+			mirrored.play(0, 1);
+			mirrored.play(2, 0);
+			CHECK_EQ(searchBestMove(mirrored, SearchLimits(), &table).bestMove, TicTacToeBoard::cellIndex(0, 0));
+		}
+
+		TEST_CASE("every 3x3 reply with a shared table holds the draw") {
+			TranspositionTable table(1 << 20);
+			Searcher<TicTacToeBoard> searcher(&table);
+			for (int first = 0; first < 9; ++first) {
+				TicTacToeBoard board;
+				board.play(first);
+				while (!board.isOver()) {
+					auto result = searcher.search(board);
+					REQUIRE_EQ(result.score, 0);
+					REQUIRE(board.play(result.bestMove));
+				}
+				CHECK_EQ(board.status(), GameStatus::Draw);
+			}
+		}
+
+		TEST_CASE("gomoku completes an open four within the budget") {
+			GomokuBoard board;
+			for (int column = 5; column < 9; ++column) {
+				board.play(7, column);
+				board.play(10, column);
+			}
+			SearchLimits limits;
+			limits.timeBudgetMs = 200;
+			auto result = searchBestMove(board, limits);
+			CHECK((result.bestMove == GomokuBoard::cellIndex(7, 4) || result.bestMove == GomokuBoard::cellIndex(7, 9)));
+			CHECK_EQ(result.score, searchWinScore - 1);
+			CHECK_GT(result.nodesPerSecond, 0.0);
+		}
+
+		TEST_CASE("gomoku search respects the time budget") {
+			GomokuBoard board;
+			board.play(7, 7);
+			board.play(7, 8);
+			SearchLimits limits;
+			limits.timeBudgetMs = 100;
+			auto result = searchBestMove(board, limits);
+			CHECK(board.isEmpty(result.bestMove));
+			CHECK_GE(result.depth, 1);
+			CHECK_LT(result.seconds, 1.0);
+		}
+	}
+}
@@ -0,0 +1,458 @@
+#pragma once
+
+#include "doctest.h"
+#include "mnk_board.h"
+#include "search.h"
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace tictactoe {
+	/*
+		perfect play for every reachable 3x3 position, solved offline and mapped from a file.
+
+		a position's key is its base 3 number, cell i is digit i (0 empty, 1 X, 2 O), so 3^9 keys.
+		only 5478 of them are reachable; a bitmap over the keys marks them, and a position's slot
+		is the rank of its bit (a per word prefix count plus one popcount). a lookup is the key,
+		the rank and one byte load.
+
+		file, native byte order:
+			char magic[8]            "TTTBASE1"
+			u32 positions            entries that follow
+			u32 words                bitmap words
+			u64 bitmap[words]
+			u16 ranks[words]         set bits before each word
+			u8 entries[positions]    bits 0-3 best move (15 when over), bits 4-5 Outcome
+
+		nothing maps the file at startup. --tablebase-generate writes it, and a caller that wants
+		perfect 3x3 play opens it once and keeps the Tablebase alive for its lookups.
+	*/
+
+	// from the side to move
+	enum class Outcome : uint8_t {
+		Draw,
+		Win,
+		Loss
+	};
+
+	struct TablebaseEntry {
+		Outcome outcome;
+		// cell index, -1 when the game is over
+		int bestMove;
+	};
+
+	class Tablebase {
+	public:
+		static constexpr int keyCount = 19683;
+		static constexpr int wordCount = (keyCount + 63) / 64;
+		static constexpr int reachablePositions = 5478;
+
+	private:
+		static constexpr char magic[8] = { 'T', 'T', 'T', 'B', 'A', 'S', 'E', '1' };
+		static constexpr size_t headerSize = sizeof(magic) + 2 * sizeof(uint32_t);
+		static constexpr size_t imageSize = headerSize + wordCount * (sizeof(uint64_t) + sizeof(uint16_t)) + reachablePositions;
+		static constexpr uint8_t noMove = 15;
+
+		const uint8_t* _base;
+		size_t _size;
+		const uint64_t* _bitmap;
+		const uint16_t* _ranks;
+		const uint8_t* _entries;
+#if defined(_WIN32)
+		HANDLE _file;
+		HANDLE _view;
+#else
+		int _fd;
+#endif
+
+		struct Solved {
+			int8_t score;
+			int8_t move;
+			bool seen;
+		};
+
+		// negamax over every reachable position. a loss after m moves scores -(10 - m) so quicker wins rank higher
+		static int solve(TicTacToeBoard& board, int key, std::array<Solved, keyCount>& solved) {
+			if (solved[key].seen) {
+				return solved[key].score;
+			}
+
+			int best = -100;
+			int bestMove = -1;
+			if (board.status() == GameStatus::Draw) {
+				best = 0;
+			}
+			else if (board.isOver()) {
+				best = -(10 - board.moveCount());
+			}
+			else {
+				const int digit = board.sideToMove() == Mark::X ? 1 : 2;
+				int power = 1;
+				for (int cell = 0; cell < 9; ++cell, power *= 3) {
+					if (!board.isEmpty(cell)) {
+						continue;
+					}
+					board.play(cell);
+					const int score = -solve(board, key + digit * power, solved);
+					board.undo();
+					if (score > best) {
+						best = score;
+						bestMove = cell;
+					}
+				}
+			}
+
+			solved[key] = { (int8_t)best, (int8_t)bestMove, true };
+			return best;
+		}
+
+		bool attachImage(const uint8_t* base, size_t size) {
+			if (size < headerSize || memcmp(base, magic, sizeof(magic)) != 0) {
+				return false;
+			}
+			uint32_t positions, words;
+			memcpy(&positions, base + sizeof(magic), sizeof(positions));
+			memcpy(&words, base + sizeof(magic) + sizeof(positions), sizeof(words));
+			if (positions != reachablePositions || words != wordCount || size < imageSize) {
+				return false;
+			}
+			_base = base;
+			_size = size;
+			_bitmap = reinterpret_cast<const uint64_t*>(base + headerSize);
+			_ranks = reinterpret_cast<const uint16_t*>(base + headerSize + wordCount * sizeof(uint64_t));
+			_entries = base + headerSize + wordCount * (sizeof(uint64_t) + sizeof(uint16_t));
+			return true;
+		}
+
+	public:
+		Tablebase()
+			:
+			_base(nullptr),
+			_size(0),
+			_bitmap(nullptr),
+			_ranks(nullptr),
+			_entries(nullptr)
+#if defined(_WIN32)
+			, _file(INVALID_HANDLE_VALUE)
+			, _view(nullptr)
+#else
+			, _fd(-1)
+#endif
+		{}
+
+		~Tablebase() {
+			close();
+		}
+
+		Tablebase(const Tablebase&) = delete;
+		Tablebase& operator=(const Tablebase&) = delete;
+
+		// the file image, solved from scratch. this is the offline step, it takes milliseconds
+		static std::vector<uint8_t> generate() {
+			std::array<Solved, keyCount> solved{};
+			TicTacToeBoard board;
+			solve(board, 0, solved);
+
+			std::vector<uint8_t> image(imageSize, 0);
+			uint8_t* out = image.data();
+			const uint32_t positions = reachablePositions;
+			const uint32_t words = wordCount;
+			memcpy(out, magic, sizeof(magic));
+			memcpy(out + sizeof(magic), &positions, sizeof(positions));
+			memcpy(out + sizeof(magic) + sizeof(positions), &words, sizeof(words));
+
+			std::vector<uint64_t> bitmap(wordCount, 0);
+			std::vector<uint16_t> ranks(wordCount, 0);
+			uint8_t* entries = out + headerSize + wordCount * (sizeof(uint64_t) + sizeof(uint16_t));
+			int rank = 0;
+			for (int key = 0; key < keyCount; ++key) {
+				if (key % 64 == 0) {
+					ranks[key / 64] = (uint16_t)rank;
+				}
+				if (!solved[key].seen) {
+					continue;
+				}
+				bitmap[key / 64] |= uint64_t(1) << (key % 64);
+				const Outcome outcome = solved[key].score > 0 ? Outcome::Win : solved[key].score < 0 ? Outcome::Loss : Outcome::Draw;
+				const uint8_t move = solved[key].move < 0 ? noMove : (uint8_t)solved[key].move;
+				entries[rank++] = (uint8_t)(move | (uint8_t)outcome << 4);
+			}
+			memcpy(out + headerSize, bitmap.data(), wordCount * sizeof(uint64_t));
+			memcpy(out + headerSize + wordCount * sizeof(uint64_t), ranks.data(), wordCount * sizeof(uint16_t));
+			return image;
+		}
+
+		static bool write(const std::string& path) {
+			const std::vector<uint8_t> image = generate();
+			FILE* file = fopen(path.c_str(), "wb");
+			if (!file) {
+				return false;
+			}
+			const bool written = fwrite(image.data(), 1, image.size(), file) == image.size();
+			return fclose(file) == 0 && written;
+		}
+
+		// maps the file read only, false on a missing or malformed file
+		bool open(const std::string& path) {
+			close();
+#if defined(_WIN32)
+			_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (_file == INVALID_HANDLE_VALUE) {
+				return false;
+			}
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0) {
+				close();
+				return false;
+			}
+			_view = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			const void* base = _view ? MapViewOfFile(_view, FILE_MAP_READ, 0, 0, 0) : nullptr;
+			if (!base || !attachImage(static_cast<const uint8_t*>(base), (size_t)size.QuadPart)) {
+				if (base) {
+					UnmapViewOfFile(base);
+				}
+				close();
+				return false;
+			}
+#else
+			_fd = ::open(path.c_str(), O_RDONLY);
+			struct stat info;
+			if (_fd < 0 || fstat(_fd, &info) != 0 || info.st_size == 0) {
+				close();
+				return false;
+			}
+			void* base = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, _fd, 0);
+			if (base == MAP_FAILED || !attachImage(static_cast<const uint8_t*>(base), (size_t)info.st_size)) {
+				if (base != MAP_FAILED) {
+					munmap(base, (size_t)info.st_size);
+				}
+				close();
+				return false;
+			}
+#endif
+			return true;
+		}
+
+		// serves lookups straight out of an image that outlives the tablebase, e.g. from generate()
+		bool attach(const std::vector<uint8_t>& image) {
+			close();
+			return attachImage(image.data(), image.size());
+		}
+
+		void close() {
+#if defined(_WIN32)
+			if (_base && _view) {
+				UnmapViewOfFile(_base);
+			}
+			if (_view) {
+				CloseHandle(_view);
+			}
+			if (_file != INVALID_HANDLE_VALUE) {
+				CloseHandle(_file);
+			}
+			_file = INVALID_HANDLE_VALUE;
+			_view = nullptr;
+#else
+			if (_base && _fd >= 0) {
+				munmap(const_cast<uint8_t*>(_base), _size);
+			}
+			if (_fd >= 0) {
+				::close(_fd);
+			}
+			_fd = -1;
+#endif
+			_base = nullptr;
+			_size = 0;
+		}
+
+		bool isOpen() const {
+			return _base != nullptr;
+		}
+
+		static int keyOf(const TicTacToeBoard& board) {
+			int key = 0;
+			for (int cell = 8; cell >= 0; --cell) {
+				const Mark mark = board.at(cell);
+				key = key * 3 + (mark == Mark::X ? 1 : mark == Mark::O ? 2 : 0);
+			}
+			return key;
+		}
+
+		// false for keys no game reaches, e.g. two X more than O
+		bool contains(int key) const {
+			return key >= 0 && key < keyCount && ((_bitmap[key / 64] >> (key % 64)) & 1);
+		}
+
+		bool contains(const TicTacToeBoard& board) const {
+			return contains(keyOf(board));
+		}
+
+		// nullopt for unreachable keys, their rank would name another position's entry or run past the last one
+		std::optional<TablebaseEntry> lookup(int key) const {
+			if (!contains(key)) {
+				return std::nullopt;
+			}
+			const uint64_t below = _bitmap[key / 64] & ((uint64_t(1) << (key % 64)) - 1);
+			const uint8_t entry = _entries[_ranks[key / 64] + popcount64(below)];
+			const int move = entry & 0xf;
+			return TablebaseEntry{ (Outcome)((entry >> 4) & 3), move == noMove ? -1 : move };
+		}
+
+		std::optional<TablebaseEntry> lookup(const TicTacToeBoard& board) const {
+			return lookup(keyOf(board));
+		}
+	};
+
+	// --tablebase-generate <file>
+	static int tablebaseTool(int argc, char** argv) {
+		if (argc < 2) {
+			fprintf(stderr, "usage: --tablebase-generate <file>\n");
+			return 1;
+		}
+		if (!Tablebase::write(argv[1])) {
+			fprintf(stderr, "could not write %s\n", argv[1]);
+			return 1;
+		}
+		Tablebase tablebase;
+		if (!tablebase.open(argv[1])) {
+			fprintf(stderr, "could not map %s back\n", argv[1]);
+			return 1;
+		}
+		fprintf(stderr, "%d positions written to %s\n", Tablebase::reachablePositions, argv[1]);
+		return 0;
+	}
+
+	TEST_SUITE("3x3 tablebase") {
+		// calls visit once for every position reachable from board
+		template<typename Visit>
+		void forEachReachable(TicTacToeBoard& board, std::vector<bool>& visited, Visit& visit) {
+			const int key = Tablebase::keyOf(board);
+			if (visited[key]) {
+				return;
+			}
+			visited[key] = true;
+			visit(board);
+			if (board.isOver()) {
+				return;
+			}
+			for (int cell = 0; cell < 9; ++cell) {
+				if (board.play(cell)) {
+					forEachReachable(board, visited, visit);
+					board.undo();
+				}
+			}
+		}
+
+		TEST_CASE("image covers exactly the reachable positions") {
+			const std::vector<uint8_t> image = Tablebase::generate();
+			Tablebase tablebase;
+			REQUIRE(tablebase.attach(image));
+
+			std::vector<bool> visited(Tablebase::keyCount, false);
+			TicTacToeBoard board;
+			int count = 0;
+			auto countPosition = [&](const TicTacToeBoard& position) {
+				CHECK(tablebase.contains(position));
+				++count;
+			};
+			forEachReachable(board, visited, countPosition);
+			CHECK_EQ(count, Tablebase::reachablePositions);
+
+			int unreachable = 0;
+			for (int key = 0; key < Tablebase::keyCount; ++key) {
+				unreachable += visited[key] ? 0 : 1;
+			}
+			CHECK_EQ(unreachable, Tablebase::keyCount - Tablebase::reachablePositions);
+
+			auto entry = tablebase.lookup(board);
+			REQUIRE(entry);
+			CHECK_EQ(entry->outcome, Outcome::Draw);
+			CHECK(board.play(entry->bestMove));
+		}
+
+		TEST_CASE("unreachable keys have no entry") {
+			const std::vector<uint8_t> image = Tablebase::generate();
+			Tablebase tablebase;
+			REQUIRE(tablebase.attach(image));
+
+			// nine O, the last key and past the last set bit; a lone O with X yet to move
+			CHECK(!tablebase.lookup(Tablebase::keyCount - 1));
+			CHECK(!tablebase.lookup(2));
+			CHECK(!tablebase.lookup(-1));
+			CHECK(!tablebase.lookup(Tablebase::keyCount));
+			CHECK(tablebase.lookup(1));
+		}
+
+		TEST_CASE("tablebase agrees with the searcher everywhere") {
+			const std::vector<uint8_t> image = Tablebase::generate();
+			Tablebase tablebase;
+			REQUIRE(tablebase.attach(image));
+
+			Searcher<TicTacToeBoard> searcher;
+			std::vector<bool> visited(Tablebase::keyCount, false);
+			TicTacToeBoard board;
+			int checked = 0;
+			auto compare = [&](const TicTacToeBoard& position) {
+				REQUIRE(tablebase.contains(position));
+				const TablebaseEntry entry = *tablebase.lookup(position);
+				if (position.isOver()) {
+					REQUIRE_EQ(entry.bestMove, -1);
+					REQUIRE_EQ(entry.outcome, position.status() == GameStatus::Draw ? Outcome::Draw : Outcome::Loss);
+					return;
+				}
+				const SearchResult result = searcher.search(position);
+				const Outcome expected = result.score > 0 ? Outcome::Win : result.score < 0 ? Outcome::Loss : Outcome::Draw;
+				REQUIRE_EQ(entry.outcome, expected);
+
+				// the stored move keeps the outcome
+				TicTacToeBoard after = position;
+				REQUIRE(after.play(entry.bestMove));
+				const Outcome next = after.isOver()
+					? (after.status() == GameStatus::Draw ? Outcome::Draw : Outcome::Loss)
+					: tablebase.lookup(after)->outcome;
+				REQUIRE_EQ(next, expected == Outcome::Win ? Outcome::Loss : expected == Outcome::Loss ? Outcome::Win : Outcome::Draw);
+				++checked;
+			};
+			forEachReachable(board, visited, compare);
+			CHECK_GT(checked, 0);
+		}
+
+		TEST_CASE("written file maps back") {
+			const std::string path = (std::filesystem::temp_directory_path() / "tictactoe_tablebase_test.bin").string();
+			REQUIRE(Tablebase::write(path));
+			{
+				Tablebase tablebase;
+				REQUIRE(tablebase.open(path));
+				TicTacToeBoard board;
+				board.play(0, 0);
+				board.play(0, 1);
+				auto entry = tablebase.lookup(board);
+				REQUIRE(entry);
+				CHECK_EQ(entry->outcome, Outcome::Win);
+			}
+			Tablebase missing;
+			CHECK(!missing.open(path + ".missing"));
+			std::remove(path.c_str());
+		}
+	}
+}
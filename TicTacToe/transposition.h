@@ -0,0 +1,203 @@
+#pragma once
+
+#include "doctest.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace tictactoe {
+	enum class Bound : uint8_t {
+		None,
+		Exact,
+		// the score is at least this, a beta cutoff
+		Lower,
+		// the score is at most this, every move failed low
+		Upper
+	};
+
+	struct TableEntry {
+		int score;
+		int16_t move;
+		uint8_t depth;
+		Bound bound;
+	};
+
+	/*
+		fixed size transposition table shared by any number of searching threads without a lock.
+		an entry is two atomic words, data and key ^ data. a torn read (one word from one writer, one
+		from another) no longer xors back to the key and reads as a miss.
+		a bucket is one cache line of 4 entries: 3 depth preferred, 1 always replaced
+	*/
+	class TranspositionTable {
+	private:
+		struct Entry {
+			std::atomic<uint64_t> check;
+			std::atomic<uint64_t> data;
+		};
+
+		struct alignas(64) Bucket {
+			Entry entries[4];
+		};
+
+		static constexpr int depthPreferred = 3;
+
+		std::unique_ptr<Bucket[]> _buckets;
+		size_t _mask;
+		std::atomic<uint8_t> _generation;
+
+		// score 32 bits, move 16, depth 8, bound 2, generation 6
+		static uint64_t pack(int score, int move, int depth, Bound bound, uint8_t generation) {
+			return (uint64_t)(uint32_t)score
+				| (uint64_t)(uint16_t)move << 32
+				| (uint64_t)(uint8_t)depth << 48
+				| (uint64_t)bound << 56
+				| (uint64_t)(generation & 0x3f) << 58;
+		}
+
+		static int depthOf(uint64_t data) {
+			return (int)(uint8_t)(data >> 48);
+		}
+
+		static uint8_t generationOf(uint64_t data) {
+			return (uint8_t)(data >> 58);
+		}
+
+		Bucket& bucketOf(uint64_t key) const {
+			return _buckets[(key >> 16) & _mask];
+		}
+
+	public:
+		// rounded down to a power of two buckets, at least one
+		explicit TranspositionTable(size_t bytes = 16 << 20) : _generation(0) {
+			size_t count = 1;
+			while (count * 2 * sizeof(Bucket) <= bytes) {
+				count *= 2;
+			}
+			_buckets.reset(new Bucket[count]);
+			_mask = count - 1;
+			clear();
+		}
+
+		TranspositionTable(const TranspositionTable&) = delete;
+		TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+		size_t bucketCount() const {
+			return _mask + 1;
+		}
+
+		// not safe against concurrent searches
+		void clear() {
+			for (size_t i = 0; i <= _mask; ++i) {
+				for (Entry& entry : _buckets[i].entries) {
+					entry.check.store(0, std::memory_order_relaxed);
+					entry.data.store(0, std::memory_order_relaxed);
+				}
+			}
+		}
+
+		// entries from earlier searches become the first to go
+		void newSearch() {
+			_generation.store((uint8_t)((_generation.load(std::memory_order_relaxed) + 1) & 0x3f), std::memory_order_relaxed);
+		}
+
+		bool probe(uint64_t key, TableEntry& out) const {
+			for (const Entry& entry : bucketOf(key).entries) {
+				const uint64_t data = entry.data.load(std::memory_order_relaxed);
+				if ((entry.check.load(std::memory_order_relaxed) ^ data) != key || data == 0) {
+					continue;
+				}
+				out.score = (int)(int32_t)(uint32_t)data;
+				out.move = (int16_t)(uint16_t)(data >> 32);
+				out.depth = (uint8_t)depthOf(data);
+				out.bound = (Bound)((data >> 56) & 3);
+				return true;
+			}
+			return false;
+		}
+
+		void store(uint64_t key, int score, int move, int depth, Bound bound) {
+			Bucket& bucket = bucketOf(key);
+			const uint8_t generation = _generation.load(std::memory_order_relaxed);
+			const uint64_t data = pack(score, move, depth, bound, generation);
+
+			// the same position is overwritten in place unless it holds a deeper result of this search
+			Entry* target = nullptr;
+			for (Entry& entry : bucket.entries) {
+				const uint64_t old = entry.data.load(std::memory_order_relaxed);
+				if ((entry.check.load(std::memory_order_relaxed) ^ old) == key) {
+					if (depthOf(old) > depth && generationOf(old) == generation) {
+						return;
+					}
+					target = &entry;
+					break;
+				}
+			}
+
+			// otherwise the shallowest or stalest depth preferred slot, if the new entry is at least as deep
+			if (!target) {
+				Entry* weakest = &bucket.entries[0];
+				int weakestDepth = INT32_MAX;
+				for (int i = 0; i < depthPreferred; ++i) {
+					const uint64_t old = bucket.entries[i].data.load(std::memory_order_relaxed);
+					const int oldDepth = generationOf(old) == generation ? depthOf(old) : -1;
+					if (oldDepth < weakestDepth) {
+						weakestDepth = oldDepth;
+						weakest = &bucket.entries[i];
+					}
+				}
+				target = weakestDepth <= depth ? weakest : &bucket.entries[depthPreferred];
+			}
+
+			target->data.store(data, std::memory_order_relaxed);
+			target->check.store(key ^ data, std::memory_order_relaxed);
+		}
+	};
+
+	TEST_SUITE("transposition table") {
+		TEST_CASE("stores and probes") {
+			TranspositionTable table(1 << 12);
+			TableEntry entry{};
+			CHECK(!table.probe(42, entry));
+
+			table.store(42, -17, 5, 3, Bound::Lower);
+			REQUIRE(table.probe(42, entry));
+			CHECK_EQ(entry.score, -17);
+			CHECK_EQ(entry.move, 5);
+			CHECK_EQ(entry.depth, 3);
+			CHECK_EQ(entry.bound, Bound::Lower);
+			CHECK(!table.probe(43, entry));
+		}
+
+		TEST_CASE("deeper results of the same search survive shallower ones") {
+			TranspositionTable table(1 << 12);
+			TableEntry entry{};
+			table.store(7, 10, 1, 6, Bound::Lower);
+			table.store(7, 20, 2, 2, Bound::Upper);
+			REQUIRE(table.probe(7, entry));
+			CHECK_EQ(entry.depth, 6);
+
+			table.newSearch();
+			table.store(7, 20, 2, 2, Bound::Upper);
+			REQUIRE(table.probe(7, entry));
+			CHECK_EQ(entry.depth, 2);
+		}
+
+		TEST_CASE("a full bucket keeps its deep entries and cycles the always replace slot") {
+			// one bucket, every key collides
+			TranspositionTable table(64);
+			REQUIRE_EQ(table.bucketCount(), 1u);
+			for (uint64_t key = 1; key <= 3; ++key) {
+				table.store(key, 0, 0, 10, Bound::Exact);
+			}
+			table.store(100, 0, 0, 1, Bound::Exact);
+			table.store(101, 0, 0, 1, Bound::Exact);
+
+			TableEntry entry{};
+			for (uint64_t key = 1; key <= 3; ++key) {
+				CHECK(table.probe(key, entry));
+			}
+			CHECK(!table.probe(100, entry));
+			CHECK(table.probe(101, entry));
+		}
+	}
+}
@@ -0,0 +1,284 @@
+#pragma once
+
+#include "doctest.h"
+#include <array>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace tictactoe {
+	/*
+		win lines of an m x n board with k in a row, generated at compile time.
+		runtime code only indexes the tables, nothing is rebuilt per query
+	*/
+
+	static inline int popcount64(uint64_t word) {
+#if defined(_MSC_VER)
+		return (int)__popcnt64(word);
+#else
+		return __builtin_popcountll(word);
+#endif
+	}
+
+	// one bit per cell, bit (row * Columns + column)
+	template<int Cells>
+	struct CellMask {
+		static constexpr int wordCount = (Cells + 63) / 64;
+
+		uint64_t words[wordCount] = {};
+
+		constexpr void set(int cell) {
+			words[cell / 64] |= uint64_t(1) << (cell % 64);
+		}
+
+		constexpr void clear(int cell) {
+			words[cell / 64] &= ~(uint64_t(1) << (cell % 64));
+		}
+
+		constexpr bool test(int cell) const {
+			return (words[cell / 64] >> (cell % 64)) & 1;
+		}
+
+		// every cell of other is set here too
+		constexpr bool contains(const CellMask& other) const {
+			for (int i = 0; i < wordCount; ++i) {
+				if ((words[i] & other.words[i]) != other.words[i]) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		constexpr bool intersects(const CellMask& other) const {
+			for (int i = 0; i < wordCount; ++i) {
+				if (words[i] & other.words[i]) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// cells set in both
+		int countCommon(const CellMask& other) const {
+			int count = 0;
+			for (int i = 0; i < wordCount; ++i) {
+				count += popcount64(words[i] & other.words[i]);
+			}
+			return count;
+		}
+
+		constexpr bool operator==(const CellMask& other) const {
+			for (int i = 0; i < wordCount; ++i) {
+				if (words[i] != other.words[i]) {
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+
+	struct Cell {
+		int row;
+		int column;
+	};
+
+	enum LineDirection {
+		Row,
+		Column,
+		MainDiagonal,
+		SecondaryDiagonal
+	};
+
+	template<int K>
+	struct WinLine {
+		LineDirection direction;
+		std::array<Cell, K> cells;
+	};
+
+	// lines are ordered rows, columns, main diagonals (down right), secondary diagonals (down left),
+	// each group by its first cell. for 3x3 that is the order of allLinesColumnsAndDiagonals
+	template<int Rows, int Columns, int K>
+	class WinLineTable {
+		static_assert(Rows > 0 && Columns > 0 && K > 0, "board and line length must be positive");
+		static_assert(K <= Rows || K <= Columns, "a line of K must fit the board");
+
+	public:
+		static constexpr int rows = Rows;
+		static constexpr int columns = Columns;
+		static constexpr int length = K;
+		static constexpr int cells = Rows * Columns;
+
+		static constexpr int rowLines = K <= Columns ? Rows * (Columns - K + 1) : 0;
+		static constexpr int columnLines = K <= Rows ? (Rows - K + 1) * Columns : 0;
+		static constexpr int diagonalLines = K <= Rows && K <= Columns ? (Rows - K + 1) * (Columns - K + 1) : 0;
+		static constexpr int count = rowLines + columnLines + 2 * diagonalLines;
+
+		// a cell sits on at most K lines per direction
+		static constexpr int maxLinesThroughCell = 4 * K;
+
+		using Mask = CellMask<cells>;
+
+		static constexpr int cellIndex(int row, int column) {
+			return row * Columns + column;
+		}
+
+	private:
+		struct Tables {
+			std::array<WinLine<K>, count> lines{};
+			std::array<Mask, count> masks{};
+			std::array<std::array<int16_t, maxLinesThroughCell>, cells> through{};
+			std::array<int, cells> throughCount{};
+		};
+
+		static constexpr void addLine(Tables& tables, int& next, LineDirection direction, int row, int column, int rowStep, int columnStep) {
+			WinLine<K>& line = tables.lines[next];
+			line.direction = direction;
+			for (int i = 0; i < K; ++i) {
+				const Cell cell{ row + i * rowStep, column + i * columnStep };
+				const int index = cellIndex(cell.row, cell.column);
+				line.cells[i] = cell;
+				tables.masks[next].set(index);
+				tables.through[index][tables.throughCount[index]++] = (int16_t)next;
+			}
+			++next;
+		}
+
+		static constexpr Tables build() {
+			Tables tables{};
+			int next = 0;
+			for (int row = 0; K <= Columns && row < Rows; ++row) {
+				for (int column = 0; column + K <= Columns; ++column) {
+					addLine(tables, next, Row, row, column, 0, 1);
+				}
+			}
+			for (int column = 0; K <= Rows && column < Columns; ++column) {
+				for (int row = 0; row + K <= Rows; ++row) {
+					addLine(tables, next, Column, row, column, 1, 0);
+				}
+			}
+			for (int row = 0; row + K <= Rows; ++row) {
+				for (int column = 0; column + K <= Columns; ++column) {
+					addLine(tables, next, MainDiagonal, row, column, 1, 1);
+				}
+			}
+			for (int row = 0; row + K <= Rows; ++row) {
+				for (int column = K - 1; column < Columns; ++column) {
+					addLine(tables, next, SecondaryDiagonal, row, column, 1, -1);
+				}
+			}
+			return tables;
+		}
+
+		static constexpr Tables tables = build();
+
+	public:
+		static constexpr const WinLine<K>& line(int index) {
+			return tables.lines[index];
+		}
+
+		static constexpr const Mask& mask(int index) {
+			return tables.masks[index];
+		}
+
+		// indices of the lines through a cell, what incremental win detection walks after a move
+		static constexpr const int16_t* linesThrough(int cell) {
+			return tables.through[cell].data();
+		}
+
+		static constexpr int linesThroughCount(int cell) {
+			return tables.throughCount[cell];
+		}
+
+		// taken holds one player's cells
+		static constexpr bool anyLineFilled(const Mask& taken) {
+			for (int i = 0; i < count; ++i) {
+				if (taken.contains(tables.masks[i])) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		static constexpr bool anyLineFilledThrough(const Mask& taken, int cell) {
+			for (int i = 0; i < tables.throughCount[cell]; ++i) {
+				if (taken.contains(tables.masks[tables.through[cell][i]])) {
+					return true;
+				}
+			}
+			return false;
+		}
+	};
+
+	template<int N, int K = N>
+	using SquareWinLines = WinLineTable<N, N, K>;
+
+	static_assert(SquareWinLines<3>::count == 8, "3x3 has 3 rows, 3 columns and 2 diagonals");
+	static_assert(SquareWinLines<4>::count == 10, "4x4 four in a row");
+	static_assert(SquareWinLines<4, 3>::count == 24, "4x4 three in a row");
+	static_assert(SquareWinLines<15, 5>::count == 572, "15x15 gomoku");
+	static_assert(SquareWinLines<3>::mask(6).words[0] == 0421 && SquareWinLines<3>::mask(7).words[0] == 0124, "3x3 diagonals");
+
+	TEST_SUITE("win line tables") {
+		TEST_CASE("3x3 masks match the bitboard masks") {
+			using Lines = SquareWinLines<3>;
+			const uint64_t expected[8] = { 0007, 0070, 0700, 0111, 0222, 0444, 0421, 0124 };
+			for (int i = 0; i < Lines::count; ++i) {
+				CHECK_EQ(Lines::mask(i).words[0], expected[i]);
+			}
+		}
+
+		TEST_CASE("3x3 coordinates in allLinesColumnsAndDiagonals order") {
+			using Lines = SquareWinLines<3>;
+			const int expected[8][3][2] = {
+				{ {0, 0}, {0, 1}, {0, 2} },
+				{ {1, 0}, {1, 1}, {1, 2} },
+				{ {2, 0}, {2, 1}, {2, 2} },
+				{ {0, 0}, {1, 0}, {2, 0} },
+				{ {0, 1}, {1, 1}, {2, 1} },
+				{ {0, 2}, {1, 2}, {2, 2} },
+				{ {0, 0}, {1, 1}, {2, 2} },
+				{ {0, 2}, {1, 1}, {2, 0} }
+			};
+			for (int i = 0; i < Lines::count; ++i) {
+				for (int j = 0; j < 3; ++j) {
+					CHECK_EQ(Lines::line(i).cells[j].row, expected[i][j][0]);
+					CHECK_EQ(Lines::line(i).cells[j].column, expected[i][j][1]);
+				}
+			}
+		}
+
+		TEST_CASE("lines through a cell") {
+			using Lines = SquareWinLines<3>;
+			CHECK_EQ(Lines::linesThroughCount(Lines::cellIndex(1, 1)), 4);
+			CHECK_EQ(Lines::linesThroughCount(Lines::cellIndex(0, 0)), 3);
+			CHECK_EQ(Lines::linesThroughCount(Lines::cellIndex(0, 1)), 2);
+
+			using Gomoku = SquareWinLines<15, 5>;
+			CHECK_EQ(Gomoku::linesThroughCount(Gomoku::cellIndex(7, 7)), Gomoku::maxLinesThroughCell);
+			CHECK_EQ(Gomoku::linesThroughCount(Gomoku::cellIndex(0, 0)), 3);
+
+			for (int cell = 0; cell < Gomoku::cells; ++cell) {
+				for (int i = 0; i < Gomoku::linesThroughCount(cell); ++i) {
+					REQUIRE(Gomoku::mask(Gomoku::linesThrough(cell)[i]).test(cell));
+				}
+			}
+		}
+
+		TEST_CASE("anyLineFilled on a rectangular board") {
+			using Lines = WinLineTable<3, 5, 4>;
+			CHECK_EQ(Lines::count, 6);
+
+			Lines::Mask taken{};
+			for (int column = 1; column < 4; ++column) {
+				taken.set(Lines::cellIndex(1, column));
+			}
+			CHECK(!Lines::anyLineFilled(taken));
+			taken.set(Lines::cellIndex(1, 4));
+			CHECK(Lines::anyLineFilled(taken));
+			CHECK(Lines::anyLineFilledThrough(taken, Lines::cellIndex(1, 4)));
+			CHECK(!Lines::anyLineFilledThrough(taken, Lines::cellIndex(0, 4)));
+		}
+	}
+}
@@ -0,0 +1,215 @@
+#pragma once
+
+#include "doctest.h"
+#include <array>
+#include <cstdint>
+
+namespace tictactoe {
+	/*
+		zobrist keys and board symmetries, both generated at compile time.
+		a position's hash is the xor of the keys of its stones, so a move or an undo is one xor,
+		and hashing the board under every symmetry at once gives a canonical hash shared by
+		all orientations of the same position
+	*/
+
+	static constexpr uint64_t splitMix64(uint64_t& state) {
+		uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+
+	// key of (cell, player), player 0 is X and 1 is O
+	template<int Cells>
+	class ZobristKeys {
+	private:
+		static constexpr std::array<std::array<uint64_t, 2>, Cells> build() {
+			std::array<std::array<uint64_t, 2>, Cells> keys{};
+			uint64_t state = 0x7f4a7c159e3779b9ull ^ (uint64_t)Cells;
+			for (int cell = 0; cell < Cells; ++cell) {
+				keys[cell][0] = splitMix64(state);
+				keys[cell][1] = splitMix64(state);
+			}
+			return keys;
+		}
+
+		static constexpr std::array<std::array<uint64_t, 2>, Cells> keys = build();
+
+	public:
+		static constexpr uint64_t key(int cell, int player) {
+			return keys[cell][player];
+		}
+	};
+
+	// the 8 symmetries of a square board, or the 4 of a rectangular one (identity, both mirrors, half turn).
+	// map(s, cell) is where cell lands under symmetry s
+	template<int Rows, int Columns>
+	class BoardSymmetries {
+	public:
+		static constexpr int cells = Rows * Columns;
+		static constexpr int count = Rows == Columns ? 8 : 4;
+
+	private:
+		struct Tables {
+			std::array<std::array<int16_t, cells>, count> map{};
+			std::array<int, count> inverse{};
+		};
+
+		static constexpr int transform(int symmetry, int row, int column) {
+			const int lastRow = Rows - 1;
+			const int lastColumn = Columns - 1;
+			switch (symmetry) {
+			case 0: return row * Columns + column;
+			case 1: return row * Columns + (lastColumn - column);
+			case 2: return (lastRow - row) * Columns + column;
+			case 3: return (lastRow - row) * Columns + (lastColumn - column);
+			// square only from here on
+			case 4: return column * Columns + row;
+			case 5: return (lastColumn - column) * Columns + (lastRow - row);
+			case 6: return column * Columns + (lastRow - row);
+			default: return (lastColumn - column) * Columns + row;
+			}
+		}
+
+		static constexpr Tables build() {
+			Tables tables{};
+			for (int symmetry = 0; symmetry < count; ++symmetry) {
+				for (int cell = 0; cell < cells; ++cell) {
+					tables.map[symmetry][cell] = (int16_t)transform(symmetry, cell / Columns, cell % Columns);
+				}
+			}
+			// the quarter turns undo each other, everything else is its own inverse
+			for (int symmetry = 0; symmetry < count; ++symmetry) {
+				for (int candidate = 0; candidate < count; ++candidate) {
+					bool undoes = true;
+					for (int cell = 0; cell < cells && undoes; ++cell) {
+						undoes = tables.map[candidate][tables.map[symmetry][cell]] == cell;
+					}
+					if (undoes) {
+						tables.inverse[symmetry] = candidate;
+						break;
+					}
+				}
+			}
+			return tables;
+		}
+
+		static constexpr Tables tables = build();
+
+	public:
+		static constexpr int map(int symmetry, int cell) {
+			return tables.map[symmetry][cell];
+		}
+
+		static constexpr int inverse(int symmetry) {
+			return tables.inverse[symmetry];
+		}
+	};
+
+	// a hash per symmetry, kept up to date one stone at a time
+	template<int Rows, int Columns>
+	class SymmetricHash {
+	public:
+		using Symmetries = BoardSymmetries<Rows, Columns>;
+		using Keys = ZobristKeys<Rows * Columns>;
+
+	private:
+		std::array<uint64_t, Symmetries::count> _hashes;
+
+	public:
+		SymmetricHash() : _hashes{} {}
+
+		// toggles a stone, the same call places and removes it
+		void toggle(int cell, int player) {
+			for (int symmetry = 0; symmetry < Symmetries::count; ++symmetry) {
+				_hashes[symmetry] ^= Keys::key(Symmetries::map(symmetry, cell), player);
+			}
+		}
+
+		uint64_t hash() const {
+			return _hashes[0];
+		}
+
+		// the symmetry whose hash is the smallest, positions that are rotations or mirrors of each other agree on it
+		int canonicalSymmetry() const {
+			int best = 0;
+			for (int symmetry = 1; symmetry < Symmetries::count; ++symmetry) {
+				if (_hashes[symmetry] < _hashes[best]) {
+					best = symmetry;
+				}
+			}
+			return best;
+		}
+
+		uint64_t canonicalHash() const {
+			return _hashes[canonicalSymmetry()];
+		}
+	};
+
+	// from scratch, for boards without incremental hashing. playerAt(row, column) is 0 for X, 1 for O, -1 for empty
+	template<int Rows, int Columns, typename PlayerAt>
+	SymmetricHash<Rows, Columns> symmetricHashOf(PlayerAt playerAt) {
+		SymmetricHash<Rows, Columns> hash;
+		for (int row = 0; row < Rows; ++row) {
+			for (int column = 0; column < Columns; ++column) {
+				const int player = playerAt(row, column);
+				if (player >= 0) {
+					hash.toggle(row * Columns + column, player);
+				}
+			}
+		}
+		return hash;
+	}
+
+	static_assert(BoardSymmetries<3, 3>::map(4, 1) == 3, "transpose swaps (0,1) and (1,0)");
+	static_assert(BoardSymmetries<3, 3>::inverse(6) == 7 && BoardSymmetries<3, 3>::inverse(7) == 6, "quarter turns");
+	static_assert(ZobristKeys<9>::key(0, 0) != ZobristKeys<9>::key(0, 1), "distinct keys");
+
+	TEST_SUITE("zobrist hashing") {
+		TEST_CASE("every symmetry is a permutation with an inverse") {
+			using Symmetries = BoardSymmetries<4, 4>;
+			for (int symmetry = 0; symmetry < Symmetries::count; ++symmetry) {
+				std::array<bool, 16> seen{};
+				for (int cell = 0; cell < 16; ++cell) {
+					const int mapped = Symmetries::map(symmetry, cell);
+					CHECK(!seen[mapped]);
+					seen[mapped] = true;
+					CHECK_EQ(Symmetries::map(Symmetries::inverse(symmetry), mapped), cell);
+				}
+			}
+			CHECK_EQ(BoardSymmetries<3, 5>::count, 4);
+		}
+
+		TEST_CASE("toggling twice restores the hash") {
+			SymmetricHash<3, 3> hash;
+			hash.toggle(4, 0);
+			const uint64_t center = hash.hash();
+			hash.toggle(0, 1);
+			CHECK_NE(hash.hash(), center);
+			hash.toggle(0, 1);
+			CHECK_EQ(hash.hash(), center);
+		}
+
+		TEST_CASE("rotations and mirrors share the canonical hash") {
+			// X in a corner and O next to it, in all 8 orientations
+			const int corners[4] = { 0, 2, 8, 6 };
+			const int neighbours[4][2] = { {1, 3}, {1, 5}, {7, 5}, {7, 3} };
+			SymmetricHash<3, 3> reference;
+			reference.toggle(0, 0);
+			reference.toggle(1, 1);
+			for (int i = 0; i < 4; ++i) {
+				for (int neighbour : neighbours[i]) {
+					SymmetricHash<3, 3> hash;
+					hash.toggle(corners[i], 0);
+					hash.toggle(neighbour, 1);
+					CHECK_EQ(hash.canonicalHash(), reference.canonicalHash());
+				}
+			}
+
+			SymmetricHash<3, 3> other;
+			other.toggle(0, 0);
+			other.toggle(4, 1);
+			CHECK_NE(other.canonicalHash(), reference.canonicalHash());
+		}
+	}
+}
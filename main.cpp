@@ -1,7 +1,28 @@
 #include "RaftConsensus/RaftTester.h"
+#include "RaftConsensus/ElectionBench.h"
+#include "RaftConsensus/ThroughputBench.h"
+#include "RaftConsensus/TraceReplay.h"
+#include "RaftConsensus/ScenarioRunner.h"
 #include "TicTacToe\practice.h"
 
+#include <cstring>
+
 int main(int argc, char** argv) {
+	if (argc > 1 && strcmp(argv[1], "--bench-election") == 0) {
+		return raft::run_election_bench(argc - 1, argv + 1);
+	}
+	if (argc > 1 && strcmp(argv[1], "--bench-throughput") == 0) {
+		return raft::run_throughput_bench(argc - 1, argv + 1);
+	}
+	if (argc > 1 && strcmp(argv[1], "--scenario") == 0) {
+		return raft::run_scenario_tool(argc - 1, argv + 1);
+	}
+	if (argc > 1 && (strcmp(argv[1], "--trace-export") == 0 || strcmp(argv[1], "--trace-replay") == 0)) {
+		return raft::run_trace_tool(argc - 1, argv + 1);
+	}
+	if (argc > 1 && strcmp(argv[1], "--tablebase-generate") == 0) {
+		return tictactoe::tablebaseTool(argc - 1, argv + 1);
+	}
 
 
 